@@ -11,6 +11,7 @@
  *   0x2 = Read word from flash (addr), returns data
  *   0x3 = NOP / get status
  *   0x4 = Burst write (addr + count + N×data words)
+ *   0x5 = Burst read (addr + count), N×(exec delay + data word) returned
  */
 
 module bpiOverJtag_core (
@@ -56,7 +57,9 @@ localparam IDLE           = 4'd0,
 		   DONE           = 4'd6,
 		   BURST_RECV_CNT = 4'd7,
 		   BURST_DATA     = 4'd8,
-		   BURST_EXEC     = 4'd9;
+		   BURST_EXEC     = 4'd9,
+		   BURST_RD_EXEC  = 4'd10,
+		   BURST_RD_SEND  = 4'd11;
 
 reg [3:0] state, state_d;
 reg [5:0] bit_cnt, bit_cnt_d;
@@ -79,7 +82,8 @@ assign tdo = rd_data_reg[0];
 localparam CMD_WRITE       = 4'h1,
 		   CMD_READ        = 4'h2,
 		   CMD_NOP         = 4'h3,
-		   CMD_BURST_WRITE = 4'h4;
+		   CMD_BURST_WRITE = 4'h4,
+		   CMD_BURST_READ  = 4'h5;
 
 /* Next state logic */
 always @(*) begin
@@ -115,7 +119,8 @@ always @(*) begin
 				if (cmd_reg == CMD_WRITE) begin
 					bit_cnt_d = 15;  /* 16 bits for data */
 					state_d = RECV_DATA;
-				end else if (cmd_reg == CMD_BURST_WRITE) begin
+				end else if (cmd_reg == CMD_BURST_WRITE ||
+						cmd_reg == CMD_BURST_READ) begin
 					bit_cnt_d = 15;  /* 16 bits for burst count */
 					state_d = BURST_RECV_CNT;
 				end else begin
@@ -157,8 +162,13 @@ always @(*) begin
 			burst_cnt_d = {tdi, burst_cnt[15:1]};
 			bit_cnt_d = bit_cnt - 1'b1;
 			if (bit_cnt == 0) begin
-				bit_cnt_d = 15;
-				state_d = BURST_DATA;
+				if (cmd_reg == CMD_BURST_READ) begin
+					wait_cnt_d = 8'd20;  /* Wait cycles for read */
+					state_d = BURST_RD_EXEC;
+				end else begin
+					bit_cnt_d = 15;
+					state_d = BURST_DATA;
+				end
 			end
 		end
 
@@ -185,6 +195,33 @@ always @(*) begin
 			end
 		end
 
+		BURST_RD_EXEC: begin
+			wait_cnt_d = wait_cnt - 1'b1;
+			if (wait_cnt == 8'd10) begin
+				/* Sample read data mid-cycle */
+				rd_data_reg_d = bpi_dq;
+			end
+			if (wait_cnt == 0) begin
+				bit_cnt_d = 15;
+				state_d = BURST_RD_SEND;
+			end
+		end
+
+		BURST_RD_SEND: begin
+			rd_data_reg_d = {1'b1, rd_data_reg[15:1]};
+			bit_cnt_d = bit_cnt - 1'b1;
+			if (bit_cnt == 0) begin
+				burst_cnt_d = burst_cnt - 1'b1;
+				if (burst_cnt == 16'd1) begin
+					state_d = DONE;
+				end else begin
+					addr_reg_d = addr_reg + 1'b1;
+					wait_cnt_d = 8'd20;
+					state_d = BURST_RD_EXEC;
+				end
+			end
+		end
+
 		DONE: begin
 			/* Stay here until reset */
 		end
@@ -220,6 +257,8 @@ always @(posedge drck or posedge rst) begin
 		bpi_addr <= {tdi, addr_reg[24:1]};
 	else if (state == BURST_DATA && bit_cnt == 0)
 		bpi_addr <= addr_reg;
+	else if (state == BURST_RD_SEND && bit_cnt == 0)
+		bpi_addr <= addr_reg + 1'b1;
 end
 
 /* BPI Flash control signals */
@@ -247,6 +286,13 @@ always @(posedge drck or posedge rst) begin
 					dq_out   <= wr_data_reg;
 				end
 			end
+			BURST_RD_EXEC: begin
+				bpi_ce_n  <= 1'b0;
+				bpi_adv_n <= 1'b0;
+				bpi_oe_n  <= 1'b0;
+				bpi_we_n  <= 1'b1;
+				dq_oe     <= 1'b0;
+			end
 			BURST_EXEC: begin
 				bpi_ce_n  <= 1'b0;
 				bpi_adv_n <= 1'b0;
@@ -272,7 +318,7 @@ end
 wire ver_rst = (ver_cap & ver_sel);
 wire ver_start = (ver_tdi & ver_shift & ver_sel);
 
-localparam VER_VALUE = 40'h30_32_2E_30_30; // "02.00"
+localparam VER_VALUE = 40'h30_31_2E_32_30; // "02.10"
 
 reg [6:0] ver_cnt, ver_cnt_d;
 reg [39:0] ver_shft, ver_shft_d;
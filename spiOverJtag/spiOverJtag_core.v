@@ -63,8 +63,10 @@ localparam hdr_len = 16;
 reg  [hdr_len-1:0] header;     /* number of bits to receive / send in XFER state */
 reg  [hdr_len-1:0] header_d;
 /* Primary header with mode and length LSB
- * 6:5: mode (00: normal, 01: no header2, 10: infinite loop)
+ * 6:5: mode (00: normal, 01: no header2, 10: infinite loop,
+ *            11: poll status register)
  * 4:0: Byte length LSB
+ * In poll mode secondary header is 16bits wide: 7:0 mask, 15:8 value
  */
 reg  [        6:0] header1;
 reg  [        6:0] header1_d;
@@ -75,6 +77,14 @@ wire [hdr_len-1:0] header_next = {tdi, header[hdr_len-1:1]};
 reg  [        3:0] hdr_cnt; /* counter of bit received in RECV_HEADERx states */
 reg  [        3:0] hdr_cnt_d;
 
+/* poll mode: status register read back, bit counter and completion flag */
+reg  [        7:0] poll_sr;
+wire [        7:0] poll_sr_next = {poll_sr[6:0], sdo_dq1};
+reg  [        4:0] poll_cnt;
+reg  [        4:0] poll_cnt_d;
+reg                poll_done;
+reg                poll_done_d;
+
 /* ---------------- */
 /*       FSM        */
 /* ---------------- */
@@ -83,7 +93,8 @@ localparam IDLE  = 3'b000,
 	RECV_HEADER1 = 3'b001,
 	RECV_HEADER2 = 3'b010,
 	XFER         = 3'b011,
-	WAIT_END     = 3'b100;
+	WAIT_END     = 3'b100,
+	POLL         = 3'b101;
 
 reg [2:0] jtag_state, jtag_state_d;
 
@@ -95,6 +106,8 @@ always @(*) begin
 	hdr_cnt_d    = hdr_cnt;
 	header_d     = header;
 	header1_d    = header1;
+	poll_cnt_d   = poll_cnt;
+	poll_done_d  = poll_done;
 	case (jtag_state)
 		IDLE: begin /* nothing: wait for the 'start bit' */
 			hdr_cnt_d = 6;
@@ -110,6 +123,10 @@ always @(*) begin
 					hdr_cnt_d    = 7;
 					header_d     = {header1_next[6:2], 3'b000, 8'd0};
 					jtag_state_d = RECV_HEADER2;
+				end else if (header1_next[1:0] == 2'b11) begin
+					hdr_cnt_d    = 15;
+					header_d     = 16'd0;
+					jtag_state_d = RECV_HEADER2;
 				end else begin
 					header_d     = {8'b0, header1_next[6:2], 3'b000};
 					jtag_state_d = XFER;
@@ -121,7 +138,23 @@ always @(*) begin
 			hdr_cnt_d = hdr_cnt - 1'b1;
 			header_d  = header_next;
 			if (hdr_cnt == 0) begin
-				jtag_state_d = XFER;
+				if (mode == 2'b11) begin
+					/* 8 cmd bits + 1 latency bit + 8 status bits */
+					poll_cnt_d   = 16;
+					poll_done_d  = 1'b0;
+					jtag_state_d = POLL;
+				end else begin
+					jtag_state_d = XFER;
+				end
+			end
+		end
+		POLL: begin /* flash returns status register continuously: compare each byte */
+			if (poll_cnt == 0) begin
+				poll_cnt_d = 7;
+				if ((poll_sr_next & header[7:0]) == header[15:8])
+					poll_done_d = 1'b1;
+			end else begin
+				poll_cnt_d = poll_cnt - 1'b1;
 			end
 		end
 		XFER: begin
@@ -142,6 +175,15 @@ always @(posedge drck) begin
 	header  <= header_d;
 	header1 <= header1_d;
 	hdr_cnt <= hdr_cnt_d;
+	poll_sr <= poll_sr_next;
+	poll_cnt <= poll_cnt_d;
+end
+
+always @(posedge drck or posedge rst) begin
+	if (rst)
+		poll_done <= 1'b0;
+	else
+		poll_done <= poll_done_d;
 end
 
 always @(posedge drck or posedge rst) begin
@@ -159,12 +201,12 @@ always @(posedge drck or posedge rst) begin
 		csn     <= 1'b1;
 	end else begin
 		sdi_dq0 <= tdi;
-		csn     <= ~(jtag_state == XFER);
+		csn     <= ~((jtag_state == XFER) || (jtag_state == POLL));
 	end
 end
 
 assign sck      = ~drck;
-assign tdo      = sdo_dq1;
+assign tdo      = (jtag_state == POLL) ? poll_done : sdo_dq1;
 assign wpn_dq2  = 1'b1;
 assign hldn_dq3 = 1'b1;
 
@@ -177,7 +219,7 @@ wire ver_rst = (ver_cap & ver_sel);
 /* start bit */
 wire ver_start = (ver_tdi & ver_shift & ver_sel);
 
-localparam VER_VALUE = 40'h30_30_2E_32_30; // 02.00
+localparam VER_VALUE = 40'h30_31_2E_32_30; // 02.10
 reg [ 6:0] ver_cnt, ver_cnt_d;
 reg [39:0] ver_shft, ver_shft_d;
 
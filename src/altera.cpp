@@ -10,6 +10,7 @@
 
 #include <map>
 #include <string>
+#include <vector>
 
 #include "common.hpp"
 #include "device.hpp"
@@ -27,6 +28,13 @@
 #define BYPASS 0x3FF
 #define IRLENGTH 10
 
+/* programMem: min chunk size (Bytes) when cable buffer is smaller/unknown */
+#define SRAM_MIN_XFER_LEN 4096
+/* programMem: CONF_DONE position in 864 bits status scan (from one device
+ * SVF, not verified for all families)
+ */
+#define CONF_DONE_BIT 163
+
 Altera::Altera(Jtag *jtag, const std::string &filename,
 	const std::string &file_type, Device::prog_type_t prg_type,
 	const std::string &device_package,
@@ -118,12 +126,17 @@ void Altera::programMem(RawParser &_bit)
 	/* write */
 	ProgressBar progress("Load SRAM", byte_length, 50, _quiet);
 
-	int xfer_len = 512;
+	/* bitstream is sent directly from parser buffer, by chunks
+	 * sized from cable buffer (only used for progress bar update)
+	 */
+	int xfer_len = _jtag->get_ll_class()->get_buffer_size();
+	if (xfer_len < SRAM_MIN_XFER_LEN)
+		xfer_len = SRAM_MIN_XFER_LEN;
 	int tx_len;
 	Jtag::tapState_t tx_end;
 
 	for (int i=0; i < byte_length; i+=xfer_len) {
-		if (i + xfer_len > byte_length) {  // last packet with some size
+		if (i + xfer_len >= byte_length) {  // last packet with some size
 			tx_len = (byte_length - i) * 8;
 			tx_end = Jtag::EXIT1_DR;
 		} else {
@@ -151,7 +164,6 @@ void Altera::programMem(RawParser &_bit)
 	 *         0000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000080000000000000000000000000000000000000000);
 	 */
 	_jtag->shiftDR(tx, rx, 864, Jtag::RUN_TEST_IDLE);
-	/* TBD -> something to check */
 	/* SIR 10 TDI (003); */
 	*reinterpret_cast<uint16_t *>(cmd) = 0x003;
 	_jtag->shiftIR(cmd, NULL, IRLENGTH, Jtag::PAUSE_IR);
@@ -170,6 +182,16 @@ void Altera::programMem(RawParser &_bit)
 	_jtag->toggleClk(1000000/_clk_period);
 	/* -> idle */
 	_jtag->set_state(Jtag::RUN_TEST_IDLE);
+	_jtag->flush();
+
+	/* status scan: TDO bit 163 (MASK above) is CONF_DONE for the device
+	 * this sequence comes from. programMem is used by all families
+	 * (and to load the spiOverJtag bridge) but the status layout is
+	 * not known for each of them: only warn
+	 */
+	if (((rx[CONF_DONE_BIT >> 3] >> (CONF_DONE_BIT & 0x07)) & 0x01) == 0)
+		printWarn("Load SRAM: CONF_DONE not set in status scan, "
+			"configuration may have failed");
 }
 
 bool Altera::post_flash_access()
@@ -673,34 +695,35 @@ void Altera::writeXFM(const uint8_t *cfg_data, uint32_t base_addr, uint32_t offs
 
 	ProgressBar progress("Write Flash", len, 50, _quiet);
 	for (uint32_t i = 0; i < len; i+=512) {
-		bool must_send_sir = true;
 		uint32_t max = (i + 512 <= len)? 512 : len - i;
-		for (uint32_t ii = 0; ii < max; ii++) {
-			const uint32_t data = ARRAY2INT32(ptr);
-			progress.display(i);
-
+		progress.display(i);
+		for (uint32_t ii = 0; ii < max;) {
 			/* flash was erased before: to save time skip write when cfg_data
 			 * contains only bit set to high
 			 */
-			if (data == 0xffffffff) {
-				must_send_sir = true;
+			if (ARRAY2INT32(ptr) == 0xffffffff) {
 				ptr += 4;
+				ii++;
 				continue;
 			}
 
+			/* run of consecutive words to program */
+			uint32_t nb_words = 1;
+			for (const uint8_t *next = ptr + 4; ii + nb_words < max &&
+					ARRAY2INT32(next) != 0xffffffff; next += 4)
+				nb_words++;
+
 			/* TODO: match more or less svf but not bsdl */
-			if (must_send_sir) {
-				/* Set base addr */
-				max10_addr_shift(base_addr + i + ii);
+			/* Set base addr */
+			max10_addr_shift(base_addr + i + ii);
 
-				/* set ISC_PROGRAM/DSM_PROGRAM */
-				_jtag->shiftIR((unsigned char *)isc_program, NULL, IRLENGTH, Jtag::PAUSE_IR);
-				must_send_sir = false;
-			}
+			/* set ISC_PROGRAM/DSM_PROGRAM */
+			_jtag->shiftIR((unsigned char *)isc_program, NULL, IRLENGTH, Jtag::PAUSE_IR);
 
-			_jtag->shiftDR(ptr, NULL, 32, Jtag::RUN_TEST_IDLE);
-			_jtag->toggleClk(isc_program2_delay);
-			ptr += 4;
+			/* one scan per word followed by the program delay: write only */
+			_jtag->shiftDR_batch(ptr, NULL, 32, nb_words, isc_program2_delay);
+			ptr += 4 * nb_words;
+			ii += nb_words;
 		}
 	}
 	progress.done();
@@ -713,6 +736,7 @@ uint32_t Altera::verifyxFM(const uint8_t *cfg_data, uint32_t base_addr, uint32_t
 
 	const uint8_t read_cmd[2] = MAX10_ISC_READ;
 	uint32_t errors = 0;
+	std::vector<uint8_t> rx(512 * 4);
 
 	ProgressBar progress("Verify", len, 50, _quiet);
 	for (uint32_t i = 0; i < len; i+=512) {
@@ -725,11 +749,12 @@ uint32_t Altera::verifyxFM(const uint8_t *cfg_data, uint32_t base_addr, uint32_t
 		/* send read command */
 		_jtag->shiftIR((unsigned char *)read_cmd, NULL, IRLENGTH, Jtag::PAUSE_IR);
 
-		for (uint32_t ii = 0; ii < max; ii++) {
-			uint8_t data[4];
-
-			_jtag->shiftDR(NULL, data, 32, Jtag::RUN_TEST_IDLE);
-			/* TODO: compare */
+		/* read the full block (one scan per word) then compare */
+		_jtag->shiftDR_batch(NULL, rx.data(), 32, max);
+		for (uint32_t ii = 0; ii < max; ii++, ptr += 4) {
+			const uint8_t *data = &rx[ii * 4];
+			if (memcmp(ptr, data, 4) == 0)
+				continue;
 			for (uint8_t pos = 0; pos < 4; pos++) {
 				if (ptr[pos] != data[pos]) {
 					printf("Error@%d: %02x %02x %02x %02x ", pos, data[0], data[1], data[2], data[3]);
@@ -738,7 +763,6 @@ uint32_t Altera::verifyxFM(const uint8_t *cfg_data, uint32_t base_addr, uint32_t
 					break;
 				}
 			}
-			ptr += 4;
 		}
 	}
 	if (errors == 0)
@@ -890,6 +914,7 @@ void Altera::max10_flow_program_donebit(const uint32_t done_bit_addr)
 bool Altera::max10_read_section(FILE *fd, const uint32_t base_addr, const uint32_t len)
 {
 	const uint8_t read_cmd[2] = MAX10_ISC_READ;
+	std::vector<uint8_t> rx(512 * 4);
 
 	ProgressBar progress("Dump", len, 50, _quiet);
 	for (uint32_t i = 0; i < len; i += 512) {
@@ -902,12 +927,9 @@ bool Altera::max10_read_section(FILE *fd, const uint32_t base_addr, const uint32
 		/* send read command */
 		_jtag->shiftIR((unsigned char *)read_cmd, NULL, IRLENGTH, Jtag::PAUSE_IR);
 
-		for (uint32_t ii = 0; ii < max; ii++) {
-			uint8_t data[4];
-
-			_jtag->shiftDR(NULL, data, 32, Jtag::RUN_TEST_IDLE);
-			fwrite(data, sizeof(uint8_t), 4, fd);
-		}
+		/* read the full block (one scan per word) */
+		_jtag->shiftDR_batch(NULL, rx.data(), 32, max);
+		fwrite(rx.data(), sizeof(uint8_t), max * 4, fd);
 	}
 	progress.done();
 
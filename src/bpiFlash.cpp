@@ -7,6 +7,7 @@
 #include "bpiFlash.hpp"
 
 #include <unistd.h>
+#include <cstdlib>
 #include <cstring>
 #include <stdexcept>
 #include <vector>
@@ -31,7 +32,9 @@ BPIFlash::BPIFlash(Jtag *jtag, int8_t verbose)
 	: _jtag(jtag), _verbose(verbose), _irlen(6),
 	  _capacity(0), _block_size(256 * 1024),
 	  _manufacturer_id(0), _device_id(0),
-	  _has_burst(false)
+	  _has_burst(false), _has_burst_read(false),
+	  _buf_prog_typ_us(1000), _buf_prog_max_us(5000000),
+	  _erase_typ_us(1000000), _erase_max_us(30000000)
 {
 }
 
@@ -49,6 +52,7 @@ BPIFlash::~BPIFlash()
  *   0x2 = Read word
  *   0x3 = NOP
  *   0x4 = Burst write (addr + count + N×data words)
+ *   0x5 = Burst read (addr + count), N×(20 exec + 1 + 16 data) returned
  */
 
 uint16_t BPIFlash::bpi_read(uint32_t word_addr)
@@ -161,6 +165,15 @@ void BPIFlash::bpi_write_no_flush(uint32_t word_addr, uint16_t data)
 
 void BPIFlash::bpi_burst_write(uint32_t word_addr, const uint16_t *data,
 				uint32_t count)
+{
+	uint8_t user1[] = {0x02};
+	_jtag->shiftIR(user1, NULL, _irlen);
+	bpi_burst_write_no_flush(word_addr, data, count);
+	_jtag->flush();
+}
+
+void BPIFlash::bpi_burst_write_no_flush(uint32_t word_addr,
+				const uint16_t *data, uint32_t count)
 {
 	if (count == 0)
 		return;
@@ -218,10 +231,105 @@ void BPIFlash::bpi_burst_write(uint32_t word_addr, const uint16_t *data,
 		pos += 21;  /* 20 exec cycles + 1 transition cycle */
 	}
 
+	_jtag->shiftDR(tx.data(), NULL, total_bits);
+}
+
+void BPIFlash::bpi_burst_read(uint32_t word_addr, uint16_t *data,
+				uint32_t count)
+{
+	if (count == 0)
+		return;
+
+	/* Burst read packet: start(1) + cmd(4) + addr(25) + count(16)
+	 * Then for each word: 21 exec cycles, followed by 16 data bits
+	 */
+	const uint32_t header_bits = 1 + 4 + 25 + 16;  /* 46 */
+	const uint32_t exec_bits = 20 + 1;              /* exec + pipeline delay */
+	const uint32_t per_word_bits = exec_bits + 16;  /* 37 */
+	const uint32_t total_bits = header_bits + count * per_word_bits;
+	const uint32_t total_bytes = (total_bits + 7) / 8;
+
+	std::vector<uint8_t> tx(total_bytes, 0);
+	std::vector<uint8_t> rx(total_bytes + 2, 0);  /* +2: 24bits extract */
+
+	uint64_t packet = 1;                                 /* start bit */
+	packet |= ((uint64_t)CMD_BURST_READ) << 1;           /* cmd at bits [4:1] */
+	packet |= ((uint64_t)(word_addr & 0x1FFFFFF)) << 5;  /* addr at bits [29:5] */
+	packet |= ((uint64_t)(count & 0xFFFF)) << 30;        /* count at bits [45:30] */
+	for (int i = 0; i < 6; i++)
+		tx[i] = (packet >> (i * 8)) & 0xFF;
+
 	uint8_t user1[] = {0x02};
 	_jtag->shiftIR(user1, NULL, _irlen);
-	_jtag->shiftDR(tx.data(), NULL, total_bits);
+	_jtag->shiftDR(tx.data(), rx.data(), total_bits);
 	_jtag->flush();
+
+	for (uint32_t w = 0; w < count; w++) {
+		const uint32_t bit_pos = header_bits + exec_bits + w * per_word_bits;
+		const uint8_t *ptr = &rx[bit_pos >> 3];
+		const uint32_t v = ptr[0] | (ptr[1] << 8) | (ptr[2] << 16);
+		data[w] = (v >> (bit_pos & 0x07)) & 0xFFFF;
+	}
+}
+
+float BPIFlash::bridge_version()
+{
+	uint8_t jtx[6] = {0x01, 0x00, 0x00, 0x00, 0x00, 0x00};
+	uint8_t jrx[6];
+	char ver[6];
+
+	/* Select USER4 instruction (version endpoint) */
+	uint8_t user4[] = {0x23};
+	_jtag->shiftIR(user4, NULL, _irlen);
+	_jtag->shiftDR(jtx, jrx, 6 * 8);
+	_jtag->flush();
+
+	memcpy(ver, &jrx[1], 5);
+	ver[5] = '\0';
+	return atof(ver);
+}
+
+bool BPIFlash::read_cfi_timings()
+{
+	/* CFI query: command at word address 0x55, table at 0x10 */
+	bpi_write(0x55, FLASH_CMD_READ_CFI);
+	usleep(100);
+
+	uint16_t cfi[0x16];
+	for (uint32_t i = 0; i < 0x16; i++)
+		cfi[i] = bpi_read(0x10 + i) & 0xFF;
+
+	bpi_write(0, FLASH_CMD_READ_ARRAY);
+	usleep(100);
+
+	if (cfi[0] != 'Q' || cfi[1] != 'R' || cfi[2] != 'Y')
+		return false;
+
+	/* 0x20: typical buffer write 2^n us, 0x24: max = typical * 2^n
+	 * 0x21: typical block erase 2^n ms, 0x25: max = typical * 2^n
+	 * 0 means not supported
+	 */
+	const uint8_t buf_typ = cfi[0x20 - 0x10], buf_max = cfi[0x24 - 0x10];
+	const uint8_t ers_typ = cfi[0x21 - 0x10], ers_max = cfi[0x25 - 0x10];
+	if (buf_typ != 0 && buf_typ < 16 && buf_max < 16) {
+		_buf_prog_typ_us = 1u << buf_typ;
+		/* keep a 2x margin over the datasheet max */
+		_buf_prog_max_us = 2 * (_buf_prog_typ_us << buf_max);
+	}
+	if (ers_typ != 0 && ers_typ <= 12 && ers_max <= 4) {
+		_erase_typ_us = (1u << ers_typ) * 1000;
+		_erase_max_us = 2 * (_erase_typ_us << ers_max);
+	}
+
+	if (_verbose) {
+		char buf[128];
+		snprintf(buf, sizeof(buf),
+			"CFI timings: buffer program %u/%u us, block erase %u/%u ms",
+			_buf_prog_typ_us, _buf_prog_max_us,
+			_erase_typ_us / 1000, _erase_max_us / 1000);
+		printInfo(buf);
+	}
+	return true;
 }
 
 bool BPIFlash::detect()
@@ -285,19 +393,32 @@ bool BPIFlash::detect()
 	 */
 	_has_burst = true;
 
+	if (!read_cfi_timings())
+		printWarn("CFI query failed: using default timings");
+
+	/* Burst read requires v02.10+ bridge */
+	const float version = bridge_version();
+	_has_burst_read = version >= 2.1f;
+	if (_verbose) {
+		char buf[64];
+		snprintf(buf, sizeof(buf), "BPI bridge version: %.2f", version);
+		printInfo(buf);
+	}
+
 	return true;
 }
 
-bool BPIFlash::wait_ready(uint32_t timeout_ms)
+bool BPIFlash::wait_ready(uint32_t typ_us, uint32_t max_us)
 {
-	uint32_t elapsed = 0;
-	const uint32_t poll_interval = 10;
+	/* poll interval starts at typ/8 and grows up to typ/2 */
+	const uint32_t max_interval = (typ_us / 2 > 10) ? typ_us / 2 : 10;
+	uint32_t poll_interval = (typ_us / 8 > 10) ? typ_us / 8 : 10;
+	uint32_t elapsed = typ_us;
 
-	/* Issue read status command */
-	bpi_write(0, FLASH_CMD_READ_STATUS);
-	usleep(100);
+	/* nothing to do before typical operation time */
+	usleep(typ_us);
 
-	while (elapsed < timeout_ms) {
+	while (true) {
 		uint16_t status = bpi_read(0);
 
 		/* Intel CFI status register is 8 bits, upper byte undefined */
@@ -316,8 +437,14 @@ bool BPIFlash::wait_ready(uint32_t timeout_ms)
 			return true;
 		}
 
-		usleep(poll_interval * 1000);
+		if (elapsed >= max_us)
+			break;
+
+		usleep(poll_interval);
 		elapsed += poll_interval;
+		if (poll_interval < max_interval)
+			poll_interval = (2 * poll_interval > max_interval) ?
+				max_interval : 2 * poll_interval;
 	}
 
 	printError("BPI Flash timeout");
@@ -326,10 +453,9 @@ bool BPIFlash::wait_ready(uint32_t timeout_ms)
 
 bool BPIFlash::unlock_block(uint32_t word_addr)
 {
-	bpi_write(word_addr, FLASH_CMD_UNLOCK_BLOCK);
-	usleep(100);
-	bpi_write(word_addr, FLASH_CMD_UNLOCK_CONF);
-	usleep(100);
+	/* caller selects USER1 and flushes */
+	bpi_write_no_flush(word_addr, FLASH_CMD_UNLOCK_BLOCK);
+	bpi_write_no_flush(word_addr, FLASH_CMD_UNLOCK_CONF);
 	return true;
 }
 
@@ -343,14 +469,16 @@ bool BPIFlash::erase_block(uint32_t addr)
 		printInfo(buf);
 	}
 
+	/* unlock, erase, confirm and read status in one transfer */
+	uint8_t user1[] = {0x02};
+	_jtag->shiftIR(user1, NULL, _irlen);
 	unlock_block(word_addr);
+	bpi_write_no_flush(word_addr, FLASH_CMD_BLOCK_ERASE);
+	bpi_write_no_flush(word_addr, FLASH_CMD_CONFIRM);
+	bpi_write_no_flush(0, FLASH_CMD_READ_STATUS);
+	_jtag->flush();
 
-	/* Block erase command sequence */
-	bpi_write(word_addr, FLASH_CMD_BLOCK_ERASE);
-	usleep(100);
-	bpi_write(word_addr, FLASH_CMD_CONFIRM);
-
-	if (!wait_ready(30000)) {
+	if (!wait_ready(_erase_typ_us, _erase_max_us)) {
 		printError("Block erase failed");
 		return false;
 	}
@@ -407,6 +535,32 @@ bool BPIFlash::read(uint8_t *data, uint32_t addr, uint32_t len)
 
 	ProgressBar progress("Reading", len, 50, _verbose > 0);
 
+	if (_has_burst_read) {
+		std::vector<uint16_t> words(BURST_READ_WORDS);
+		for (uint32_t i = 0; i < len;) {
+			const uint32_t word_addr = (addr + i) >> 1;
+			uint32_t count = (len - i + 1) / 2;
+			if (count > BURST_READ_WORDS)
+				count = BURST_READ_WORDS;
+			bpi_burst_read(word_addr, words.data(), count);
+
+			for (uint32_t w = 0; w < count; w++, i += 2) {
+				data[i] = reverseByte((words[w] >> 8) & 0xFF);
+				if (i + 1 < len)
+					data[i + 1] = reverseByte(words[w] & 0xFF);
+			}
+			progress.display(i < len ? i : len);
+		}
+		progress.done();
+		return true;
+	}
+
+	/* shipped bpiOverJtag bitstreams are v02.00: burst read requires
+	 * a bridge rebuilt from bpiOverJtag_core.v (v02.10+)
+	 */
+	printWarn("BPI bridge without burst read (v02.10+ required): "
+		"using slower per-word reads");
+
 	for (uint32_t i = 0; i < len; i += 2) {
 		uint32_t word_addr = (addr + i) >> 1;
 		uint16_t word = bpi_read(word_addr);
@@ -464,6 +618,10 @@ bool BPIFlash::write(uint32_t addr, const uint8_t *data, uint32_t len)
 		/* Calculate block address (word address of block start) */
 		uint32_t block_word_addr = (byte_addr / _block_size) * (_block_size >> 1);
 
+		/* Whole buffered program sequence is queued in one transfer */
+		uint8_t user1[] = {0x02};
+		_jtag->shiftIR(user1, NULL, _irlen);
+
 		/* Unlock only when entering a new block */
 		uint32_t current_block = byte_addr / _block_size;
 		if (current_block != last_block) {
@@ -505,27 +663,26 @@ bool BPIFlash::write(uint32_t addr, const uint8_t *data, uint32_t len)
 		}
 
 		/* Buffered Program Setup - sent to block/colony base address */
-		bpi_write(0, FLASH_CMD_CLEAR_STATUS);
-		bpi_write(block_word_addr, FLASH_CMD_BUFFERED_PRG);
-		bpi_write(block_word_addr, chunk_words - 1);
+		bpi_write_no_flush(0, FLASH_CMD_CLEAR_STATUS);
+		bpi_write_no_flush(block_word_addr, FLASH_CMD_BUFFERED_PRG);
+		bpi_write_no_flush(block_word_addr, chunk_words - 1);
 
 		if (_has_burst) {
-			bpi_burst_write(word_addr, word_buf.data(), chunk_words);
+			bpi_burst_write_no_flush(word_addr, word_buf.data(), chunk_words);
 		} else {
-			/* Software-only fallback: one IR, no per-word flush */
-			uint8_t user1[] = {0x02};
-			_jtag->shiftIR(user1, NULL, _irlen);
+			/* Software-only fallback: no per-word flush */
 			for (uint32_t w = 0; w < chunk_words; w++) {
 				bpi_write_no_flush(word_addr + w, word_buf[w]);
 			}
-			_jtag->flush();
 		}
 
-		/* Confirm - sent to block address */
-		bpi_write(block_word_addr, FLASH_CMD_CONFIRM);
+		/* Confirm - sent to block address, then switch to status read */
+		bpi_write_no_flush(block_word_addr, FLASH_CMD_CONFIRM);
+		bpi_write_no_flush(0, FLASH_CMD_READ_STATUS);
+		_jtag->flush();
 
 		/* Wait for program to complete */
-		if (!wait_ready(5000)) {
+		if (!wait_ready(_buf_prog_typ_us, _buf_prog_max_us)) {
 			char buf[64];
 			snprintf(buf, sizeof(buf), "Buffered program failed at address 0x%06x", byte_addr);
 			printError(buf);
@@ -74,6 +74,10 @@ class BPIFlash {
 	static const uint8_t CMD_READ        = 0x2;
 	static const uint8_t CMD_NOP         = 0x3;
 	static const uint8_t CMD_BURST_WRITE = 0x4;
+	static const uint8_t CMD_BURST_READ  = 0x5;
+
+	/* Max number of words read with one burst read command */
+	static const uint32_t BURST_READ_WORDS = 4096;
 
 	/* Intel CFI flash commands */
 	static const uint16_t FLASH_CMD_READ_ARRAY   = 0x00FF;
@@ -117,10 +121,39 @@ class BPIFlash {
 			     uint32_t count);
 
 	/*!
-	 * \brief Wait for operation to complete
+	 * \brief Burst write without IR shift or flush (for batched writes)
+	 */
+	void bpi_burst_write_no_flush(uint32_t word_addr, const uint16_t *data,
+			     uint32_t count);
+
+	/*!
+	 * \brief Burst read count 16-bit words starting at word_addr
+	 *        in a single DR shift (bridge v02.10+)
+	 */
+	void bpi_burst_read(uint32_t word_addr, uint16_t *data,
+			    uint32_t count);
+
+	/*!
+	 * \brief Read bridge version through USER4
+	 * \return version (0.0 when not available)
+	 */
+	float bridge_version();
+
+	/*!
+	 * \brief Read CFI query timing fields (buffer program and block erase)
+	 * \return true if CFI query table is valid
+	 */
+	bool read_cfi_timings();
+
+	/*!
+	 * \brief Wait for operation to complete. Flash must already be in
+	 *        read status mode. First status read is done after typ_us,
+	 *        then polling interval grows until max_us is reached
+	 * \param[in] typ_us: typical operation time (us)
+	 * \param[in] max_us: timeout (us)
 	 * \return true if completed successfully
 	 */
-	bool wait_ready(uint32_t timeout_ms = 10000);
+	bool wait_ready(uint32_t typ_us, uint32_t max_us);
 
 	/*!
 	 * \brief Unlock a block for programming/erase
@@ -135,6 +168,11 @@ class BPIFlash {
 	uint16_t _manufacturer_id;
 	uint16_t _device_id;
 	bool _has_burst;
+	bool _has_burst_read;
+	uint32_t _buf_prog_typ_us; /**< typical buffer program time (CFI) */
+	uint32_t _buf_prog_max_us; /**< max buffer program time (CFI) */
+	uint32_t _erase_typ_us;    /**< typical block erase time (CFI) */
+	uint32_t _erase_max_us;    /**< max block erase time (CFI) */
 };
 
 #endif  // SRC_BPIFLASH_HPP_
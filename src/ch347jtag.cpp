@@ -34,6 +34,10 @@
 #define CH347JTAG_READ_EP     0x86
 
 #define CH347JTAG_TIMEOUT     1000
+/* command blocks kept in flight: the next one is filled while the
+ * previous ones are transferred
+ */
+#define CH347JTAG_MAX_PENDING 8
 
 enum CH347JtagCmd {
 	CMD_BYTES_WO = 0xd3,
@@ -50,10 +54,10 @@ enum CH347JtagSig {
 };
 
 // defer should only be used with rlen == 0
+// with rlen != 0 the answer is waited and copied in ibuf
 
-int CH347Jtag::usb_xfer(unsigned wlen, unsigned rlen, unsigned *ract, bool defer) 
+int CH347Jtag::usb_xfer(unsigned wlen, unsigned rlen, unsigned *ract, bool defer)
 {
-	int actual_length = 0;
 	if (_verbose) {
 		fprintf(stderr, "usb_xfer: deferred: %ld\n", obuf - _obuf);
 	}
@@ -62,6 +66,28 @@ int CH347Jtag::usb_xfer(unsigned wlen, unsigned rlen, unsigned *ract, bool defer
 		return 0;
 	}
 
+	ch347_xfer_t *xfer = nullptr;
+	int r = submit_obuf(wlen, rlen, nullptr, 0, &xfer);
+	if (r < 0 || !rlen || !xfer)
+		return r;
+
+	if ((r = finish_xfer(xfer)) < 0)
+		return r;
+	memcpy(ibuf, xfer->ibuf, xfer->ract);
+	if (_verbose) {
+		fprintf(stderr, "ibuf[%d] = {", xfer->ract);
+		for (unsigned i = 0; i < xfer->ract; ++i) {
+			fprintf(stderr, "%02x ", ibuf[i]);
+		}
+		fprintf(stderr, "}\n\n");
+	}
+	*ract = xfer->ract;
+	return 0;
+}
+
+int CH347Jtag::submit_obuf(unsigned wlen, unsigned rlen, uint8_t *rx,
+		uint8_t rd_cmd, ch347_xfer_t **used)
+{
 	if (obuf - _obuf > MAX_BUFFER) {
 		throw std::runtime_error("buffer overflow");
 	}
@@ -84,43 +110,155 @@ int CH347Jtag::usb_xfer(unsigned wlen, unsigned rlen, unsigned *ract, bool defer
 		fprintf(stderr, "}\n\n");
 	}
 
-	int r = 0;
-	if (wlen) {
-		if ((r = libusb_bulk_transfer(dev_handle, CH347JTAG_WRITE_EP, obuf, wlen, &actual_length, CH347JTAG_TIMEOUT)) < 0 ) {
-			return r;
+	ch347_xfer_t *xfer = &_xfers[_xfer_idx];
+	xfer->rlen = rlen;
+	xfer->ract = 0;
+	xfer->rx = rx;
+	xfer->rd_cmd = rd_cmd;
+	xfer->error = false;
+
+	libusb_fill_bulk_transfer(xfer->wtrans, dev_handle, CH347JTAG_WRITE_EP,
+		xfer->obuf, wlen, xfer_cb, xfer, CH347JTAG_TIMEOUT);
+	int r = libusb_submit_transfer(xfer->wtrans);
+	if (r == 0) {
+		xfer->pending++;
+		if (rlen) {
+			libusb_fill_bulk_transfer(xfer->rtrans, dev_handle,
+				CH347JTAG_READ_EP, xfer->ibuf, rlen, xfer_cb, xfer,
+				CH347JTAG_TIMEOUT);
+			r = libusb_submit_transfer(xfer->rtrans);
+			if (r == 0) {
+				xfer->pending++;
+				_in_flight++;
+			}
 		}
 	}
-	if (_verbose) {
-		fprintf(stderr, "obuf[%d] = {", wlen);
-		for (unsigned i = 0; i < wlen; ++i) {
-			fprintf(stderr, "%02x ", obuf[i]);
+	if (r < 0) {
+		abort_xfers();
+		return r;
+	}
+	if (used)
+		*used = xfer;
+
+	/* next commands are written in the next block while this one
+	 * is transferred: the block must be free
+	 */
+	_xfer_idx = (_xfer_idx + 1) % _xfers.size();
+	_obuf = obuf = _xfers[_xfer_idx].obuf;
+	r = finish_xfer(&_xfers[_xfer_idx]);
+	if (r < 0)
+		abort_xfers();
+	return r;
+}
+
+void LIBUSB_CALL CH347Jtag::xfer_cb(struct libusb_transfer *transfer)
+{
+	ch347_xfer_t *xfer = static_cast<ch347_xfer_t *>(transfer->user_data);
+	CH347Jtag *self = xfer->owner;
+
+	if (transfer == xfer->rtrans) {
+		xfer->ract += transfer->actual_length;
+		/* answer split in more than one packet: the end may only be
+		 * waited when no other read is queued behind
+		 */
+		if (transfer->status == LIBUSB_TRANSFER_COMPLETED &&
+				xfer->ract < xfer->rlen && self->_in_flight == 1) {
+			transfer->buffer = xfer->ibuf + xfer->ract;
+			transfer->length = xfer->rlen - xfer->ract;
+			if (libusb_submit_transfer(transfer) == 0)
+				return;
 		}
-		fprintf(stderr, "}\n\n");
+		self->_in_flight--;
+		if (xfer->ract < xfer->rlen)
+			xfer->error = true;
+	} else if (transfer->actual_length != transfer->length) {
+		xfer->error = true;
+	}
+	if (transfer->status != LIBUSB_TRANSFER_COMPLETED)
+		xfer->error = true;
+	xfer->pending--;
+}
+
+int CH347Jtag::finish_xfer(ch347_xfer_t *xfer)
+{
+	while (xfer->pending > 0) {
+		struct timeval tv = {1, 0};
+		int r = libusb_handle_events_timeout_completed(usb_ctx, &tv, NULL);
+		if (r < 0 && r != LIBUSB_ERROR_INTERRUPTED)
+			return r;
 	}
-	obuf = _obuf;
-	int rlen_total = 0;
-	uint8_t *pibuf = ibuf;
-	if (rlen){
-		while (rlen) {
-			if ((r = libusb_bulk_transfer(dev_handle, CH347JTAG_READ_EP, pibuf, rlen, &actual_length, CH347JTAG_TIMEOUT)) < 0 ) {
-				return r;
-			}
-			if (_verbose) {
-				fprintf(stderr, "ibuf[%d] = {", actual_length);
-				for (int i = rlen_total; i < rlen_total + actual_length; ++i) {
-					fprintf(stderr, "%02x ", ibuf[i]);
-				}
-				fprintf(stderr, "}\n\n");
+	if (xfer->error) {
+		xfer->error = false;
+		xfer->rx = nullptr;
+		return LIBUSB_ERROR_IO;
+	}
+	if (!xfer->rx)
+		return 0;
+
+	uint8_t *rptr = xfer->rx;
+	xfer->rx = nullptr;
+	const uint8_t *rbuf = xfer->ibuf;
+	unsigned size = rbuf[1] + rbuf[2] * 0x100;
+	if (rbuf[0] != xfer->rd_cmd || xfer->ract - 3 != size) {
+		printError("writeTDI: invalid read data");
+		return LIBUSB_ERROR_IO;
+	}
+	if (xfer->rd_cmd == CMD_BYTES_WR) {
+		memcpy(rptr, &rbuf[3], size);
+	} else {
+		for (unsigned i = 0; i < size; ++i) {
+			if (rbuf[3 + i] == 0x01) {
+				*rptr |= (0x01 << i);
+			} else {
+				*rptr &= ~(0x01 << i);
 			}
-			rlen -= actual_length;
-			pibuf += actual_length;
-			rlen_total += actual_length;
 		}
-		*ract = rlen_total;
 	}
 	return 0;
 }
 
+int CH347Jtag::wait_xfers()
+{
+	for (size_t i = 1; i <= _xfers.size(); i++) {
+		int r = finish_xfer(&_xfers[(_xfer_idx + i) % _xfers.size()]);
+		if (r < 0) {
+			abort_xfers();
+			return r;
+		}
+	}
+	return 0;
+}
+
+void CH347Jtag::abort_xfers()
+{
+	for (auto &xfer : _xfers) {
+		if (xfer.pending > 0) {
+			libusb_cancel_transfer(xfer.wtrans);
+			libusb_cancel_transfer(xfer.rtrans);
+		}
+	}
+	for (auto &xfer : _xfers) {
+		while (xfer.pending > 0) {
+			struct timeval tv = {1, 0};
+			if (libusb_handle_events_timeout_completed(usb_ctx, &tv, NULL) < 0)
+				break;
+		}
+		xfer.pending = 0;
+		xfer.error = false;
+		xfer.rx = nullptr;
+	}
+	_in_flight = 0;
+	obuf = _obuf;
+}
+
+int CH347Jtag::flush()
+{
+	int r = usb_xfer(0, 0, 0, false);
+	if (r < 0)
+		return r;
+	return wait_xfers();
+}
+
 int CH347Jtag::setClk(const uint8_t &factor) {
 	// flush the obuf
 	usb_xfer(0, 0, 0, false); // is called from constructor, don't replace with virtual flush()
@@ -139,7 +277,8 @@ int CH347Jtag::setClk(const uint8_t &factor) {
 
 CH347Jtag::CH347Jtag(uint32_t clkHZ, int8_t verbose, int vid, int pid,
 		uint8_t bus_addr, uint8_t dev_addr): _verbose(verbose>1),
-		dev_handle(NULL), usb_ctx(NULL), obuf(_obuf), _tdi(0), _tms(0)
+		dev_handle(NULL), usb_ctx(NULL), _xfer_idx(0), _in_flight(0),
+		_obuf(ibuf), obuf(ibuf), _tdi(0), _tms(0)
 {
 	libusb_device** devs;
 	int actual_length = 0;
@@ -199,17 +338,27 @@ CH347Jtag::CH347Jtag(uint32_t clkHZ, int8_t verbose, int vid, int pid,
 		printError("libusb error while claiming CH347JTAG interface");
 		goto usb_close;
 	}
-	rtrans = libusb_alloc_transfer(0);
-	wtrans = libusb_alloc_transfer(0);
-	if (!rtrans || !wtrans) {
-		printError("libusb failed to alloc transfers");
-		goto usb_release;
+	_xfers.resize(CH347JTAG_MAX_PENDING);
+	for (auto &xfer : _xfers) {
+		memset(&xfer, 0, sizeof(xfer));
+		xfer.owner = this;
+		xfer.rtrans = libusb_alloc_transfer(0);
+		xfer.wtrans = libusb_alloc_transfer(0);
+		if (!xfer.rtrans || !xfer.wtrans) {
+			printError("libusb failed to alloc transfers");
+			goto usb_release;
+		}
 	}
+	_obuf = obuf = _xfers[0].obuf;
 	libusb_bulk_transfer(dev_handle, CH347JTAG_READ_EP, ibuf, 512,
 		&actual_length, CH347JTAG_TIMEOUT);
 	_setClkFreq(clkHZ);
 	return;
 usb_release:
+	for (auto &xfer : _xfers) {
+		libusb_free_transfer(xfer.rtrans);
+		libusb_free_transfer(xfer.wtrans);
+	}
 	libusb_release_interface(dev_handle, _jtagIntf);
 usb_close:
 	libusb_close(dev_handle);
@@ -221,8 +370,12 @@ err_exit:
 
 CH347Jtag::~CH347Jtag()
 {
-	if (rtrans) libusb_free_transfer(rtrans);
-	if (wtrans) libusb_free_transfer(wtrans);
+	if (dev_handle)
+		flush();
+	for (auto &xfer : _xfers) {
+		libusb_free_transfer(xfer.rtrans);
+		libusb_free_transfer(xfer.wtrans);
+	}
 
 	if (dev_handle) {
 		libusb_release_interface(dev_handle, _jtagIntf);
@@ -273,7 +426,7 @@ int CH347Jtag::writeTMS(const uint8_t *tms, uint32_t len, bool flush_buffer,
 	// 	flush();
 	// }
 	_tdi = (tdi) ? SIG_TDI : 0;
- 	flush();
+	usb_xfer(0, 0, 0, false);
 	uint8_t *ptr = obuf;
 	for (uint32_t i = 0; i < len; ++i) {
 		if (ptr == obuf) {
@@ -312,7 +465,7 @@ int CH347Jtag::toggleClk(__attribute__((unused)) uint8_t tms,
 	}
 	
 	if (get_obuf_length() < (int)(len * 2 + 4)) {
-		flush();
+		usb_xfer(0, 0, 0, false);
 	}
 
 	uint8_t *ptr = obuf;
@@ -353,7 +506,7 @@ int CH347Jtag::writeTDI(const uint8_t *tx, uint8_t *rx, uint32_t len, bool end)
 	uint8_t cmd = (rx != nullptr) ? CMD_BYTES_WR : CMD_BYTES_WO;
 	while (tptr < txend) {
 		if (get_obuf_length() < 4) {
-			flush();
+			usb_xfer(0, 0, 0, false);
 		}
 		int avail = get_obuf_length() - 3;
 		int chunk = (txend - tptr < avail)? txend - tptr: avail;
@@ -367,29 +520,30 @@ int CH347Jtag::writeTDI(const uint8_t *tx, uint8_t *rx, uint32_t len, bool end)
 		obuf[0] = cmd;
 		obuf[1] = chunk;
 		obuf[2] = chunk >> 8;
-		unsigned actual_length = 0;
-		int ret = usb_xfer(chunk + 3, (rx) ? chunk + 3 : 0, &actual_length, rx == 0 && get_obuf_length());
+		int ret;
+		/* TDO is decoded when the block completes (see finish_xfer) */
+		if (rx)
+			ret = submit_obuf(chunk + 3, chunk + 3, rptr, CMD_BYTES_WR);
+		else
+			ret = usb_xfer(chunk + 3, 0, 0, get_obuf_length());
 		if (ret < 0) {
 			printError(std::string("writeTDI: usb bulk read failed: ")
 				+ std::string(libusb_strerror(static_cast<libusb_error>(ret))));
 			return -EXIT_FAILURE;
 		}
-		if (!rx)
-			continue;
-		unsigned size = ibuf[1] + ibuf[2] * 0x100;
-		if (ibuf[0] != CMD_BYTES_WR || actual_length - 3 != size) {
-			printError("writeTDI: invalid read data: " + std::to_string(ret));
+		if (rx)
+			rptr += chunk;
+	}
+	if (bits == 0) {
+		if (rx && wait_xfers() < 0) {
+			printError("writeTDI: usb bulk read failed");
 			return -EXIT_FAILURE;
 		}
-		memcpy(rptr, &ibuf[3], size);
-		rptr += size;
-	}
-	unsigned actual_length;
-	if (bits == 0)
 		return len;
+	}
 	cmd = (rx) ? CMD_BITS_WR : CMD_BITS_WO;
 	if (get_obuf_length() < (int)(4 + bits * 2)) {
-		flush();
+		usb_xfer(0, 0, 0, false);
 	}
 	uint8_t *ptr = &obuf[3];
 	uint8_t x = 0;
@@ -410,7 +564,15 @@ int CH347Jtag::writeTDI(const uint8_t *tx, uint8_t *rx, uint32_t len, bool end)
 	obuf[0] = cmd;
 	obuf[1] = wlen - 3;
 	obuf[2] = (wlen - 3) >> 8;
-	int ret = usb_xfer(wlen, (rx) ? (bits + 3) : 0, &actual_length, rx == nullptr);
+	int ret;
+	if (rx) {
+		ret = submit_obuf(wlen, bits + 3, rptr, CMD_BITS_WR);
+		/* TDO must be available when returning */
+		if (ret >= 0)
+			ret = wait_xfers();
+	} else {
+		ret = usb_xfer(wlen, 0, 0, true);
+	}
 
 	if (ret < 0) {
 		printError(std::string("writeTDI: usb bulk read failed: ")
@@ -419,19 +581,5 @@ int CH347Jtag::writeTDI(const uint8_t *tx, uint8_t *rx, uint32_t len, bool end)
 	}
 	if (!rx)
 		return EXIT_SUCCESS;
-
-	unsigned size = ibuf[1] + ibuf[2] * 0x100;
-
-	if (ibuf[0] != CMD_BITS_WR || actual_length - 3 != size) {
-		printError("writeTDI: invalid read data: ");
-		return -EXIT_FAILURE;
-	}
-	for (unsigned i = 0; i < size; ++i) {
-		if (ibuf[3 + i] == 0x01) {
-			*rptr |= (0x01 << i);
-		}else{
-			*rptr &= ~(0x01 << i);
-		}	
-	}
 	return len;
 }
@@ -6,6 +6,8 @@
 
 #include <libusb.h>
 
+#include <vector>
+
 #include "jtagInterface.hpp"
 
 constexpr unsigned MAX_BUFFER = 512;
@@ -28,7 +30,7 @@ class CH347Jtag : public JtagInterface {
 
 	bool isFull() override {return get_obuf_length() == 0;}
 
-	int flush() override {return usb_xfer(0, 0, 0, false);}
+	int flush() override;
 
  private:
 	bool _verbose;
@@ -38,12 +40,41 @@ class CH347Jtag : public JtagInterface {
 
 	libusb_device_handle *dev_handle;
 	libusb_context *usb_ctx;
-	struct libusb_transfer *wtrans, *rtrans;
+
+	/* one command block with its optional answer */
+	struct ch347_xfer_t {
+		CH347Jtag *owner;
+		struct libusb_transfer *wtrans, *rtrans;
+		uint8_t obuf[MAX_BUFFER];
+		uint8_t ibuf[MAX_BUFFER];
+		int pending;    // transfers not yet completed
+		bool error;     // one transfer fails
+		unsigned rlen;  // expected answer length
+		unsigned ract;  // received answer length
+		uint8_t *rx;    // TDO destination (NULL: not decoded)
+		uint8_t rd_cmd; // CMD_BYTES_WR or CMD_BITS_WR
+	};
+	std::vector<ch347_xfer_t> _xfers;  // ring of command blocks
+	unsigned _xfer_idx;                // block currently filled
+	int _in_flight;                    // read transfers submitted
+
 	uint8_t ibuf[MAX_BUFFER];
-	uint8_t _obuf[MAX_BUFFER];
-	uint8_t *obuf;
+	uint8_t *_obuf;  // current block buffer
+	uint8_t *obuf;   // first free byte in _obuf
 	int get_obuf_length() const {return MAX_BUFFER - (obuf - _obuf);}
 	int usb_xfer(unsigned wlen, unsigned rlen, unsigned *actual, bool defer);
+	/* send current block, read answer asynchronously when rlen != 0
+	 * and switch to next block of the ring
+	 */
+	int submit_obuf(unsigned wlen, unsigned rlen, uint8_t *rx,
+		uint8_t rd_cmd, ch347_xfer_t **used = nullptr);
+	/* wait for block completion and decode answer in rx */
+	int finish_xfer(ch347_xfer_t *xfer);
+	/* wait for all blocks, oldest first */
+	int wait_xfers();
+	/* cancel all in flight transfers after an error */
+	void abort_xfers();
+	static void LIBUSB_CALL xfer_cb(struct libusb_transfer *transfer);
 
 	uint8_t _tdi;
 	uint8_t _tms;
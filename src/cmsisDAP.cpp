@@ -108,7 +108,8 @@ CmsisDAP::CmsisDAP(const cable_t &cable, int index, uint32_t clkHZ, int8_t verbo
 		_usb_dev(NULL), _ctx(NULL),
 #endif
 		_pkt_sz(0),
-		_ep_in(0), _ep_out(0), _num_tms(0), _is_connect(false), _backend(BACKEND_NONE)
+		_ep_in(0), _ep_out(0), _num_tms(0), _pkt_cnt(1), _is_connect(false),
+		_backend(BACKEND_NONE)
 {
 	_ll_buffer = (unsigned char *)malloc(sizeof(unsigned char) * 1024);
 	if (!_ll_buffer)
@@ -140,6 +141,8 @@ CmsisDAP::CmsisDAP(const cable_t &cable, int index, uint32_t clkHZ, int8_t verbo
 	if (_backend == BACKEND_NONE)
 		throw std::runtime_error("Error: no USB backend available");
 
+	_rsp_buffer.resize(_pkt_sz + 1);
+
 	if (verbose) {
 		display_info(INFO_ID_VID               , DAPLINK_INFO_STRING);
 		display_info(INFO_ID_PID               , DAPLINK_INFO_STRING);
@@ -233,6 +236,17 @@ CmsisDAP::CmsisDAP(const cable_t &cable, int index, uint32_t clkHZ, int8_t verbo
 				break;
 		}
 	}
+
+	/* number of packets buffered by the probe: as many
+	 * DAP_JTAG_SEQUENCE requests are kept in flight
+	 */
+	uint8_t pkt_cnt[65];
+	memset(pkt_cnt, 0, sizeof(pkt_cnt));
+	if (read_info(INFO_ID_MAX_PKT_CNT, pkt_cnt, 64) == 1 && pkt_cnt[2] > 0)
+		_pkt_cnt = pkt_cnt[2];
+	if (verbose)
+		printInfo("packet count: " + std::to_string(_pkt_cnt));
+
 	if (clkHZ > 0)
 		setClkFreq(clkHZ);
 }
@@ -692,6 +706,8 @@ int CmsisDAP::writeTMS(const uint8_t *tms, uint32_t len, bool flush_buffer,
 }
 
 /* 0x14 + number of sequence + seq1 details + tdi + seq2 details + tdi + ...
+ * requests are queued (see queue_sequence): answers are only waited when
+ * rx is used
  */
 int CmsisDAP::writeJtagSequence(uint8_t tms, const uint8_t *tx, uint8_t *rx,
 		uint32_t len, bool end)
@@ -710,7 +726,9 @@ int CmsisDAP::writeJtagSequence(uint8_t tms, const uint8_t *tx, uint8_t *rx,
 	int pos = 1;      // 0: num of sequence, 1: seq1 detail
 	int xfer_rest = real_len;  // main loop
 
-	flush();  // force TMS flush to free _buffer
+	// force TMS flush to free _buffer
+	if (_num_tms > 0 && flush() <= 0)
+		return -1;
 
 	while (xfer_rest > 0) {
 		if (xfer_rest >= 64) {  // fully fill one sequence
@@ -721,17 +739,15 @@ int CmsisDAP::writeJtagSequence(uint8_t tms, const uint8_t *tx, uint8_t *rx,
 			xfer_bit_len = xfer_rest;
 		}
 
-		/* buffer is 65bits with
+		/* buffer is packet size + 1 with
 		 * [0]   : hid
 		 * [1]   : cmsisdap operation
 		 * [2]   : number of sequence
-		 * [64:3]: sequence with
+		 * [n:3]: sequence with
 		 *    [n]        : sequence infos
 		 *    [n+m+1:n+1]: data
-		 * So only 62 bits are available to send sequences
-		 * and 64bits (full sequence) mean 8bits
-		 * => one sequence == 9Bytes and 9*7 == 63
-		 * then we have 6 * 8 fully filled sequence + one up to 56bits
+		 * one fully filled sequence is 9Bytes: last sequence
+		 * of a packet is cut to use all remaining space
 		 */
 		if (xfer_byte_len + 1 + pos > _pkt_sz - 1) {
 			xfer_byte_len = _pkt_sz - pos - 2;  // number of free bytes
@@ -744,6 +760,8 @@ int CmsisDAP::writeJtagSequence(uint8_t tms, const uint8_t *tx, uint8_t *rx,
 		if (tx) {  // use tx only if not NULL
 			memcpy(&_buffer[pos], (unsigned char *)tx_ptr, xfer_byte_len);
 			tx_ptr += xfer_byte_len;
+		} else {
+			memset(&_buffer[pos], 0, xfer_byte_len);
 		}
 		xfer_rest -= xfer_bit_len;  // update remaining number of bit
 		seq_num++;  // update sequence counter
@@ -751,15 +769,16 @@ int CmsisDAP::writeJtagSequence(uint8_t tms, const uint8_t *tx, uint8_t *rx,
 		byte_to_read += xfer_byte_len;  // update read lenght
 
 		/* when it's the last sequence or
-		 * buffer is fully filled
+		 * buffer is fully filled (no room for a one Byte sequence
+		 * or max number of sequences reached)
 		 * => flush
 		 * if it's the last sequence and end is true, don't do anything
 		 * here -> see bellow
 		 */
-		if ((!end && xfer_rest == 0) || seq_num == 7) {
+		if ((!end && xfer_rest == 0) || seq_num == 254 ||
+				pos + 2 > _pkt_sz - 1) {
 			_buffer[0] = seq_num;  // set number of sequences
-			ret = xfer(DAP_JTAG_SEQUENCE, pos,
-					(rx) ? rx_ptr: NULL, byte_to_read);
+			ret = queue_sequence(pos, rx_ptr, (rx) ? byte_to_read : 0);
 			if (ret <= 0) {
 				printError("writeTDI: failed to send sequence");
 				return ret;
@@ -781,24 +800,24 @@ int CmsisDAP::writeJtagSequence(uint8_t tms, const uint8_t *tx, uint8_t *rx,
 	 */
 	if (end) {
 		byte_to_read++;   // residual (or 0) from previous iter + 1 Byte
-		uint8_t val[byte_to_read];
 		_buffer[0] = seq_num + 1;
 		_buffer[pos++] = ((rx) ? DAP_JTAG_SEQ_TDO_CAPTURE : 0) |
 								  DAP_JTAG_SEQ_TMS_SHIFT(0x01&(!tms)) |
 								  DAP_JTAG_SEQ_NB_TCK(1);
-		_buffer[pos++] = (tx[(real_len) >> 3] & (1 << (real_len & 0x07))) ? 1 : 0;
-		ret = xfer(DAP_JTAG_SEQUENCE, pos, (rx) ? val: NULL, byte_to_read);
+		_buffer[pos++] = (tx && (tx[(real_len) >> 3] & (1 << (real_len & 0x07)))) ? 1 : 0;
+		/* last bit may be in a Byte filled by the previous answer */
+		ret = queue_sequence(pos, rx_ptr, (rx) ? byte_to_read : 0,
+				(rx) ? &rx[real_len >> 3] : NULL, 1 << (real_len & 0x07));
 		if (ret <= 0) {
 			printError("writeTDI: failed to send last sequence");
 			return ret;
 		}
-		if (rx) {
-			memcpy(rx_ptr, val, byte_to_read-1);
-			if (val[byte_to_read-1] & 0x01)
-				rx[real_len >> 3] |= 1 << ((real_len) & 0x07);
-			else
-				rx[real_len >> 3] &= ~(1 << ((real_len) & 0x07));
-		}
+	}
+
+	/* TDO must be available when returning */
+	if (rx && wait_pending(0) <= 0) {
+		printError("writeTDI: failed to read sequence");
+		return -1;
 	}
 
 	return len;
@@ -830,7 +849,7 @@ int CmsisDAP::flush()
 {
 	int ret;
 	if (_num_tms == 0)
-		return 0;
+		return (wait_pending(0) <= 0) ? -1 : 0;
 	_buffer[0] = (uint8_t)(_num_tms & 0xff);
 	//                                                         +1 (buff size)
 	ret = xfer(DAP_SWJ_SEQUENCE, ((_num_tms + 7) / 8) + 1, NULL, 0);
@@ -849,6 +868,11 @@ int CmsisDAP::xfer(uint8_t instruction, int tx_len,
 		uint8_t *rx_buff, int rx_len)
 {
 	int ret = -1, bulk_len = 0;
+
+	/* answers for queued requests come first */
+	if (wait_pending(0) <= 0)
+		return -1;
+
 	_ll_buffer[0] = 0;
 	_ll_buffer[1] = instruction;
 
@@ -922,6 +946,10 @@ int CmsisDAP::xfer(uint8_t instruction, int tx_len,
 int CmsisDAP::xfer(int tx_len, uint8_t *rx_buff, int rx_len)
 {
 	int ret = -1, bulk_len = 0;
+
+	if (wait_pending(0) <= 0)
+		return -1;
+
 	_ll_buffer[0] = 0;
 
 	switch(_backend){
@@ -979,6 +1007,143 @@ int CmsisDAP::xfer(int tx_len, uint8_t *rx_buff, int rx_len)
 	return ret;
 }
 
+/* send _ll_buffer content without reading the answer
+ * 0: 0] -> hid
+ * 1: instruction
+ * 2->n: message
+ */
+int CmsisDAP::send_request(int tx_len)
+{
+	int ret = -1;
+	_ll_buffer[0] = 0;
+
+	switch(_backend){
+#ifdef ENABLE_CMSISDAP_V1
+		case BACKEND_HID:
+			memset(&_ll_buffer[1 + tx_len + 1], 0, _pkt_sz - (tx_len + 1));
+			ret = hid_write(_hid_dev, _ll_buffer, _pkt_sz + 1);
+			if (ret == -1)
+				printError("Error: HID write failed\n");
+			break;
+#endif
+#ifdef ENABLE_CMSISDAP_V2
+		case BACKEND_USBBULK: {
+			int bulk_len = 0;
+			ret = libusb_bulk_transfer(_usb_dev, _ep_out, &_ll_buffer[1],
+					tx_len + 1, &bulk_len, 1000);
+			if (ret != 0 || bulk_len != tx_len + 1) {
+				printError("Error: Bulk write failed\n");
+				return -1;
+			}
+			ret = bulk_len;
+			break;
+		}
+#endif
+		default:
+			printError("Error: unknown USB backend\n");
+			break;
+	}
+	return ret;
+}
+
+/* read one answer: instruction + status + data
+ */
+int CmsisDAP::read_answer(uint8_t instruction)
+{
+	int ret = -1;
+	uint8_t *rsp = _rsp_buffer.data();
+
+	switch(_backend){
+#ifdef ENABLE_CMSISDAP_V1
+		case BACKEND_HID:
+			ret = hid_read_timeout(_hid_dev, rsp, _pkt_sz + 1, 1000);
+			if (ret <= 0) {
+				if (ret == 0)
+					printError("Error: HID read timeout\n");
+				else if (ret == -1)
+					printError("Error: HID comm failed\n");
+				return ret;
+			}
+			break;
+#endif
+#ifdef ENABLE_CMSISDAP_V2
+		case BACKEND_USBBULK: {
+			int bulk_len = 0;
+			ret = libusb_bulk_transfer(_usb_dev, _ep_in, rsp, _pkt_sz,
+					&bulk_len, 1000);
+			if (ret != 0 || bulk_len == 0) {
+				printError("Error: Bulk read failed\n");
+				return -1;
+			}
+			ret = bulk_len;
+			break;
+		}
+#endif
+		default:
+			printError("Error: unknown USB backend\n");
+			return -1;
+	}
+
+	if (rsp[0] != instruction) {
+		printError("Error: command error\n");
+		return -1;
+	}
+	if (rsp[1] != DAP_OK) {
+		printError("Error: DAP status error\n");
+		return -1;
+	}
+	return ret;
+}
+
+/* probe buffers up to _pkt_cnt requests: next request is sent before
+ * previous answers are read, removing one USB round trip by packet
+ */
+int CmsisDAP::queue_sequence(int tx_len, uint8_t *rx, int rx_len,
+		uint8_t *end_rx, uint8_t end_mask)
+{
+	if (_pending.size() >= static_cast<size_t>(_pkt_cnt) &&
+			wait_pending(_pkt_cnt - 1) <= 0)
+		return -1;
+
+	_ll_buffer[1] = DAP_JTAG_SEQUENCE;
+	int ret = send_request(tx_len);
+	if (ret <= 0) {
+		/* answers for already sent requests are lost */
+		wait_pending(0);
+		return ret;
+	}
+	_pending.push_back({rx, rx_len, end_rx, end_mask});
+	return 1;
+}
+
+int CmsisDAP::wait_pending(size_t max_pending)
+{
+	while (_pending.size() > max_pending) {
+		const dap_pending_t pend = _pending.front();
+		_pending.pop_front();
+
+		int ret = read_answer(DAP_JTAG_SEQUENCE);
+		if (ret <= 0) {
+			_pending.clear();
+			return (ret == 0) ? -1 : ret;
+		}
+		if (!pend.rx || pend.rx_len == 0)
+			continue;
+
+		const uint8_t *tdo = &_rsp_buffer[2];
+		if (!pend.end_rx) {
+			memcpy(pend.rx, tdo, pend.rx_len);
+		} else {
+			memcpy(pend.rx, tdo, pend.rx_len - 1);
+			if (tdo[pend.rx_len - 1] & 0x01)
+				*pend.end_rx |= pend.end_mask;
+			else
+				*pend.end_rx &= ~pend.end_mask;
+		}
+	}
+	return 1;
+}
+
 int CmsisDAP::read_info(uint8_t info, uint8_t *rd_info, int max_len)
 {
 	_ll_buffer[1] = DAP_INFO;
@@ -13,6 +13,7 @@
 #include <libusb.h>
 #endif
 
+#include <deque>
 #include <string>
 #include <vector>
 
@@ -125,6 +126,41 @@ class CmsisDAP: public JtagInterface {
 		int writeJtagSequence(uint8_t tms, const uint8_t *tx, uint8_t *rx,
 				uint32_t len, bool end);
 
+		/* DAP_JTAG_SEQUENCE request sent, answer not yet read */
+		typedef struct {
+			uint8_t *rx;   /**< TDO destination (NULL: no capture) */
+			int rx_len;    /**< number of TDO Bytes in the answer */
+			uint8_t *end_rx;   /**< when not NULL: last Byte is a single
+			                    *   bit to store in this Byte */
+			uint8_t end_mask;  /**< end_rx bit */
+		} dap_pending_t;
+
+		/*!
+		 * \brief send request stored in _ll_buffer without waiting
+		 *        for the answer
+		 * \param[in] tx_len: request size (without instruction)
+		 * \return <= 0 if something wrong, > 0 otherwise
+		 */
+		int send_request(int tx_len);
+		/*!
+		 * \brief read one answer in _rsp_buffer and check it
+		 * \param[in] instruction: expected instruction
+		 * \return <= 0 if something wrong, answer size otherwise
+		 */
+		int read_answer(uint8_t instruction);
+		/*!
+		 * \brief send a DAP_JTAG_SEQUENCE request already in _buffer,
+		 *        up to _pkt_cnt requests are kept in flight
+		 * \return <= 0 if something wrong, > 0 otherwise
+		 */
+		int queue_sequence(int tx_len, uint8_t *rx, int rx_len,
+				uint8_t *end_rx = NULL, uint8_t end_mask = 0);
+		/*!
+		 * \brief read answers until max_pending requests are in flight
+		 * \return <= 0 if something wrong, 1 otherwise
+		 */
+		int wait_pending(size_t max_pending);
+
 		bool _verbose;                /**< display more message */
 		int16_t _device_idx;          /**< device index */
 		uint16_t _vid;                /**< device Vendor ID */
@@ -148,6 +184,9 @@ class CmsisDAP: public JtagInterface {
 		int _ep_out;               /**< USB bulk out endpoint */
 #endif
 		int _num_tms;              /**< current tms length */
+		int _pkt_cnt;              /**< max requests buffered by the probe */
+		std::deque<dap_pending_t> _pending; /**< requests in flight */
+		std::vector<uint8_t> _rsp_buffer;   /**< answers buffer */
 		int _is_connect;           /**< device status ((dis)connected) */
 		int _backend;              /**< type of USB backend */
 };
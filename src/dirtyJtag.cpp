@@ -25,6 +25,8 @@
 #define DIRTYJTAG_READ_EP     0x82
 
 #define DIRTYJTAG_TIMEOUT     1000
+/* number of CMD_XFER packets kept in flight */
+#define DIRTYJTAG_MAX_PENDING 8
 
 enum dirtyJtagCmd {
 	CMD_STOP =  0x00,
@@ -51,6 +53,29 @@ struct version_specific
 static version_specific v_options[4] ={{0, 240}, {0, 240}, {NO_READ, 496},
 									{NO_READ, 4000}};
 
+/* reverse bits order in each Byte of a 64bits word */
+static inline uint64_t bitrev_bytes(uint64_t v)
+{
+	v = ((v >> 1) & 0x5555555555555555ULL) | ((v & 0x5555555555555555ULL) << 1);
+	v = ((v >> 2) & 0x3333333333333333ULL) | ((v & 0x3333333333333333ULL) << 2);
+	v = ((v >> 4) & 0x0F0F0F0F0F0F0F0FULL) | ((v & 0x0F0F0F0F0F0F0F0FULL) << 4);
+	return v;
+}
+
+/* copy len Bytes from src to dst with LSB first <-> MSB first conversion */
+static void bitrev_copy(uint8_t *dst, const uint8_t *src, uint32_t len)
+{
+	uint32_t i = 0;
+	for (; i + 8 <= len; i += 8) {
+		uint64_t v;
+		memcpy(&v, src + i, 8);
+		v = bitrev_bytes(v);
+		memcpy(dst + i, &v, 8);
+	}
+	for (; i < len; i++)
+		dst[i] = static_cast<uint8_t>(bitrev_bytes(src[i]));
+}
+
 enum dirtyJtagSig {
 	SIG_TCK = (1 << 1),
 	SIG_TDI = (1 << 2),
@@ -62,7 +87,8 @@ enum dirtyJtagSig {
 
 DirtyJtag::DirtyJtag(uint32_t clkHz, int8_t verbose, uint16_t vid, uint16_t pid):
 			_verbose(verbose),
-			dev_handle(NULL), usb_ctx(NULL), _tdi(0), _tms(0), _version(0)
+			dev_handle(NULL), usb_ctx(NULL), _slot_idx(0), _in_flight(0),
+			_tdi(0), _tms(0), _version(0)
 {
 	int ret;
 
@@ -84,6 +110,18 @@ DirtyJtag::DirtyJtag(uint32_t clkHz, int8_t verbose, uint16_t vid, uint16_t pid)
 		throw std::runtime_error("DirtyJtag: libusb error while claiming interface");
 	}
 
+	_slots.resize(DIRTYJTAG_MAX_PENDING);
+	for (auto &slot : _slots) {
+		memset(&slot, 0, sizeof(slot));
+		slot.owner = this;
+		slot.out = libusb_alloc_transfer(0);
+		slot.in = libusb_alloc_transfer(0);
+		if (!slot.out || !slot.in) {
+			close_usb();
+			throw std::runtime_error("DirtyJtag: fails to allocate transfers");
+		}
+	}
+
 	if (!getVersion()) {
 		close_usb();
 		throw std::runtime_error("DirtyJtag: Fail to get version");
@@ -97,6 +135,11 @@ DirtyJtag::DirtyJtag(uint32_t clkHz, int8_t verbose, uint16_t vid, uint16_t pid)
 
 void DirtyJtag::close_usb()
 {
+	for (auto &slot : _slots) {
+		libusb_free_transfer(slot.out);
+		libusb_free_transfer(slot.in);
+	}
+	_slots.clear();
 	if (dev_handle) {
 		libusb_release_interface(dev_handle, DIRTYJTAG_INTF);
 		libusb_close(dev_handle);
@@ -250,32 +293,111 @@ int DirtyJtag::flush()
 	return 0;
 }
 
-int DirtyJtag::writeTDI(const uint8_t *tx, uint8_t *rx, uint32_t len, bool end)
+void LIBUSB_CALL DirtyJtag::xfer_cb(struct libusb_transfer *transfer)
 {
-	int actual_length;
-	uint32_t real_bit_len = len - (end ? 1 : 0);
-	const uint32_t kRealByteLen = (len + 7) / 8;
+	xfer_slot_t *slot = static_cast<xfer_slot_t *>(transfer->user_data);
+	DirtyJtag *self = slot->owner;
+
+	if (transfer == slot->in) {
+		/* empty packet: the answer follows (same as the synchronous
+		 * read loop). Only possible when no other read is queued
+		 * behind, otherwise the answer goes to the next transfer.
+		 */
+		if (transfer->status == LIBUSB_TRANSFER_COMPLETED &&
+				transfer->actual_length == 0 && self->_in_flight == 1 &&
+				libusb_submit_transfer(transfer) == 0)
+			return;
+		self->_in_flight--;
+		/* short scans: firmware may answer less than rx_len */
+		if (transfer->actual_length < (slot->bits + 7) / 8)
+			slot->error = true;
+	} else if (transfer->actual_length != transfer->length) {
+		slot->error = true;
+	}
+	if (transfer->status != LIBUSB_TRANSFER_COMPLETED)
+		slot->error = true;
+	slot->pending--;
+}
 
-	uint8_t tx_cpy[kRealByteLen];
-	uint8_t tx_buf[512], rx_buf[512];
-	uint8_t *tx_ptr, *rx_ptr = rx;
+bool DirtyJtag::finish_slot(xfer_slot_t *slot)
+{
+	while (slot->pending > 0) {
+		struct timeval tv = {1, 0};
+		int ret = libusb_handle_events_timeout_completed(usb_ctx, &tv, NULL);
+		if (ret < 0 && ret != LIBUSB_ERROR_INTERRUPTED) {
+			printError("writeTDI: usb events failed " +
+				std::string(libusb_error_name(ret)));
+			return false;
+		}
+	}
+	if (slot->error) {
+		slot->error = false;
+		slot->rx = NULL;
+		return false;
+	}
 
-	if (tx)
-		memcpy(tx_cpy, tx, kRealByteLen);
-	else
-		memset(tx_cpy, 0, kRealByteLen);
-	tx_ptr = tx_cpy;
+	if (slot->rx) {
+		const uint32_t nb_byte = (slot->bits + 7) / 8;
+		uint8_t *rx_ptr = slot->rx + (slot->rx_pos >> 3);
+		bitrev_copy(rx_ptr, slot->rx_buf, nb_byte);
+		/* last Byte: keep only received bits (right aligned) */
+		if (slot->bits & 0x07)
+			rx_ptr[nb_byte - 1] &= (1 << (slot->bits & 0x07)) - 1;
+		slot->rx = NULL;
+	}
+	return true;
+}
+
+void DirtyJtag::abort_slots()
+{
+	for (auto &slot : _slots) {
+		if (slot.pending > 0) {
+			libusb_cancel_transfer(slot.out);
+			libusb_cancel_transfer(slot.in);
+		}
+	}
+	for (auto &slot : _slots) {
+		while (slot.pending > 0) {
+			struct timeval tv = {1, 0};
+			if (libusb_handle_events_timeout_completed(usb_ctx, &tv, NULL) < 0)
+				break;
+		}
+		slot.pending = 0;
+		slot.error = false;
+		slot.rx = NULL;
+	}
+	_in_flight = 0;
+	_slot_idx = 0;
+}
 
-	tx_buf[0] = CMD_XFER | (rx ? 0 : v_options[_version].no_read);
-	uint16_t max_bit_transfer_length = v_options[_version].max_bits;
+int DirtyJtag::writeTDI(const uint8_t *tx, uint8_t *rx, uint32_t len, bool end)
+{
+	const uint32_t real_bit_len = len - (end ? 1 : 0);
+	const uint8_t cmd = CMD_XFER | (rx ? 0 : v_options[_version].no_read);
+	const bool must_read = rx || (_version <= 1);
+	const uint16_t max_bit_transfer_length = v_options[_version].max_bits;
 	// need to cut the bits on byte size.
 	assert(max_bit_transfer_length % 8 == 0);
-	uint32_t rx_cnt = 0;
-	while (real_bit_len != 0) {
-		const uint16_t bit_to_send = (real_bit_len > max_bit_transfer_length) ?
-			max_bit_transfer_length : real_bit_len;
-		const size_t byte_to_send = (bit_to_send + 7) / 8;
-		size_t header_offset = 0;
+
+	/* Packets are sent without waiting for the previous answer:
+	 * up to DIRTYJTAG_MAX_PENDING out/in pairs are in flight, the
+	 * oldest slot is completed before being reused.
+	 */
+	uint32_t pos = 0;
+	while (pos < real_bit_len) {
+		xfer_slot_t *slot = &_slots[_slot_idx];
+		if (!finish_slot(slot)) {
+			printError("writeTDI: usb transfer failed");
+			abort_slots();
+			return -EXIT_FAILURE;
+		}
+
+		const uint16_t bit_to_send = (real_bit_len - pos > max_bit_transfer_length) ?
+			max_bit_transfer_length : real_bit_len - pos;
+		const uint32_t byte_to_send = (bit_to_send + 7) / 8;
+		uint8_t *tx_buf = slot->tx_buf;
+		size_t header_offset = 2;
+		tx_buf[0] = cmd;
 		if (_version == 3) {
 			tx_buf[1] = (bit_to_send >> 8) & 0xFF;
 			tx_buf[2] = bit_to_send & 0xFF;
@@ -283,72 +405,76 @@ int DirtyJtag::writeTDI(const uint8_t *tx, uint8_t *rx, uint32_t len, bool end)
 		} else if (bit_to_send > 255) {
 			tx_buf[0] |= EXTEND_LENGTH;
 			tx_buf[1] = bit_to_send - 256;
-			header_offset = 2;
 		} else {
-			tx_buf[0] &= ~EXTEND_LENGTH;
 			tx_buf[1] = bit_to_send;
-			header_offset = 2;
-		}
-		memset(tx_buf + header_offset, 0, byte_to_send);
-		for (int i = 0; i < bit_to_send; i++) {
-			_tdi = (tx_ptr[i >> 3] & (1 << (i & 0x07))) ? SIG_TDI : 0;
-			if (_tdi == SIG_TDI)
-				tx_buf[header_offset + (i >> 3)] |= (0x80 >> (i & 0x07));
 		}
 
-		actual_length = 0;
-		const int xfer_len = byte_to_send + header_offset;
-		int ret = libusb_bulk_transfer(dev_handle, DIRTYJTAG_WRITE_EP,
-				(unsigned char *)tx_buf, xfer_len,
-				&actual_length, DIRTYJTAG_TIMEOUT);
-		if ((ret < 0) || (actual_length != xfer_len)) {
-			std::cerr << "writeTDI: fill: usb bulk write failed " << ret <<
-				"actual length: " << actual_length << std::endl;
-			return EXIT_FAILURE;
+		/* packets are Byte aligned in the scan (max_bits % 8 == 0) */
+		uint8_t *payload = tx_buf + header_offset;
+		if (tx) {
+			bitrev_copy(payload, tx + (pos >> 3), byte_to_send);
+			if (bit_to_send & 0x07)
+				payload[byte_to_send - 1] &= 0xff << (8 - (bit_to_send & 0x07));
+		} else {
+			memset(payload, 0, byte_to_send);
 		}
-		// std::cerr << actual_length << ", " << bit_to_send << std::endl;
 
-		if (rx || (_version <= 1)) {
-			const int transfer_length = (bit_to_send > 255) ? byte_to_send : 32;
-			do {
-				ret = libusb_bulk_transfer(dev_handle, DIRTYJTAG_READ_EP,
-					rx_buf, transfer_length, &actual_length, DIRTYJTAG_TIMEOUT);
-				if (ret < 0) {
-					std::cerr << "writeTDI: read: usb bulk read failed " << ret << std::endl;
-					return EXIT_FAILURE;
+		slot->bits = bit_to_send;
+		slot->rx_pos = pos;
+		slot->rx = rx;
+		/* at least 32 bytes are requested for short scans */
+		slot->rx_len = (bit_to_send > 255) ? byte_to_send : 32;
+		slot->error = false;
+
+		libusb_fill_bulk_transfer(slot->out, dev_handle, DIRTYJTAG_WRITE_EP,
+			tx_buf, byte_to_send + header_offset, xfer_cb, slot,
+			DIRTYJTAG_TIMEOUT);
+		int ret = libusb_submit_transfer(slot->out);
+		if (ret == 0) {
+			slot->pending++;
+			if (must_read) {
+				libusb_fill_bulk_transfer(slot->in, dev_handle,
+					DIRTYJTAG_READ_EP, slot->rx_buf, slot->rx_len, xfer_cb,
+					slot, DIRTYJTAG_TIMEOUT);
+				ret = libusb_submit_transfer(slot->in);
+				if (ret == 0) {
+					slot->pending++;
+					_in_flight++;
 				}
-			} while (actual_length == 0);
-			assert(static_cast<size_t>(actual_length) >= byte_to_send);
+			}
+		}
+		if (ret < 0) {
+			printError("writeTDI: usb submit failed " +
+				std::string(libusb_error_name(ret)));
+			abort_slots();
+			return -EXIT_FAILURE;
 		}
 
-		if (rx) {
-			for (int i = 0; i < bit_to_send; i++, rx_cnt++) {
-				rx_ptr[rx_cnt >> 3] = (rx_ptr[rx_cnt >> 3] >> 1) |
-						(((rx_buf[i >> 3] << (i&0x07)) & 0x80));
-			}
-			/* Last xfer:
-			 * if bit_to_send is not a multiple of 8bits a shift must
-			 * be applied to align right the last Byte
-			 */
-			if (bit_to_send < max_bit_transfer_length) {
-				const uint32_t b = (bit_to_send >> 3) << 3;  // floor
-				if (b < bit_to_send) {  // difference ?
-					const uint32_t diff = bit_to_send - b;
-					const uint8_t t = rx_ptr[(rx_cnt-1) >> 3] >> (8 - diff);
-					rx_ptr[(rx_cnt - 1) >> 3] = t;
-				}
-			}
+		_slot_idx = (_slot_idx + 1) % _slots.size();
+		pos += bit_to_send;
+	}
+
+	/* wait for all packets, oldest first */
+	for (size_t i = 0; i < _slots.size(); i++) {
+		xfer_slot_t *slot = &_slots[(_slot_idx + i) % _slots.size()];
+		if (!finish_slot(slot)) {
+			printError("writeTDI: usb transfer failed");
+			abort_slots();
+			return -EXIT_FAILURE;
 		}
+	}
 
-		real_bit_len -= bit_to_send;
-		tx_ptr += byte_to_send;
+	if (real_bit_len > 0 && !end) {
+		pos = real_bit_len - 1;
+		_tdi = (tx && (tx[pos >> 3] & (1 << (pos & 0x07)))) ? SIG_TDI : 0;
 	}
 
 	/* Final single-bit step used only for DR/IR SHIFT end transitions. */
 	if (end) {
-		int pos = len-1;
+		int actual_length;
+		pos = len - 1;
 		uint8_t sig;
-		_tdi = (tx_cpy[pos >> 3] & (1 << (pos & 0x07))) ? SIG_TDI: 0;
+		_tdi = (tx && (tx[pos >> 3] & (1 << (pos & 0x07)))) ? SIG_TDI : 0;
 		_tms = SIG_TMS;
 
 		if (rx) {
@@ -382,7 +508,9 @@ int DirtyJtag::writeTDI(const uint8_t *tx, uint8_t *rx, uint32_t len, bool end)
 			} while (actual_length == 0);
 
 			if (sig & SIG_TDO)
-				rx[rx_cnt >> 3] |= (1 << (rx_cnt & 0x07));
+				rx[pos >> 3] |= (1 << (pos & 0x07));
+			else
+				rx[pos >> 3] &= ~(1 << (pos & 0x07));
 
 			buf[2] &= ~SIG_TCK;
 			buf[3] = CMD_STOP;
@@ -8,6 +8,8 @@
 
 #include <libusb.h>
 
+#include <vector>
+
 #include "jtagInterface.hpp"
 
 /*!
@@ -81,6 +83,40 @@ class DirtyJtag : public JtagInterface {
 	libusb_device_handle *dev_handle;
 	libusb_context *usb_ctx;
 
+	/* one CMD_XFER packet with its (optional) answer */
+	typedef struct {
+		DirtyJtag *owner;
+		struct libusb_transfer *out;
+		struct libusb_transfer *in;
+		uint8_t tx_buf[512];
+		uint8_t rx_buf[512];
+		int pending;        /*!< transfers not yet completed */
+		bool error;         /*!< one transfer fails */
+		uint8_t *rx;        /*!< caller buffer (NULL: answer dropped) */
+		uint32_t rx_pos;    /*!< first bit position in rx */
+		uint16_t bits;      /*!< number of bits in this packet */
+		int rx_len;         /*!< answer buffer size (byte) */
+	} xfer_slot_t;
+
+	/*!
+	 * \brief libusb completion callback for out and in transfers
+	 */
+	static void LIBUSB_CALL xfer_cb(struct libusb_transfer *transfer);
+	/*!
+	 * \brief wait until all transfers of a slot are done and copy
+	 *        answer to caller buffer
+	 * \return false when a transfer fails
+	 */
+	bool finish_slot(xfer_slot_t *slot);
+	/*!
+	 * \brief cancel and wait for all in flight transfers
+	 */
+	void abort_slots();
+
+	std::vector<xfer_slot_t> _slots;  /*!< transfers ring */
+	uint32_t _slot_idx;               /*!< next slot to use (oldest) */
+	int _in_flight;                   /*!< in transfers submitted */
+
 	uint8_t _tdi;
 	uint8_t _tms;
 	uint8_t _version;
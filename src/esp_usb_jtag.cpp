@@ -200,6 +200,9 @@ struct jtag_proto_caps_speed_apb {
  *to be read, we have multiple buffers to store those before the bitq interface reads them out. */
 #define IN_BUF_CT 8
 
+/* Number of OUT_BUF_SZ transfers in flight */
+#define ESPUSBJTAG_MAX_PENDING 4
+
 /*
  * comment from libusb:
  * As per the USB 3.0 specs, the current maximum limit for the depth is 7.
@@ -245,6 +248,26 @@ static uint16_t esp_usb_target_chip_id = 0; /* not applicable for FPGA, they hav
 
 /* end copy from openocd */
 
+/* CMD_CLK(0, tdi, 0) commands for one Byte: bit 2k is the high nibble of
+ * command Byte k, bit 2k+1 its low nibble (high nibble first executed).
+ * TMS is the same pattern shifted by one and cap a constant mask.
+ */
+struct esp_clk_tbl_t {
+	uint32_t cmds[256];
+	constexpr esp_clk_tbl_t(): cmds() {
+		for (int i = 0; i < 256; i++) {
+			uint32_t w = 0;
+			for (int k = 0; k < 4; k++) {
+				w |= static_cast<uint32_t>((i >> (2 * k)) & 1) << (8 * k + 4);
+				w |= static_cast<uint32_t>((i >> (2 * k + 1)) & 1) << (8 * k);
+			}
+			cmds[i] = w;
+		}
+	}
+};
+static constexpr esp_clk_tbl_t esp_clk_tbl;
+#define CMD_CLK_CAP_MASK 0x44444444
+
 esp_usb_jtag::esp_usb_jtag(uint32_t clkHZ, int8_t verbose,
 			int vid = ESPUSBJTAG_VID, int pid = ESPUSBJTAG_PID,
 			uint8_t bus_addr = 0, uint8_t dev_addr = 0,
@@ -253,7 +276,10 @@ esp_usb_jtag::esp_usb_jtag(uint32_t clkHZ, int8_t verbose,
 			dev_handle(NULL), usb_ctx(NULL), _tdi(0), _tms(0),
 			/* Default for emard firmware. */
 			_esp_usb_jtag_caps(0x2000), _write_ep(0x02),
-			_vid(ESPUSBJTAG_VID), _pid(ESPUSBJTAG_PID)
+			_vid(ESPUSBJTAG_VID), _pid(ESPUSBJTAG_PID),
+			_xfer_idx(0), _out_buf(NULL), _out_nibbles(0), _queued_clks(0),
+			_in_trans(NULL), _in_ptr(NULL), _in_len(0), _in_busy(false),
+			_in_tries(0), _xfer_error(false)
 {
 	libusb_device **devs = NULL;
 	int ret;
@@ -334,6 +360,21 @@ esp_usb_jtag::esp_usb_jtag(uint32_t clkHZ, int8_t verbose,
 		throw std::exception();
 	}
 
+	_xfers.resize(ESPUSBJTAG_MAX_PENDING);
+	for (auto &xfer : _xfers) {
+		xfer.owner = this;
+		xfer.trans = libusb_alloc_transfer(0);
+		xfer.buf.resize(OUT_BUF_SZ);
+		xfer.clks = 0;
+		xfer.pending = 0;
+		if (!xfer.trans)
+			throw std::runtime_error("Fail to allocate transfers");
+	}
+	_out_buf = _xfers[0].buf.data();
+	_in_trans = libusb_alloc_transfer(0);
+	if (!_in_trans)
+		throw std::runtime_error("Fail to allocate transfers");
+
 	_version = 0;
 	if (!getVersion())
 		throw std::runtime_error("Fail to get version");
@@ -346,7 +387,15 @@ esp_usb_jtag::esp_usb_jtag(uint32_t clkHZ, int8_t verbose,
 
 esp_usb_jtag::~esp_usb_jtag()
 {
+	flush();
+	if (_in_busy) {
+		libusb_cancel_transfer(_in_trans);
+		while (_in_busy && wait_event()) {}
+	}
 	drain_in(true);  // just to be sure try to flush buffer
+	for (auto &xfer : _xfers)
+		libusb_free_transfer(xfer.trans);
+	libusb_free_transfer(_in_trans);
 	if (dev_handle)
 		libusb_close(dev_handle);
 	if (usb_ctx)
@@ -487,89 +536,44 @@ int esp_usb_jtag::setClkFreq(uint32_t clkHZ)
 	return clkHZ;
 }
 
-/* here we needs to loop over until len bits has been sent
- * a second loop is required to fill a packet to up to OUT_EP_SZ byte or
- *   remaining_bits bytes
+/* Commands are accumulated in the current OUT buffer, full Bytes
+ * converted with esp_clk_tbl, and the buffer is sent when full, when a
+ * capture is done or when a flush is requested.
  */
 int esp_usb_jtag::writeTMS(const uint8_t *tms, uint32_t len, bool flush_buffer,
 		const uint8_t tdi)
 {
-	uint8_t buf[OUT_BUF_SZ];
 	char mess[256];
 	if (_verbose) {
 		snprintf(mess, 256, "writeTMS %d %d", len, flush_buffer);
 		printSuccess(mess);
 	}
 
-	if(flush_buffer)
-		flush();
-
 	if (len == 0)
-		return 0;
+		return (flush_buffer) ? flush() : 0;
 
 	// save current tdi as new tdi state
 	_tdi = tdi & 0x01;
 
-	uint32_t real_len = 0;
-	for (uint32_t pos = 0; pos < len; pos += real_len) {
-		const uint32_t remaining_bits = len - pos; // number of bits to write
-		// select full buffer vs remaining bits
-		if (remaining_bits < (OUT_EP_SZ * 2))
-			real_len = remaining_bits;
-		else
-			real_len = OUT_EP_SZ * 2;
-
-		uint8_t prev_high_nibble = CMD_FLUSH << 4; // for odd length 1st command is flush = nop
-		uint32_t buffer_idx = 0; // reset
-		uint8_t is_high_nibble = 1 & ~real_len;
-		// for even len: start with is_high_nibble = 1
-		// for odd len:  start with is_high_nibble = 0
-		//               1st (high nibble) is flush = nop
-		//               2nd (low nibble) is data
-		// last byte in buf will have data in both nibbles, no flush
-		// exec order: high-nibble-first, low-nibble-second
-		for (uint32_t i = 0; i < real_len; i++) {
-			const uint32_t idx = i + pos;
-			_tms = (tms[idx >> 3] >> (idx & 7)) & 1; // get i'th bit from tms
-			const uint8_t cmd = CMD_CLK(0, _tdi, _tms);
-			if(is_high_nibble) {   // 1st (high nibble) = data
-				buf[buffer_idx] = prev_high_nibble = cmd << 4;
-			} else { // low nibble
-				// 2nd (low nibble) = data, keep prev high nibble
-				buf[buffer_idx] = prev_high_nibble | cmd;
-				buffer_idx++; // byte complete, advance to the next byte in buf
-			}
-			is_high_nibble ^= 1;  // toggle
-		}
-
-		const int ret = xfer(buf, NULL, buffer_idx);
-		if (ret < 0) {
-			snprintf(mess, 256, "ESP USB Jtag: writeTMS failed  with error %d", ret);
-			printError(mess);
-			return -EXIT_FAILURE;
-		}
-		if (_verbose)
-			std::cerr << "tms" << std::endl;
+	if (!align() || !put_clk(NULL, _tdi, tms, 0, len, false)) {
+		printError("ESP USB Jtag: writeTMS failed");
+		return -EXIT_FAILURE;
 	}
+	_tms = (tms[(len - 1) >> 3] >> ((len - 1) & 7)) & 1;
+
+	if (flush_buffer && flush() < 0)
+		return -EXIT_FAILURE;
 
 	return len;
 }
 
-/* Not only here and not sure it is true:
- * when len < OUT_BUF_SZ is_high_nibble is fine: the buffer is filed with
- *     the full sequence
- * when len > OUT_BUF_SZ we have to sent OUT_BUF_SZ x n + remaining bits
- *     here is_high_nibble must be re-computed more than one time
- * tms and tdi are ignored: current pins state are kept, only the clock
- * is toggled.
- */
-
-/* Here we have to write len bit or 2xlen Bytes
+/* tms and tdi are ignored: current pins state are kept, only the clock
+ * is toggled. A group of up to CMD_REP_MAX_REPS cycles is encoded as one
+ * CMD_CLK followed by its repeat count (base 4, LSB first) with CMD_REP.
  */
 int esp_usb_jtag::toggleClk(__attribute__((unused))uint8_t tms,
 	uint8_t __attribute__((unused))tdi, uint32_t len)
 {
-	uint8_t buf[OUT_BUF_SZ];
 	char mess[256];
 	if (_verbose) {
 		snprintf(mess, 256, "toggleClk %d", len);
@@ -580,34 +584,20 @@ int esp_usb_jtag::toggleClk(__attribute__((unused))uint8_t tms,
 		return 0;
 
 	const uint8_t cmd = CMD_CLK(0, _tdi, _tms);  // cmd is constant
-	const uint8_t prev_high_nibble = (cmd << 4) | cmd;
-	uint32_t real_len = 0;
-	/* loop on OUT_BUF_SZ packets
-	 * buffer is able to store OUT_EP_SZ * 2 bit
-	 */
-	for (uint32_t pos = 0; pos < len; pos += real_len) {
-		// Compute number of bits to write
-		const uint32_t remaining_bits = len - pos;
-		// select before the full buffer or remaining bits
-		if (remaining_bits < (OUT_EP_SZ * 2))
-			real_len = remaining_bits;
-		else
-			real_len = OUT_EP_SZ * 2;
-
-		const uint32_t byte_len = (real_len + 1) >> 1; // Byte len (2bits/bytes, rounded)
-
-		// prepare buffer
-		memset(buf, prev_high_nibble, byte_len);
-
-		if ((real_len & 0x01) == 1)  // padding with CMD_FLUSH
-			buf[0] = (CMD_FLUSH << 4) | cmd;
-
-		const int ret = xfer(buf, NULL, byte_len);
-		if (ret < 0) {
-			snprintf(mess, 256, "ESP USB Jtag: toggleClk failed  with error %d", ret);
-			printError(mess);
+	for (uint32_t pos = 0; pos < len;) {
+		uint32_t real_len = len - pos;
+		if (real_len > CMD_REP_MAX_REPS)
+			real_len = CMD_REP_MAX_REPS;
+
+		bool ret = put_nibble(cmd);
+		for (uint32_t rep = real_len - 1; ret && rep > 0; rep >>= 2)
+			ret = put_nibble(CMD_REP(rep & 0x03));
+		if (!ret) {
+			printError("ESP USB Jtag: toggleClk failed");
 			return -EXIT_FAILURE;
 		}
+		_xfers[_xfer_idx].clks += real_len;
+		pos += real_len;
 	}
 	return EXIT_SUCCESS;
 }
@@ -635,11 +625,11 @@ int esp_usb_jtag::setio(int srst, int tms, int tdi, int tck)
 
 int esp_usb_jtag::flush()
 {
-	const uint8_t buf = (CMD_FLUSH << 4) | CMD_FLUSH;
 	if (_verbose)
 		printInfo("flush");
 
-	if (xfer(&buf, NULL, 1) < 0) {
+	const bool ret = align() && submit_out();
+	if (!wait_xfers() || !ret) {
 		printError("ESP USB Jtag: flush failed");
 		return -EXIT_FAILURE;
 	}
@@ -702,11 +692,6 @@ int esp_usb_jtag::xfer(const uint8_t *tx, uint8_t *rx, const uint16_t length,
 	return transferred_length;
 }
 
-// TODO
-// [ ] odd len
-// [ ] end (DR_SHIFT, IR_SHIFT)
-// Note: as done for writeTMS, len and/or real_bit_len must be
-// splitted in two loop level
 int esp_usb_jtag::writeTDI(const uint8_t *tx, uint8_t *rx, uint32_t len, bool end)
 {
 	char mess[256];
@@ -714,135 +699,46 @@ int esp_usb_jtag::writeTDI(const uint8_t *tx, uint8_t *rx, uint32_t len, bool en
 		snprintf(mess, 256, "writeTDI: start len: %d end: %d", len, end);
 		printSuccess(mess);
 	}
-	int ret;
-	const uint32_t kTdiLen = (len+7) >> 3; // TDI/RX len in byte
-	uint8_t tdi[kTdiLen]; // TDI buffer (required when tx is NULL)
-	uint8_t tx_buf[OUT_EP_SZ];
-	const uint8_t tdo = !(rx == NULL); // only set cap/tdo when something to read
-	uint8_t *rx_ptr = NULL;
-	uint32_t xfer_len = 0;
 
 	/* nothing to do ? */
 	if (len == 0)
 		return 0;
 
-	/* set rx to 0: to be removed when working */
-	if (rx) {
-		memset(rx, 0, (len + 7) >> 3);
-		rx_ptr = rx;
-	}
+	const bool cap = (rx != NULL);  // only set cap when something to read
+	const uint8_t tdi_val = _tdi;
+	// with end, last bit is sent alone with TMS high
+	const uint32_t body_len = (end) ? len - 1 : len;
 
-	/* Copy RX or fill the buffer with TDI current level */
+	/* pending captures are always flushed: padding with
+	 * CMD_FLUSH has no effect on IN endpoint
+	 */
+	bool ret = align();
+	// IN must be posted before commands, device stops to accept
+	// commands when its IN buffer is full
+	if (ret && cap)
+		ret = submit_in(rx, (len + 7) >> 3);
+	if (ret)
+		ret = put_clk(tx, tdi_val, NULL, _tms, body_len, cap);
 	if (tx)
-		memcpy(tdi, tx, kTdiLen);
-	else
-		memset(tdi, _tdi ? 0xff : 0x00, kTdiLen);
-
-	if (_verbose) {
-		snprintf(mess, 256, "len=0x%08x\n", len);
-		printInfo(mess);
+		_tdi = (tx[(len - 1) >> 3] >> ((len - 1) & 7)) & 1;
+	if (ret && end) {
+		_tms = 1;
+		ret = put_nibble(CMD_CLK(cap, _tdi, _tms));
+		_xfers[_xfer_idx].clks++;
+	}
+	if (!ret) {
+		printError("writeTDI: usb bulk write failed");
+		return -EXIT_FAILURE;
 	}
 
-	// drain_in();
-	uint32_t tx_buffer_idx = 0; // reset
-	uint8_t is_high_nibble = 1 & ~len;
-
-	// for even len: start with is_high_nibble = 1
-	// for odd len:  start with is_high_nibble = 0
-	//               1st (high nibble) is flush = nop
-	//               2nd (low nibble) is data
-	// last byte in buf will have data in both nibbles, no flush
-	// exec order: high-nibble-first, low-nibble-second
-	if (_verbose) {
-		std::cerr << "is high nibble=" << (int)is_high_nibble << std::endl;
-		//int bits_in_tx_buf = 0;
-		for(uint32_t i = 0; i < (len + 7) >> 3; i++)
-			std::cerr << " " << std::hex << (int)tdi[i];
-		std::cerr << std::endl;
-		std::cerr << "tdi_bits ";
-	}
-
-	for (uint32_t pos = 0; pos < len; pos += xfer_len) {
-		// Compute number of bits to write
-		const uint32_t remaining_bits = len - pos;
-		// select before the full buffer or remaining bits
-		if (remaining_bits < (OUT_EP_SZ * 2))
-			xfer_len = remaining_bits;
-		else
-			xfer_len = OUT_EP_SZ * 2;
-
-		uint8_t prev_high_nibble = CMD_FLUSH << 4; // for odd length 1st command is flush = nop
-		tx_buffer_idx = 0; // reset
-		uint8_t is_high_nibble = 1 & ~xfer_len;
-		// for even len: start with is_high_nibble = 1
-		// for odd len:  start with is_high_nibble = 0
-		//               1st (high nibble) is flush = nop
-		//               2nd (low nibble) is data
-		// last byte in buf will have data in both nibbles, no flush
-		// exec order: high-nibble-first, low-nibble-second
-
-		for (uint32_t i = 0; i < xfer_len; i++) {
-			uint32_t curr_pos = pos + i;
-			_tdi = (tdi[curr_pos >> 3] >> (curr_pos & 7)) & 1; // get i'th bit from rx
-			if (_verbose)
-				std::cerr << (int)_tdi;
-			if (end && curr_pos == len - 1)
-				_tms = 1;
-			const uint8_t cmd = CMD_CLK(tdo, _tdi, _tms); // with TDO capture
-			if(is_high_nibble) {   // 1st (high nibble) = data
-				tx_buf[tx_buffer_idx] = prev_high_nibble = cmd << 4;
-			} else { // low nibble
-				// 2nd (low nibble) = data, keep prev high nibble
-				tx_buf[tx_buffer_idx++] = prev_high_nibble | cmd;
-			}
-			is_high_nibble ^= 1;
-		}
-
-		/* Flush current buffer */
-		if (_verbose) {
-			printf("\nwriteTDI: write_ep len bytes=0x%04x\n", tx_buffer_idx);
-			for(uint32_t j = 0; j < tx_buffer_idx; j++)
-				printf(" %02x", tx_buf[j]);
-			printf("\n");
-			printf("AA\n");
-		}
-		ret = xfer(tx_buf, NULL, tx_buffer_idx);
-		if (_verbose)
-			printf("BB\n");
-		if (ret < 0) {
-			printError("writeTDI: usb bulk write failed " + std::to_string(ret));
+	if (cap) {
+		// flush IN endpoint (padding last Byte with 0) and wait for
+		// TDO
+		if (!put_nibble(CMD_FLUSH) || !align() || !submit_out() ||
+				!wait_xfers()) {
+			printError("writeTDI: usb bulk read failed");
 			return -EXIT_FAILURE;
 		}
-		if (_verbose)
-			std::cerr << "writeTDI write 0x" << tx_buffer_idx << " bytes" << std::endl;
-		if (rx) {
-			flush(); // must flush before reading
-			// TODO support odd len for TDO
-			// currently only even len TDO works correctly
-			// for odd len first command sent is CMD_FUSH
-			// so TDI rx_buf will be missing 1 bit
-			uint16_t read_bit_len = tx_buffer_idx << 1;
-			uint16_t read_byte_len = (read_bit_len + 7) >> 3;
-			for (int rx_bytes = 0; rx_bytes < read_byte_len; rx_bytes += ret) {
-				int nb_try = 0;  // try more than one time, sometime flush is not immediate
-				do {
-					ret = xfer(NULL, rx_ptr, read_byte_len - rx_bytes);
-					if (ret < 0) {
-						printError("writeTDI: read failed");
-						return -EXIT_FAILURE;
-					}
-					nb_try++;
-				} while (nb_try < 3 && ret == 0);
-				if (_verbose)
-					std::cerr << "writeTDI read " << std::to_string(ret) << std::endl;
-				if (read_byte_len != ret) {
-					snprintf(mess, 256, "writeTDI: usb bulk read expected=%d received=%d", read_byte_len, ret);
-					printError(mess);
-					break;
-				}
-				rx_ptr += ret;
-			}
-		}
 	}
 
 	if (_verbose)
@@ -850,3 +746,213 @@ int esp_usb_jtag::writeTDI(const uint8_t *tx, uint8_t *rx, uint32_t len, bool en
 
 	return EXIT_SUCCESS;
 }
+
+bool esp_usb_jtag::put_nibble(uint8_t cmd)
+{
+	if (_out_nibbles == OUT_BUF_SZ * 2 && !submit_out())
+		return false;
+	if (_out_nibbles & 0x01)
+		_out_buf[_out_nibbles >> 1] |= cmd;
+	else
+		_out_buf[_out_nibbles >> 1] = cmd << 4;
+	_out_nibbles++;
+	return true;
+}
+
+bool esp_usb_jtag::put_word(uint32_t cmds)
+{
+	if (_out_nibbles + 8 > OUT_BUF_SZ * 2 && !submit_out())
+		return false;
+	uint8_t *ptr = &_out_buf[_out_nibbles >> 1];
+	ptr[0] = static_cast<uint8_t>(cmds >>  0);
+	ptr[1] = static_cast<uint8_t>(cmds >>  8);
+	ptr[2] = static_cast<uint8_t>(cmds >> 16);
+	ptr[3] = static_cast<uint8_t>(cmds >> 24);
+	_out_nibbles += 8;
+	return true;
+}
+
+bool esp_usb_jtag::align()
+{
+	if (_out_nibbles & 0x01)
+		return put_nibble(CMD_FLUSH);
+	return true;
+}
+
+bool esp_usb_jtag::put_clk(const uint8_t *tdi, uint8_t tdi_val,
+		const uint8_t *tms, uint8_t tms_val, uint32_t len, bool cap)
+{
+	const uint8_t tdi_cst = (tdi_val) ? 0xff : 0x00;
+	const uint8_t tms_cst = (tms_val) ? 0xff : 0x00;
+	const uint32_t cap_mask = (cap) ? CMD_CLK_CAP_MASK : 0;
+
+	const uint32_t num_bytes = len >> 3;
+	for (uint32_t i = 0; i < num_bytes; i++) {
+		const uint8_t d = (tdi) ? tdi[i] : tdi_cst;
+		const uint8_t m = (tms) ? tms[i] : tms_cst;
+		if (!put_word(esp_clk_tbl.cmds[d] | (esp_clk_tbl.cmds[m] << 1) | cap_mask))
+			return false;
+		_xfers[_xfer_idx].clks += 8;
+	}
+
+	for (uint32_t i = num_bytes << 3; i < len; i++) {
+		const uint8_t d = (tdi) ? (tdi[i >> 3] >> (i & 7)) & 1 : tdi_val;
+		const uint8_t m = (tms) ? (tms[i >> 3] >> (i & 7)) & 1 : tms_val;
+		if (!put_nibble(CMD_CLK(cap, d, m)))
+			return false;
+		_xfers[_xfer_idx].clks++;
+	}
+	return true;
+}
+
+bool esp_usb_jtag::submit_out()
+{
+	if (_out_nibbles == 0)
+		return true;
+
+	esp_xfer_t *xfer = &_xfers[_xfer_idx];
+	const uint32_t length = _out_nibbles >> 1;
+	if (_verbose) {
+		printf("xfer: write: ");
+		for (uint32_t i = 0; i < length; i++)
+			printf("%02x ", _out_buf[i]);
+		printf("\n");
+	}
+
+	_queued_clks += xfer->clks;
+	libusb_fill_bulk_transfer(xfer->trans, dev_handle, _write_ep, _out_buf,
+		length, out_cb, xfer, xfer_timeout(_queued_clks));
+	int ret = libusb_submit_transfer(xfer->trans);
+	if (ret < 0) {
+		printError("xfer: usb bulk write failed with error " +
+			std::string(libusb_error_name(ret)));
+		_queued_clks -= xfer->clks;
+		return false;
+	}
+	xfer->pending = 1;
+
+	// next slot: wait until free
+	_xfer_idx = (_xfer_idx + 1) % _xfers.size();
+	xfer = &_xfers[_xfer_idx];
+	while (xfer->pending > 0) {
+		if (!wait_event())
+			return false;
+	}
+	xfer->clks = 0;
+	_out_buf = xfer->buf.data();
+	_out_nibbles = 0;
+	return true;
+}
+
+bool esp_usb_jtag::submit_in(uint8_t *rx, uint32_t len)
+{
+	_in_ptr = rx;
+	_in_len = len;
+	_in_tries = 3;  // sometime flush is not immediate
+	libusb_fill_bulk_transfer(_in_trans, dev_handle, ESPUSBJTAG_READ_EP,
+		_in_ptr, _in_len, in_cb, this,
+		xfer_timeout(_queued_clks + _xfers[_xfer_idx].clks + len * 8));
+	int ret = libusb_submit_transfer(_in_trans);
+	if (ret < 0) {
+		printError("xfer: usb bulk read failed with error " +
+			std::string(libusb_error_name(ret)));
+		return false;
+	}
+	_in_busy = true;
+	return true;
+}
+
+bool esp_usb_jtag::wait_xfers()
+{
+	bool busy;
+	do {
+		busy = _in_busy;
+		for (auto &xfer : _xfers)
+			busy |= (xfer.pending > 0);
+		if (busy && !wait_event())
+			break;
+	} while (busy);
+
+	const bool ret = !_xfer_error && !busy;
+	_xfer_error = false;
+	return ret;
+}
+
+bool esp_usb_jtag::wait_event()
+{
+	struct timeval tv = {1, 0};
+	int ret = libusb_handle_events_timeout_completed(usb_ctx, &tv, NULL);
+	if (ret < 0 && ret != LIBUSB_ERROR_INTERRUPTED) {
+		printError("libusb events failed: " +
+			std::string(libusb_error_name(ret)));
+		return false;
+	}
+	return true;
+}
+
+unsigned int esp_usb_jtag::xfer_timeout(uint64_t clks)
+{
+	const uint32_t freq = (_clkHZ > 1000) ? _clkHZ : 1000;
+	return ESPUSBJTAG_TIMEOUT_MS + static_cast<unsigned int>((clks * 1000) / freq);
+}
+
+void LIBUSB_CALL esp_usb_jtag::out_cb(struct libusb_transfer *transfer)
+{
+	esp_xfer_t *xfer = static_cast<esp_xfer_t *>(transfer->user_data);
+	esp_usb_jtag *self = xfer->owner;
+
+	xfer->pending = 0;
+	self->_queued_clks -= xfer->clks;
+	if (transfer->status != LIBUSB_TRANSFER_COMPLETED ||
+			transfer->actual_length != transfer->length) {
+		printError("xfer: usb bulk write failed (status " +
+			std::to_string(transfer->status) + ")");
+		self->_xfer_error = true;
+	}
+}
+
+void LIBUSB_CALL esp_usb_jtag::in_cb(struct libusb_transfer *transfer)
+{
+	esp_usb_jtag *self = static_cast<esp_usb_jtag *>(transfer->user_data);
+	self->_in_busy = false;
+
+	if (transfer->status != LIBUSB_TRANSFER_COMPLETED &&
+			transfer->status != LIBUSB_TRANSFER_TIMED_OUT) {
+		printError("xfer: usb bulk read failed (status " +
+			std::to_string(transfer->status) + ")");
+		self->_xfer_error = true;
+		return;
+	}
+
+	if (self->_verbose) {
+		printf("xfer: read: ");
+		for (int i = 0; i < transfer->actual_length; i++)
+			printf("%02x ", transfer->buffer[i]);
+		printf("\n");
+	}
+
+	if (transfer->actual_length > 0)
+		self->_in_tries = 3;
+	else
+		self->_in_tries--;
+	self->_in_ptr += transfer->actual_length;
+	self->_in_len -= transfer->actual_length;
+	if (self->_in_len == 0)
+		return;
+	if (self->_in_tries <= 0) {
+		printError("writeTDI: usb bulk read missing " +
+			std::to_string(self->_in_len) + " Bytes");
+		self->_xfer_error = true;
+		return;
+	}
+
+	// partial answer: wait for remaining Bytes
+	transfer->buffer = self->_in_ptr;
+	transfer->length = self->_in_len;
+	if (libusb_submit_transfer(transfer) < 0) {
+		printError("xfer: usb bulk read failed");
+		self->_xfer_error = true;
+		return;
+	}
+	self->_in_busy = true;
+}
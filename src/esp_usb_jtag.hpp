@@ -13,6 +13,7 @@
 #include <libusb.h>
 
 #include <string>
+#include <vector>
 
 #include "jtagInterface.hpp"
 
@@ -51,9 +52,74 @@ class esp_usb_jtag : public JtagInterface {
 		int flush() override;
 
 	private:
+		/* one OUT transfer: commands are encoded directly in buf */
+		typedef struct {
+			esp_usb_jtag *owner;
+			libusb_transfer *trans;
+			std::vector<uint8_t> buf;
+			uint32_t clks;  /*!< number of TCK cycles encoded in buf */
+			int pending;    /*!< 1 when submitted, 0 when done */
+		} esp_xfer_t;
+
 		int xfer(const uint8_t *tx, uint8_t *rx, uint16_t length,
 				bool is_timeout_fine=false);
 
+		/*!
+		 * \brief append one command (nibble) to the current buffer,
+		 *        buffer is sent when full
+		 * \return false when USB transfer fails
+		 */
+		bool put_nibble(uint8_t cmd);
+		/*!
+		 * \brief append four command bytes (8 CMD_CLK), the current
+		 *        buffer must be nibble aligned
+		 * \return false when USB transfer fails
+		 */
+		bool put_word(uint32_t cmds);
+		/*!
+		 * \brief pad the current buffer with CMD_FLUSH to be Byte aligned
+		 *        (no-op for IN endpoint since capture are always flushed)
+		 * \return false when USB transfer fails
+		 */
+		bool align();
+		/*!
+		 * \brief encode len CMD_CLK: full Bytes are converted by table,
+		 *        remaining bits one by one. Buffer must be nibble aligned
+		 * \param[in] tdi: TDI vector, NULL to use tdi_val
+		 * \param[in] tms: TMS vector, NULL to use tms_val
+		 * \param[in] cap: capture TDO
+		 * \return false when USB transfer fails
+		 */
+		bool put_clk(const uint8_t *tdi, uint8_t tdi_val, const uint8_t *tms,
+				uint8_t tms_val, uint32_t len, bool cap);
+		/*!
+		 * \brief submit current buffer (must be Byte aligned) and switch
+		 *        to the next one, waiting for it to be free
+		 * \return false when USB transfer fails
+		 */
+		bool submit_out();
+		/*!
+		 * \brief post IN transfer to receive len captured Bytes in rx
+		 * \return false when USB transfer fails
+		 */
+		bool submit_in(uint8_t *rx, uint32_t len);
+		/*!
+		 * \brief wait for all OUT/IN transfers completion
+		 * \return false when one of them fails
+		 */
+		bool wait_xfers();
+		/*!
+		 * \brief handle libusb events (1s max)
+		 * \return false on error
+		 */
+		bool wait_event();
+		/*!
+		 * \brief compute timeout according to TCK cycles to be executed
+		 */
+		unsigned int xfer_timeout(uint64_t clks);
+		static void LIBUSB_CALL out_cb(struct libusb_transfer *transfer);
+		static void LIBUSB_CALL in_cb(struct libusb_transfer *transfer);
+
 		int8_t _verbose;
 
 		// int sendBitBang(uint8_t mask, uint8_t val, uint8_t *read, bool last);
@@ -74,5 +140,19 @@ class esp_usb_jtag : public JtagInterface {
 		uint32_t _write_ep; /* ESP32 Write endpoint */
 		int _vid;
 		int _pid;
+
+		/* OUT transfers ring */
+		std::vector<esp_xfer_t> _xfers;
+		uint32_t _xfer_idx;       /*!< slot currently filled */
+		uint8_t *_out_buf;        /*!< current slot buffer */
+		uint32_t _out_nibbles;    /*!< number of commands in _out_buf */
+		uint64_t _queued_clks;    /*!< TCK cycles submitted not yet done */
+		/* IN transfer (capture) */
+		libusb_transfer *_in_trans;
+		uint8_t *_in_ptr;         /*!< where to store next Bytes */
+		uint32_t _in_len;         /*!< Bytes not yet received */
+		bool _in_busy;
+		int _in_tries;            /*!< remaining empty reads allowed */
+		bool _xfer_error;         /*!< one transfer failed */
 };
 #endif  // SRC_ESPUSBJTAG_HPP_
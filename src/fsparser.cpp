@@ -3,8 +3,10 @@
  * Copyright (C) 2019 Gwenhael Goavec-Merou <gwenhael.goavec-merou@trabucayre.com>
  */
 
+#include <string.h>
+
 #include <iostream>
-#include <sstream>
+#include <utility>
 #include <vector>
 #include <cstdio>
 
@@ -16,7 +18,7 @@ FsParser::FsParser(const std::string &filename, bool reverseByte, bool verbose):
 			ConfigBitstreamParser(filename, ConfigBitstreamParser::ASCII_MODE,
 			verbose), _reverseByte(reverseByte), _end_header(0), _checksum(0),
 			_8Zero(0xff), _4Zero(0xff), _2Zero(0xff),
-			_idcode(0), _compressed(false)
+			_idcode(0), _compressed(false), _cksum_acc(0), _cksum_acc_len(0)
 {
 }
 
@@ -32,37 +34,70 @@ uint64_t FsParser::bitToVal(const char *bits, int len)
 	return val;
 }
 
+/* convert 8 ASCII '0'/'1' (MSB first) to a byte using one 64-bit word
+ * return false when one char is not '0' or '1'
+ */
+static inline bool asciiToByte(const char *bits, uint8_t *val)
+{
+	uint64_t v = 0;
+	for (int i = 0; i < 8; i++)
+		v |= static_cast<uint64_t>(static_cast<uint8_t>(bits[i])) << (8 * i);
+	if ((v & 0xfefefefefefefefeULL) != 0x3030303030303030ULL)
+		return false;
+	/* char i is at bit 8 * i: gather all bits in MSB (char 0 -> bit 7) */
+	v &= 0x0101010101010101ULL;
+	*val = static_cast<uint8_t>((v * 0x8040201008040201ULL) >> 56);
+	return true;
+}
+
+void FsParser::checksumAppend(uint8_t val, int len)
+{
+	_cksum_acc = (_cksum_acc << len) | (val & ((1 << len) - 1));
+	_cksum_acc_len += len;
+	if (_cksum_acc_len >= 16) {
+		_cksum_acc_len -= 16;
+		_checksum += static_cast<uint16_t>(_cksum_acc >> _cksum_acc_len);
+		_cksum_acc &= (1 << _cksum_acc_len) - 1;
+	}
+}
+
 int FsParser::parseHeader()
 {
 	int ret = 0;
-	std::string buffer;
 	int line_index = 0;
 	bool in_header = true;
+	const char *raw = _raw_data.data();
+	const size_t raw_size = _raw_data.size();
+	size_t pos = 0;
+
+	while (pos < raw_size) {
+		const char *eol = static_cast<const char *>(
+			memchr(raw + pos, '\n', raw_size - pos));
+		const size_t next = (eol) ? eol - raw + 1 : raw_size;
+		size_t line_length = ((eol) ? eol - raw : raw_size) - pos;
+		const char *buffer = raw + pos;
+		const size_t line_start = pos;
+		pos = next;
 
-	std::istringstream lineStream(_raw_data);
-
-	while (std::getline(lineStream, buffer, '\n')) {
 		/* store full/real file lenght */
-		ret += buffer.size() + 1;
+		ret += line_length + 1;
 
 		/* FIXME: a line can't be empty -> error */
-		if (buffer.empty())
+		if (line_length == 0)
 			break;
 		/* dos file */
-		if (buffer.back() == '\r')
-			buffer.pop_back();
+		if (buffer[line_length - 1] == '\r')
+			line_length--;
 
 		/* FIXME: a line can't be empty -> error */
-		if (buffer.empty())
+		if (line_length == 0)
 			break;
 		/* drop all comment, base analyze on header */
 		if (buffer[0] == '/')
 			continue;
 
-		const size_t line_length = buffer.size();
-
-		/* store each line in dedicated buffer for future use */
-		_lstRawData.push_back(buffer);
+		/* store each line position for future use */
+		_lines.emplace_back(line_start, line_length);
 
 		/* only headers are parsed by next portion of code */
 		if (!in_header)
@@ -73,10 +108,10 @@ int FsParser::parseHeader()
 			printError("FsParser: Potential corrupted file");
 			return 0;
 		}
-		uint8_t c = bitToVal(buffer.substr(0, 8).c_str(), 8);
+		uint8_t c = bitToVal(buffer, 8);
 		uint8_t key = c & 0x7F;
 		/* the line length depends on key/information */
-		uint64_t val = bitToVal(buffer.c_str(), line_length);
+		uint64_t val = bitToVal(buffer, line_length);
 
 		char __buf[10];
 		int __buf_valid_bytes;
@@ -179,7 +214,6 @@ int FsParser::parseHeader()
 
 int FsParser::parse()
 {
-	std::string tmp;
 	/* GW1N-6 and GW1N(R)-9 are address length not multiple of byte */
 	int padding = 0;
 
@@ -187,27 +221,6 @@ int FsParser::parse()
 
 	parseHeader();
 
-	/* Fs file format is MSB first
-	 * so if reverseByte = false bit 0 -> 7, 1 -> 6,
-	 * if true 0 -> 0, 1 -> 1
-	 */
-
-	_bit_data.reserve(_raw_data.size() / 8);
-	for (auto &&line : _lstRawData) {
-		const size_t line_length = line.size();
-		if ((line_length % 8) != 0) {
-			printError("FsParser: truncated line in bitstream data");
-			return EXIT_FAILURE;
-		}
-		for (size_t i = 0; i < line_length; i += 8) {
-			uint8_t data = bitToVal(&line[i], 8);
-			_bit_data.push_back((_reverseByte) ? reverseByte(data) : data);
-		}
-	}
-
-	_bit_length = static_cast<int>(_bit_data.size() * 8);
-
-
 	if (_idcode == 0)
 		printWarn("Warning: IDCODE not found\n");
 
@@ -264,9 +277,13 @@ int FsParser::parse()
 	if (stoul(_hdr["ConfDataLength"]) < nb_line)
 		nb_line = stoi(_hdr["ConfDataLength"]);
 
-	/* drop now useless header */
-	_lstRawData.erase(_lstRawData.begin(), _lstRawData.begin() + _end_header + 1);
-	_lstRawData.resize(nb_line);
+	/* configuration data lines used for checksum: just after header */
+	const size_t cksum_first = _end_header + 1;
+	const size_t cksum_last = cksum_first + nb_line;
+	if (cksum_last > _lines.size()) {
+		printError("FsParser: truncated configuration line");
+		return EXIT_FAILURE;
+	}
 
 	/* line full length depends on
 	 * 1/ model
@@ -279,58 +296,88 @@ int FsParser::parse()
 	/* to compute checksum two situation
 	 * 1/ uncompressed bitstream -> go
 	 * 2/ compressed bitstream -> need to uncompress this before
+	 * checksum is the sum of 16-bit words (MSB first) of all lines
+	 * payload (without padding) concatenated
 	 */
-	int drop = 6 * 8;
+	size_t drop = 6 * 8;
 	if (_hdr["CRCCheck"] == "ON")
 		drop += 2 * 8;
-	for (auto &&ll = _lstRawData.begin();
-			ll != _lstRawData.end(); ll++) {
-		std::string l = "";
-		const std::string &line = *ll;
-		const size_t line_length = line.size();
-		if (line_length < static_cast<size_t>(drop)) {
-			printError("FsParser: truncated configuration line");
+
+	/* Fs file format is MSB first
+	 * so if reverseByte = false bit 0 -> 7, 1 -> 6,
+	 * if true 0 -> 0, 1 -> 1
+	 * each line is converted 8 chars at a time and, for configuration
+	 * data lines, added to the checksum in the same pass
+	 */
+	_checksum = 0;
+	_bit_data.reserve(_raw_data.size() / 8);
+	for (size_t l = 0; l < _lines.size(); l++) {
+		const char *line = _raw_data.data() + _lines[l].first;
+		const size_t line_length = _lines[l].second;
+		if ((line_length % 8) != 0) {
+			printError("FsParser: truncated line in bitstream data");
 			return EXIT_FAILURE;
 		}
-		if (_compressed) {
-			const size_t payload_len = line_length - drop;
-			if ((payload_len % 8) != 0) {
-				printError("FsParser: compressed line is not byte aligned");
+
+		const bool in_cksum = (l >= cksum_first && l < cksum_last);
+		size_t payload_len = 0;
+		int skip = 0;  // padding bits to drop (after decompression)
+		if (in_cksum) {
+			if (line_length < drop) {
+				printError("FsParser: truncated configuration line");
 				return EXIT_FAILURE;
 			}
-			l.reserve(payload_len * 8);
-			for (size_t i = 0; i < payload_len; i += 8) {
-				uint8_t c = bitToVal((const char *)&line[i], 8);
-				if (c == _8Zero)
-					l += std::string(8*8, '0');
-				else if (c == _4Zero)
-					l += std::string(4*8, '0');
-				else if (c == _2Zero)
-					l += std::string(2*8, '0');
-				else
-					l += line.substr(i, 8);
+			payload_len = line_length - drop;
+			skip = padding;
+		}
+
+		for (size_t i = 0; i < line_length; i += 8) {
+			uint8_t data;
+			if (!asciiToByte(&line[i], &data))
+				data = bitToVal(&line[i], 8);
+			_bit_data.push_back((_reverseByte) ? reverseByte(data) : data);
+
+			if (i >= payload_len)
+				continue;
+
+			/* compressed: some values are a serie of 0x00 */
+			int nb_bytes = 1;
+			if (_compressed) {
+				if (data == _8Zero)
+					nb_bytes = 8;
+				else if (data == _4Zero)
+					nb_bytes = 4;
+				else if (data == _2Zero)
+					nb_bytes = 2;
+				if (nb_bytes != 1)
+					data = 0;
+			}
+			for (int b = 0; b < nb_bytes; b++) {
+				if (skip >= 8) {
+					skip -= 8;
+				} else {
+					checksumAppend(data, 8 - skip);
+					skip = 0;
+				}
 			}
-		} else {
-			l = line.substr(0, line_length - drop);
 		}
-		const size_t l_length = l.size();
 
-		/* store bit for checksum */
-		if (static_cast<size_t>(padding) > l_length) {
+		if (in_cksum && skip != 0) {
 			printError("FsParser: invalid padding for configuration line");
 			return EXIT_FAILURE;
 		}
-		tmp += l.substr(padding, l_length - padding);
 	}
 
-	/* checksum */
-	_checksum = 0;
-	if ((tmp.size() % 16) != 0) {
+	_bit_length = static_cast<int>(_bit_data.size() * 8);
+
+	/* drop now useless lines list */
+	_lines.clear();
+	_lines.shrink_to_fit();
+
+	if (_cksum_acc_len != 0) {
 		printError("FsParser: checksum data is truncated");
 		return EXIT_FAILURE;
 	}
-	for (uint32_t pos = 0; pos < tmp.size(); pos+=16)
-		_checksum += (uint16_t)bitToVal(&tmp[pos], 16);
 
 	if (_verbose)
 		printf("checksum 0x%04x\n", _checksum);
@@ -32,6 +32,14 @@ class FsParser: public ConfigBitstreamParser {
 		 * \return converted value
 		 */
 		uint64_t bitToVal(const char *bits, int len);
+		/**
+		 * \brief append up to 8 bits (MSB first) to the checksum
+		 *        16-bit words stream
+		 *
+		 * \param[in] val: bits to append (right aligned)
+		 * \param[in] len: number of bits
+		 */
+		void checksumAppend(uint8_t val, int len);
 
 		bool _reverseByte; /*!< direct or reverse bit */
 		uint16_t _end_header; /*!< last header line */
@@ -41,7 +49,10 @@ class FsParser: public ConfigBitstreamParser {
 		uint8_t _2Zero; /*!< in compress mode, used to replace 8 * 0x00 */
 		uint32_t _idcode; /*!< device idcode */
 		bool _compressed; /*!< compress mode or not */
-		std::vector<std::string> _lstRawData; /* cfg + EBR data buffer */
+		/* cfg + EBR lines: offset and length in _raw_data */
+		std::vector<std::pair<size_t, size_t>> _lines;
+		uint32_t _cksum_acc; /*!< checksum bits not yet summed */
+		int _cksum_acc_len; /*!< number of bits in _cksum_acc */
 };
 
 #endif  // FSPARSER_HPP_
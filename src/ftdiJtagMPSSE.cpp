@@ -37,7 +37,7 @@ FtdiJtagMPSSE::FtdiJtagMPSSE(const cable_t &cable,
 			_write_mode(MPSSE_WRITE_NEG),  // always write on neg edge
 			_read_mode(0),
 			_invert_read_edge(invert_read_edge),  // false: pos, true: neg
-			_tdo_pos(0)
+			_msb_first(false), _tdo_read_len(0), _tdo_pos(0)
 {
 	init_internal(cable.config);
 }
@@ -398,20 +398,24 @@ int32_t FtdiJtagMPSSE::update_tms_buff(uint8_t *buffer, uint8_t bit,
 		uint8_t mp[3] = {
 			static_cast<unsigned char>(MPSSE_WRITE_TMS | MPSSE_LSB |
 										MPSSE_BITMODE | _write_mode |
-										MPSSE_DO_READ | _read_mode),
+										((tdo) ? (MPSSE_DO_READ | _read_mode) : 0)),
 			static_cast<uint8_t>(offset - 1),
 			buffer[0]
 		};
-		// force a write
 		if (_verbose)
 			printf("\t%02x %02d %02x\n", mp[0], mp[1], mp[2]);
-		if ((ret = mpsse_store(mp, 3)) < 0)
+		/* read is delayed, except for ch552 (one read by command) */
+		if (tdo && !_ch552WA && (ret = tdo_read(offset, true, tdo)) < 0)
 			return ret;
-		uint8_t tdo_tmp;
-		if ((ret = mpsse_read(&tdo_tmp, 1)) < 0)
+		if ((ret = mpsse_store(mp, 3)) < 0)
 			return ret;
-		tdo_tmp >>= (8 - offset);
-		update_tdo_buff(&tdo_tmp, tdo, offset);
+		if (tdo && _ch552WA) {
+			uint8_t tdo_tmp;
+			if ((ret = mpsse_read(&tdo_tmp, 1)) < 0)
+				return ret;
+			tdo_tmp >>= (8 - offset);
+			update_tdo_buff(&tdo_tmp, tdo, offset);
+		}
 		offset = 0;
 		buffer[0] = 0;
 	}
@@ -447,11 +451,18 @@ bool FtdiJtagMPSSE::writeTMSTDI(const uint8_t *tms, const uint8_t *tdi,
 	uint8_t mode = 0;          // current state: 0 none, 1 TDI, 2 TMS
 	uint8_t tdi_buf[max_len];  // buffer to store TDI sequence
 	uint8_t tms_tmp = 0;       // buffer to store TMS sequence (limited to 6bits per cmd)
-	uint8_t tdo_tmp[max_len];  // local TDO sequence
 	uint32_t buff_len = 0;     // current bits stored
 	memset(tdi_buf, 0, max_len);
-	memset(tdo_tmp, 0, max_len);
 	_tdo_pos = 0;  // current bits read
+	_tdo_reads.clear();
+	_tdo_read_len = 0;
+
+	/* ch552 WA reads after each command */
+	std::vector<uint8_t> dummy_tdo;
+	if (!tdo && _ch552WA) {
+		dummy_tdo.resize((len + 7) / 8);
+		tdo = dummy_tdo.data();
+	}
 
 	if (_verbose)
 		printSuccess("begin: " + std::to_string(len));
@@ -526,12 +537,13 @@ bool FtdiJtagMPSSE::writeTMSTDI(const uint8_t *tms, const uint8_t *tdi,
 					buff_len++;
 					is_end = true;
 				}
-				writeTDI(tdi_buf, tdo_tmp, buff_len, is_end);
-				update_tdo_buff(tdo_tmp, tdo, buff_len);
+				if (store_tdi(tdi_buf, buff_len, is_end, tdo) < 0)
+					return false;
 				memset(tdi_buf, 0, max_len);
 				buff_len = 0;
 				if (is_end) {
 					_curr_tdi = tdi_bit;
+					_curr_tms = tms_bit;
 					mode = 1;
 					continue;
 				}
@@ -555,8 +567,8 @@ bool FtdiJtagMPSSE::writeTMSTDI(const uint8_t *tms, const uint8_t *tdi,
 
 		/* buffer full? */
 		if (buff_len == 8*max_len && mode == 1) {
-			writeTDI(tdi_buf, tdo_tmp, buff_len, false);
-			update_tdo_buff(tdo_tmp, tdo, buff_len);
+			if (store_tdi(tdi_buf, buff_len, false, tdo) < 0)
+				return false;
 			memset(tdi_buf, 0, max_len);
 			buff_len = 0;
 		} else if (buff_len == 6 && mode == 2) {
@@ -575,8 +587,8 @@ bool FtdiJtagMPSSE::writeTMSTDI(const uint8_t *tms, const uint8_t *tdi,
 	if (buff_len > 0) {
 		switch (mode) {
 		case 1:
-			writeTDI(tdi_buf, tdo_tmp, buff_len, false);
-			update_tdo_buff(tdo_tmp, tdo, buff_len);
+			if (store_tdi(tdi_buf, buff_len, false, tdo) < 0)
+				return false;
 			break;
 		case 2:
 			if (update_tms_buff(&tms_tmp, 0, buff_len, _curr_tdi,
@@ -585,6 +597,9 @@ bool FtdiJtagMPSSE::writeTMSTDI(const uint8_t *tms, const uint8_t *tdi,
 			break;
 		}
 	}
+	/* write only: sequence stays in the buffer until next flush */
+	if (tdo && tdo_flush(tdo) < 0)
+		return false;
 	if (_verbose) {
 		printSuccess("end state: tdi " + std::to_string(_curr_tdi) +
 				" tms " + std::to_string(_curr_tms));
@@ -592,3 +607,113 @@ bool FtdiJtagMPSSE::writeTMSTDI(const uint8_t *tms, const uint8_t *tdi,
 
 	return true;
 }
+
+int32_t FtdiJtagMPSSE::store_tdi(const uint8_t *tdi, uint32_t len, bool end,
+		uint8_t *tdo)
+{
+	/* ch552: one read by command, done by writeTDI */
+	if (_ch552WA) {
+		std::vector<uint8_t> tdo_tmp((len + 7) / 8, 0);
+		if (writeTDI(tdi, tdo_tmp.data(), len, end) < 0)
+			return -1;
+		update_tdo_buff(tdo_tmp.data(), tdo, len);
+		return len;
+	}
+
+	const uint32_t real_len = (end) ? len - 1 : len;
+	uint32_t nb_byte = real_len >> 3;
+	const uint32_t nb_bit = real_len & 0x07;
+	const uint32_t max_xfer = mpsse_get_buffer_size() - 3;
+	const bool use_msb_first = _msb_first && !tdo;
+	const uint8_t rd = (tdo) ? (MPSSE_DO_READ | _read_mode) : 0;
+	const uint8_t *tx_ptr = tdi;
+	uint8_t rev[max_xfer];
+
+	while (nb_byte != 0) {
+		const uint32_t xfer_len = (nb_byte > max_xfer) ? max_xfer : nb_byte;
+		uint8_t cmd[3] = {
+			static_cast<uint8_t>(((use_msb_first) ? 0 : MPSSE_LSB) |
+				MPSSE_DO_WRITE | _write_mode | rd),
+			static_cast<uint8_t>((xfer_len - 1) & 0xff),
+			static_cast<uint8_t>(((xfer_len - 1) >> 8) & 0xff)};
+		if (tdo && tdo_read(xfer_len * 8, false, tdo) < 0)
+			return -1;
+		if (mpsse_store(cmd, 3) < 0)
+			return -1;
+		if (use_msb_first) {
+			for (uint32_t i = 0; i < xfer_len; i++)
+				rev[i] = bit_reverse(tx_ptr[i]);
+		} else {
+			memcpy(rev, tx_ptr, xfer_len);
+		}
+		if (mpsse_store(rev, xfer_len) < 0)
+			return -1;
+		tx_ptr += xfer_len;
+		nb_byte -= xfer_len;
+	}
+
+	if (nb_bit != 0) {
+		uint8_t cmd[3] = {
+			static_cast<uint8_t>(MPSSE_LSB | MPSSE_BITMODE |
+				MPSSE_DO_WRITE | _write_mode | rd),
+			static_cast<uint8_t>(nb_bit - 1), *tx_ptr};
+		if (tdo && tdo_read(nb_bit, true, tdo) < 0)
+			return -1;
+		if (mpsse_store(cmd, 3) < 0)
+			return -1;
+	}
+
+	/* last bit in conjunction with TMS (bit 7: TDI) */
+	if (end) {
+		const uint8_t last_bit = (*tx_ptr >> nb_bit) & 0x01;
+		uint8_t cmd[3] = {
+			static_cast<uint8_t>(MPSSE_WRITE_TMS | MPSSE_LSB |
+				MPSSE_BITMODE | _write_mode | rd),
+			0, static_cast<uint8_t>((last_bit) ? 0x81 : 0x01)};
+		if (tdo && tdo_read(1, true, tdo) < 0)
+			return -1;
+		if (mpsse_store(cmd, 3) < 0)
+			return -1;
+	}
+
+	return len;
+}
+
+int FtdiJtagMPSSE::tdo_read(uint32_t len, bool bit_mode, uint8_t *tdo)
+{
+	const uint32_t nb_bytes = (bit_mode) ? 1 : len / 8;
+	/* answers must fit in FTDI buffer */
+	if (_tdo_read_len + nb_bytes > (uint32_t)mpsse_get_buffer_size() - 3 &&
+			tdo_flush(tdo) < 0)
+		return -1;
+	_tdo_reads.push_back({len, bit_mode});
+	_tdo_read_len += nb_bytes;
+	return 0;
+}
+
+int FtdiJtagMPSSE::tdo_flush(uint8_t *tdo)
+{
+	if (_tdo_read_len == 0)
+		return 0;
+
+	std::vector<uint8_t> rx(_tdo_read_len);
+	int ret = mpsse_read(rx.data(), _tdo_read_len);
+	_tdo_read_len = 0;
+	if (ret < 0) {
+		_tdo_reads.clear();
+		return ret;
+	}
+
+	uint8_t *ptr = rx.data();
+	for (auto &&rd : _tdo_reads) {
+		if (rd.bit_mode) {
+			uint8_t tmp = *ptr++ >> (8 - rd.len);
+			update_tdo_buff(&tmp, tdo, rd.len);
+		} else {
+			update_tdo_buff(ptr, tdo, rd.len);
+			ptr += rd.len / 8;
+		}
+	}
+	_tdo_reads.clear();
+	return 0;
+}
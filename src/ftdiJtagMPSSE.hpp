@@ -71,7 +71,8 @@ class FtdiJtagMPSSE : public JtagInterface, public FTDIpp_MPSSE {
 	 * \brief send TMD and TDI and receive tdo bits;
 	 * \param tms: array of TMS values (used to write)
 	 * \param tdi: array of TDI values (used to write)
-	 * \param tdo: array of TDO values (used when read)
+	 * \param tdo: array of TDO values (used when read), NULL for a
+	 *             write only (buffered) sequence
 	 * \param len: number of bit to send/receive
 	 * \return true with full buffers are sent, false otherwise
 	 */
@@ -95,13 +96,38 @@ class FtdiJtagMPSSE : public JtagInterface, public FTDIpp_MPSSE {
 	 * \param buffer: current tms buffer
 	 * \param bit: bit to append
 	 * \param offset: bits already stored
-	 * \param tdo: buffer used when reading after flush
+	 * \param tdo: buffer used when reading after flush (NULL: no read)
 	 * \param len: length
 	 * \return < 0 if transaction fails, offset + 1 when append and 0 when flush
 	 */
 	int32_t update_tms_buff(uint8_t *buffer, uint8_t bit,
 		uint32_t offset, uint8_t tdi, uint8_t *tdo, bool end = false);
 	uint32_t update_tdo_buff(uint8_t *buffer, uint8_t *tdo, uint32_t len);
+	/*!
+	 * \brief store commands for a TDI sequence (TMS low, high with
+	 *        last bit when end)
+	 * \param tdi: TDI sequence
+	 * \param len: number of bits
+	 * \param end: TMS high with last bit
+	 * \param tdo: TDO destination (NULL: no read)
+	 * \return < 0 if transaction fails, len otherwise
+	 */
+	int32_t store_tdi(const uint8_t *tdi, uint32_t len, bool end,
+		uint8_t *tdo);
+	/*!
+	 * \brief register a read for the next command. Pending reads
+	 *        are done by tdo_flush when the FTDI read buffer is full
+	 * \param len: number of bits
+	 * \param bit_mode: bit command (one byte, bits left aligned)
+	 * \param tdo: TDO destination
+	 * \return < 0 if transaction fails, 0 otherwise
+	 */
+	int tdo_read(uint32_t len, bool bit_mode, uint8_t *tdo);
+	/*!
+	 * \brief read all pending TDO with one transaction and fill tdo
+	 * \return < 0 if transaction fails, 0 otherwise
+	 */
+	int tdo_flush(uint8_t *tdo);
 	/*!
 	 * \brief configure read and write edge (pos or neg), with freq < 15MHz
 	 *        neg is used for write and pos to sample. with freq >= 15MHz
@@ -115,6 +141,12 @@ class FtdiJtagMPSSE : public JtagInterface, public FTDIpp_MPSSE {
 	bool _invert_read_edge; /**< read edge selection (false: pos, true: neg) */
 	bool _msb_first; /**< use MSB first, workaround for sipeed console */
 	/* writeTMSTDI specifics */
+	typedef struct {
+		uint32_t len;   /*!< number of bits */
+		bool bit_mode;  /*!< bit command: bits left aligned in one byte */
+	} tdo_read_t;
+	std::vector<tdo_read_t> _tdo_reads;  /*!< reads not yet done */
+	uint32_t _tdo_read_len;  /*!< pending reads size (Bytes) */
 	uint32_t _tdo_pos;
 	uint8_t _curr_tdi;
 	uint8_t _curr_tms;
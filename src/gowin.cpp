@@ -10,6 +10,7 @@
 #include <strings.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <iostream>
 #include <stdexcept>
 
@@ -74,6 +75,11 @@
 #define BSCAN_GW1NSR_4C_SPI_DO  (1 << 1)
 #define BSCAN_GW1NSR_4C_SPI_MSK (1 << 0)
 
+/* bscan SPI: idle clocks after each register update */
+#define BSCAN_SPI_IDLE_CLK      6
+/* bscan SPI: max SPI bytes sent by one TMS/TDI stream */
+#define BSCAN_SPI_BATCH_LEN     256
+
 Gowin::Gowin(Jtag *jtag, const std::string filename, const std::string &file_type, std::string mcufw,
 		Device::prog_type_t prg_type, bool external_flash,
 		bool verify, int8_t verbose, const std::string& user_flash)
@@ -590,7 +596,7 @@ bool Gowin::writeFLASH(uint32_t page, const uint8_t *data, int length, bool inve
 {
 
 #if 1
- uint8_t tx[4] = {0x4E, 0x31, 0x57, 0x47};
+    uint8_t page_words[256];
     uint8_t tmp[4];
     uint32_t addr;
     int nb_iter;
@@ -663,26 +669,31 @@ bool Gowin::writeFLASH(uint32_t page, const uint8_t *data, int length, bool inve
         else
             nb_iter = 64;
 
+        /* build the page words stream */
         for (int ypage = 0; ypage < nb_iter; ypage++) {
             unsigned char *t = buffer+xoffset + 4*ypage;
+            uint8_t *w = &page_words[4 * ypage];
             for (int x=0; x < 4; x++) {
                 if (page == 0)
-                    tx[3-x] = t[x];
+                    w[3-x] = t[x];
                 else
-                    tx[x] = t[x];
+                    w[x] = t[x];
             }
 
             if (invert_bits) {
             	for (int x = 0; x < 4; x++) {
-            		tx[x] ^= 0xFF;
+            		w[x] ^= 0xFF;
             	}
             }
-
-            _jtag->shiftDR(tx, NULL, 32);
-
-            if (!is_gw1n1)
-                _jtag->toggleClk(40);
         }
+
+        /* one word per scan, followed by 40 idle clocks (except GW1N1):
+         * whole page sent as one write only TMS/TDI stream when supported
+         * (no read back, kept in the cable buffer), otherwise same
+         * shiftDR/toggleClk sequence as before
+         */
+        _jtag->shiftDR_batch(page_words, NULL, 32, nb_iter,
+            (is_gw1n1) ? 0 : 40);
         if (is_gw1n1) {
             //usleep(10*2400*2);
             uint8_t tt2[6008/8];
@@ -982,7 +993,13 @@ bool Gowin::eraseSRAM()
 
 inline void Gowin::spi_gowin_write(const uint8_t *wr, uint8_t *rd, unsigned len) {
 	_jtag->shiftDR(wr, rd, len);
-	_jtag->toggleClk(6);
+	_jtag->toggleClk(BSCAN_SPI_IDLE_CLK);
+}
+
+void Gowin::spi_gowin_steps(const std::vector<uint8_t> &steps, uint8_t *rd)
+{
+	_jtag->shiftDR_batch(steps.data(), rd, 8, steps.size(),
+		BSCAN_SPI_IDLE_CLK);
 }
 
 /* SPI wrapper
@@ -1051,35 +1068,58 @@ int Gowin::spi_put(const uint8_t *tx, uint8_t *rx, uint32_t len)
 			}
 		}
 	} else {
+		/* the full transaction is converted to a sequence of bscan
+		 * register values, sent by chunk of BSCAN_SPI_BATCH_LEN bytes
+		 */
+		std::vector<uint8_t> steps;
+		std::vector<uint8_t> rd;
+		steps.reserve(2 + 16 * BSCAN_SPI_BATCH_LEN);
+		rd.resize(2 + 16 * BSCAN_SPI_BATCH_LEN);
+
 		/* set CS/SCK/DI low */
 		uint8_t t = _spi_msk | _spi_do;
 		t &= ~_spi_cs;
-		spi_gowin_write(&t, NULL, 8);
-		_jtag->flush();
+		steps.push_back(t);
 
-		/* send bit/bit full tx content (or set di to 0 when NULL) */
-		for (unsigned l = 0; l < len; ++l) {
-			if (rx)
-				rx[l] = 0;
-			for (uint8_t b = 0, bm = 0x80; b < 8; ++b, bm >>= 1) {
-				uint8_t r;
-				t = _spi_msk | _spi_do;
-				if (tx != NULL && tx[l] & bm)
-					t |= _spi_di;
-				spi_gowin_write(&t, NULL, 8);
-				t |= _spi_sck;
-				spi_gowin_write(&t, (rx) ? &r : NULL, 8);
-				_jtag->flush();
-				/* if read reconstruct bytes */
-				if (rx && (r & _spi_do))
-					rx[l] |= bm;
+		uint32_t xfer = 0;
+		do {
+			const uint32_t xfer_len = std::min<uint32_t>(len - xfer,
+					BSCAN_SPI_BATCH_LEN);
+			const size_t first = steps.size();
+			/* send bit/bit full tx content (or set di to 0 when NULL) */
+			for (uint32_t l = xfer; l < xfer + xfer_len; ++l) {
+				for (uint8_t bm = 0x80; bm != 0; bm >>= 1) {
+					t = _spi_msk | _spi_do;
+					if (tx != NULL && tx[l] & bm)
+						t |= _spi_di;
+					steps.push_back(t);
+					t |= _spi_sck;
+					steps.push_back(t);
+				}
 			}
-		}
-		/* set CS and unset SCK (next xfer) */
-		t &= ~_spi_sck;
-		t |= _spi_cs;
-		spi_gowin_write(&t, NULL, 8);
-		_jtag->flush();
+			/* set CS and unset SCK (next xfer) */
+			if (xfer + xfer_len == len) {
+				t &= ~_spi_sck;
+				t |= _spi_cs;
+				steps.push_back(t);
+			}
+
+			spi_gowin_steps(steps, (rx) ? rd.data() : NULL);
+
+			/* if read reconstruct bytes: DO is sampled with SCK high */
+			if (rx) {
+				const uint8_t *r = &rd[first + 1];
+				for (uint32_t l = xfer; l < xfer + xfer_len; ++l) {
+					rx[l] = 0;
+					for (uint8_t bm = 0x80; bm != 0; bm >>= 1, r += 2) {
+						if (*r & _spi_do)
+							rx[l] |= bm;
+					}
+				}
+			}
+			steps.clear();
+			xfer += xfer_len;
+		} while (xfer < len);
 	}
 	return 0;
 }
@@ -1117,34 +1157,39 @@ int Gowin::spi_wait(uint8_t cmd, uint8_t mask, uint8_t cond,
 		} while ((tmp & mask) != cond);
 	} else {
 		uint8_t t;
+		std::vector<uint8_t> steps;
+		uint8_t rd[16];
 
 		/* set CS/SCK/DI low */
 		t = _spi_msk | _spi_do;
-		spi_gowin_write(&t, NULL, 8);
+		steps.push_back(t);
 
 		/* send command bit/bit */
 		for (uint8_t i = 0, bm = 0x80; i < 8; ++i, bm >>= 1) {
 			t = _spi_msk | _spi_do;
 			if ((cmd & bm) != 0)
 				t |= _spi_di;
-			spi_gowin_write(&t, NULL, 8);
+			steps.push_back(t);
 			t |= _spi_sck;
-			spi_gowin_write(&t, NULL, 8);
-			_jtag->flush();
+			steps.push_back(t);
 		}
+		spi_gowin_steps(steps, NULL);
 
+		/* read status register bit/bit with di == 0 */
 		t = _spi_msk | _spi_do;
+		steps.clear();
+		for (uint8_t i = 0; i < 8; ++i) {
+			t &= ~_spi_sck;
+			steps.push_back(t);
+			t |= _spi_sck;
+			steps.push_back(t);
+		}
+
 		do {
 			tmp = 0;
-			/* read status register bit/bit with di == 0 */
+			spi_gowin_steps(steps, rd);
 			for (uint8_t i = 0, bm = 0x80; i < 8; ++i, bm >>= 1) {
-				uint8_t r;
-				t &= ~_spi_sck;
-				spi_gowin_write(&t, NULL, 8);
-				t |= _spi_sck;
-				spi_gowin_write(&t, &r, 8);
-				_jtag->flush();
-				if ((r & _spi_do) != 0)
+				if ((rd[2 * i + 1] & _spi_do) != 0)
 					tmp |= bm;
 			}
 
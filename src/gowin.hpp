@@ -102,6 +102,14 @@ class Gowin: public Device, FlashInterface {
 		bool detectFamily();
 		bool send_command(uint8_t cmd);
 		void spi_gowin_write(const uint8_t *wr, uint8_t *rd, unsigned len);
+		/*!
+		 * \brief send a sequence of bscan SPI register values. When the
+		 *        cable supports it, the full sequence (DR scans and idle
+		 *        clocks) is sent as one TMS/TDI stream
+		 * \param[in] steps: bscan register values
+		 * \param[out] rd: register value captured for each step (may be NULL)
+		 */
+		void spi_gowin_steps(const std::vector<uint8_t> &steps, uint8_t *rd);
 		uint32_t readReg32(uint8_t cmd);
 		void sendClkUs(unsigned us);
 		bool enableCfg();
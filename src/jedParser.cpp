@@ -32,6 +32,7 @@
 
 JedParser::JedParser(const std::string &filename, bool verbose):
 	ConfigBitstreamParser(filename, ConfigBitstreamParser::BIN_MODE, verbose),
+	_row_offsets(1, 0), _row_fuses(1, 0), _fuse_acc(0), _fuse_acc_len(0),
 	_fuse_count(0), _pin_count(0), _max_vect_test(0),
 	_featuresRow(0), _feabits(0), _has_feabits(false), _checksum(0),
 	_compute_checksum(0),
@@ -79,46 +80,79 @@ std::vector<std::string> JedParser::readJEDLine()
 	return lines;
 }
 
-/* convert one serie ASCII 1/0 to a vector of
- * unsigned char
+/* checksum is computed on the continuous fuses list (without rows
+ * padding): accumulate len fuses (LSB first) and update checksum for
+ * each completed byte
+ */
+void JedParser::checksumFuses(uint8_t fuses, int len)
+{
+	_fuse_acc |= static_cast<uint16_t>(fuses) << _fuse_acc_len;
+	_fuse_acc_len += len;
+	if (_fuse_acc_len >= 8) {
+		_compute_checksum += _fuse_acc & 0xff;
+		_fuse_acc >>= 8;
+		_fuse_acc_len -= 8;
+	}
+}
+
+/* close current row: store end offset and fuse index
+ */
+void JedParser::endRow(struct jed_data &jed, size_t nb_fuses)
+{
+	_row_offsets.push_back(_rows_data.size());
+	_row_fuses.push_back(_row_fuses.back() + nb_fuses);
+	jed.nb_rows++;
+}
+
+/* fuses are only stored by rows: search row containing pos
+ */
+uint8_t JedParser::get_fuse(size_t pos) const
+{
+	const auto it = std::upper_bound(_row_fuses.begin(), _row_fuses.end(), pos);
+	const size_t row = std::distance(_row_fuses.begin(), it) - 1;
+	const size_t bit = pos - _row_fuses[row];
+	return (_rows_data[_row_offsets[row] + (bit >> 3)] >> (bit & 0x07)) & 0x01;
+}
+
+/* convert one serie ASCII 1/0 to a packed row
+ * (first fuse is LSB)
  */
 void JedParser::buildDataArray(const std::string &content, struct jed_data &jed)
 {
-	size_t data_len = content.size();
-	std::string tmp_buff;
-	fuselist += content;
-	for (size_t i = 0; i < content.size(); i+=8) {
+	const size_t data_len = content.size();
+	for (size_t i = 0; i < data_len; i+=8) {
+		const int len = static_cast<int>(std::min(data_len - i, size_t(8)));
 		uint8_t data = 0;
-		for (int ii = 0; ii < 8; ii++) {
+		for (int ii = 0; ii < len; ii++) {
 			uint8_t val = (content[i+ii] == '1'?1:0);
 			data |= val << ii;
 		}
-		tmp_buff += data;
+		_rows_data.push_back(data);
+		checksumFuses(data, len);
 	}
-	jed.data.push_back(std::move(tmp_buff));
+	endRow(jed, data_len);
 	jed.len += data_len;
 }
 
-/* convert one serie ASCII 1/0 to a vector of
- * unsigned char
+/* convert one serie ASCII 1/0 to a packed row
  * string must be up to 8 bits
  */
 void JedParser::buildDataArray(const std::vector<std::string> &content,
 		struct jed_data &jed)
 {
 	size_t data_len = 0;
-	std::string tmp_buff;
 	for (size_t i = 0; i < content.size(); i++) {
 		uint8_t data = 0;
-		data_len += content[i].size();
-		fuselist += content[i];
-		for (size_t ii = 0; ii < content[i].size(); ii++) {
+		const int len = static_cast<int>(content[i].size());
+		data_len += len;
+		for (int ii = 0; ii < len; ii++) {
 			uint8_t val = (content[i][ii] == '1'?1:0);
 			data |= val << ii;
 		}
-		tmp_buff += data;
+		_rows_data.push_back(data);
+		checksumFuses(data, len);
 	}
-	jed.data.push_back(std::move(tmp_buff));
+	endRow(jed, data_len);
 	jed.len += data_len;
 }
 
@@ -168,10 +202,10 @@ void JedParser::displayHeader()
 
 	for (size_t i = 0; i < _data_list.size(); i++) {
 		printf("area[%zu] %4d %4d ", i, _data_list[i].offset, _data_list[i].len);
-		printf("%zu ", _data_list[i].data.size());
-		for (size_t ii = 0; ii < _data_list[i].data.size(); ii++)
-			for (size_t iii = 0; iii < _data_list[i].data[ii].size(); iii++)
-				printf("%02x", (uint8_t)_data_list[i].data[ii][iii]);
+		const JedSection sec = section(i);
+		printf("%zu ", sec.size());
+		for (size_t ii = 0; ii < sec.data_size(); ii++)
+			printf("%02x", sec.data()[ii]);
 		printf(" %s\n", _data_list[i].associatedPrevNote.c_str());
 		if (_data_list[i].offset == 2656)
 			break;
@@ -206,6 +240,8 @@ void JedParser::parseLField(const std::vector<std::string> &content)
 	 */
 	struct jed_data d;
 	d.offset = start_offset;
+	d.first_row = _row_offsets.size() - 1;
+	d.nb_rows = 0;
 	d.len = 0;
 	if (content.size() > 1) {
 		for (size_t i = 1; i < content.size(); i++) {
@@ -353,18 +389,11 @@ int JedParser::parse()
 		size += _data_list[area].len;
 	}
 
-	std::string fuses;
-	std::copy(fuselist.begin(), fuselist.end(), std::back_inserter(fuses));
-
-	if (fuses.size() % 8) {
-		int diff = (((fuses.size() / 8) + 1) * 8) - fuses.size();
-		for (int i = 0; i < diff; i++)
-			fuses += '0';
-	}
-
-	for (size_t i = 0; i < fuses.size(); i+=8)
-		_compute_checksum += reverseByte(std::stoi(fuses.substr(i, 8),
-				nullptr, 2));
+	/* checksum is updated while parsing: flush last
+	 * (zero padded) fuses
+	 */
+	if (_fuse_acc_len > 0)
+		checksumFuses(0, 8 - _fuse_acc_len);
 
 	if (_verbose)
 		printf("theorical checksum %x -> %x\n", _checksum, _compute_checksum);
@@ -374,7 +403,7 @@ int JedParser::parse()
 	}
 
 	if (_verbose)
-		printf("array size %zd\n", _data_list[0].data.size());
+		printf("array size %zd\n", _data_list.empty() ? 0 : _data_list[0].nb_rows);
 
 	if (_fuse_count != size) {
 		printError("Not all fuses are programmed");
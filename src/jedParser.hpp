@@ -15,11 +15,46 @@
 
 #include "configBitstreamParser.hpp"
 
+/*!
+ * \brief read-only (non owning) view on a JED section: rows of packed fuses
+ *        (first fuse is LSB of first byte) stored contiguously
+ */
+class JedSection {
+	public:
+		JedSection(const uint8_t *data, const size_t *row_offsets,
+				size_t nb_rows):
+			_data(data), _row_offsets(row_offsets), _nb_rows(nb_rows) {}
+
+		/*! \brief number of rows */
+		size_t size() const { return _nb_rows;}
+		bool empty() const { return _nb_rows == 0;}
+		/*! \brief pointer to the first byte of a row */
+		const uint8_t *row(size_t id) const {
+			return _data + _row_offsets[id] - _row_offsets[0];
+		}
+		/*! \brief row length (bytes) */
+		size_t row_size(size_t id) const {
+			return _row_offsets[id + 1] - _row_offsets[id];
+		}
+		/*! \brief all rows, contiguous */
+		const uint8_t *data() const { return _data;}
+		/*! \brief section length (bytes) */
+		size_t data_size() const {
+			return _row_offsets[_nb_rows] - _row_offsets[0];
+		}
+
+	private:
+		const uint8_t *_data;
+		const size_t *_row_offsets;
+		size_t _nb_rows;
+};
+
 class JedParser: public ConfigBitstreamParser {
 	private:
 		struct jed_data {
 			int offset;
-			std::vector<std::string> data;
+			size_t first_row; /* index in _row_offsets */
+			size_t nb_rows;
 			int len;
 			std::string associatedPrevNote;
 		};
@@ -32,10 +67,16 @@ class JedParser: public ConfigBitstreamParser {
 		size_t nb_section() { return _data_list.size();}
 		size_t offset_for_section(int id) {return _data_list[id].offset;}
 		int len_for_section(int id) {return _data_list[id].len;}
-		std::string get_fuselist() {return fuselist;}
+		/*!
+		 * \brief return fuse value, pos is the index in the fuses list
+		 *        (file order)
+		 */
+		uint8_t get_fuse(size_t pos) const;
 		int get_fuse_count() {return _fuse_count;}
-		std::vector<std::string> data_for_section(int id) {
-			return _data_list[id].data;
+		JedSection section(int id) const {
+			const struct jed_data &d = _data_list[id];
+			return JedSection(_rows_data.data() + _row_offsets[d.first_row],
+					&_row_offsets[d.first_row], d.nb_rows);
 		}
 		std::string noteForSection(int id) {return _data_list[id].associatedPrevNote;}
 		uint32_t feabits() {return _feabits;}
@@ -47,10 +88,17 @@ class JedParser: public ConfigBitstreamParser {
 		void buildDataArray(const std::string &content, struct jed_data &jed);
 		void buildDataArray(const std::vector<std::string> &content,
 				struct jed_data &jed);
+		void checksumFuses(uint8_t fuses, int len);
+		void endRow(struct jed_data &jed, size_t nb_fuses);
 		void parseEField(const std::vector<std::string> &content);
 		void parseLField(const std::vector<std::string> &content);
 
 		std::vector<struct jed_data> _data_list;
+		std::vector<uint8_t> _rows_data; /**< all rows, packed */
+		std::vector<size_t> _row_offsets; /**< rows start in _rows_data (+end) */
+		std::vector<size_t> _row_fuses; /**< rows first fuse index (+end) */
+		uint16_t _fuse_acc; /**< fuses not yet added to checksum */
+		int _fuse_acc_len; /**< number of fuses in _fuse_acc */
 		int _fuse_count;
 		int _pin_count;
 		int _max_vect_test;
@@ -66,7 +114,6 @@ class JedParser: public ConfigBitstreamParser {
 		int _default_test_condition;
 		int _arch_code;
 		int _pinout_code;
-		std::string fuselist;
 };
 
 #endif  // JEDPARSER_HPP_
@@ -35,13 +35,83 @@
 // size multiple of 64 Byte but < 0x8000
 #define HAS_0BYTE(_len) ((_len != 0) && (_len % 64 == 0) && (_len != 0x8000))
 
-// buffer capacity
+// buffer capacity (default)
 #define BUF_SIZE 2048
+// EMU_CMD_HW_JTAG3 bit length is a 16 bits value
+#define JTAG3_MAX_BYTES 8191
+// number of EMU_CMD_HW_JTAG3 commands in flight
+#define JLINK_MAX_PENDING 4
+// read transfer: largest answer (tdo + status) rounded up to
+// USB HS packet size, answers are read as a stream
+#define JLINK_RD_BUF_SIZE (JTAG3_MAX_BYTES + 1 + 512)
+#define JLINK_TIMEOUT 1000
+
+/* copy len bits from src (starting at bit src_pos) to dst (starting at
+ * bit dst_pos), LSB first, up to 8 bits by iteration
+ */
+static void copy_bits(uint8_t *dst, uint32_t dst_pos, const uint8_t *src,
+		uint32_t src_pos, uint32_t len)
+{
+	src += src_pos >> 3;
+	src_pos &= 0x07;
+	dst += dst_pos >> 3;
+	dst_pos &= 0x07;
+
+	if (src_pos == 0 && dst_pos == 0) {
+		memcpy(dst, src, len >> 3);
+		if (len & 0x07) {
+			const uint8_t mask = (1 << (len & 0x07)) - 1;
+			dst[len >> 3] = (dst[len >> 3] & ~mask) | (src[len >> 3] & mask);
+		}
+		return;
+	}
+
+	while (len > 0) {
+		uint32_t n = 8 - dst_pos;
+		if (n > len)
+			n = len;
+		uint16_t w = src[0];
+		if (src_pos + n > 8)
+			w |= src[1] << 8;
+		const uint8_t mask = ((1 << n) - 1) << dst_pos;
+		*dst = (*dst & ~mask) | (((w >> src_pos) << dst_pos) & mask);
+		src_pos += n;
+		src += src_pos >> 3;
+		src_pos &= 0x07;
+		dst_pos += n;
+		if (dst_pos == 8) {
+			dst++;
+			dst_pos = 0;
+		}
+		len -= n;
+	}
+}
+
+/* set len bits of dst, starting at bit pos, to val */
+static void fill_bits(uint8_t *dst, uint32_t pos, uint32_t len, bool val)
+{
+	for (; len > 0 && (pos & 0x07); pos++, len--) {
+		if (val)
+			dst[pos >> 3] |= (1 << (pos & 0x07));
+		else
+			dst[pos >> 3] &= ~(1 << (pos & 0x07));
+	}
+	memset(dst + (pos >> 3), (val) ? 0xff : 0x00, len >> 3);
+	pos += len & ~0x07;
+	for (len &= 0x07; len > 0; pos++, len--) {
+		if (val)
+			dst[pos >> 3] |= (1 << (pos & 0x07));
+		else
+			dst[pos >> 3] &= ~(1 << (pos & 0x07));
+	}
+}
 
 Jlink::Jlink(uint32_t clkHz, int8_t verbose, int vid = VID, int pid = PID):_base_freq(0), _min_div(0),
 	jlink_write_ep(-1), jlink_read_ep(-1), jlink_interface(-1),
 	_verbose(verbose > 0), _debug(verbose > 1), _quiet(verbose < 0),
-	_num_bits(0), _last_tms(0), _last_tdi(0),
+	_buf_size(BUF_SIZE), _num_bits(0), _last_tms(0), _last_tdi(0),
+	_xfer_idx(0), _rd_trans(NULL), _rd_busy(false), _rd_tries(0),
+	_xfer_error(false),
 	_hw_type(0), _major(0), _minor(0), _revision(0)
 {
 	// init libusb context
@@ -68,6 +138,39 @@ Jlink::Jlink(uint32_t clkHz, int8_t verbose, int vid = VID, int pid = PID):_base
 	// configure device in JTAG mode
 	set_interface(0);
 
+	// size transfers according to probe memory:
+	// tms, tdi and tdo must fit
+	uint32_t max_mem;
+	if ((_caps & EMU_CAP_GET_MAX_BLOCK_SIZE) && max_mem_block(&max_mem) &&
+			max_mem > 5) {
+		_buf_size = (max_mem - 5) / 3;
+		if (_buf_size > JTAG3_MAX_BYTES)
+			_buf_size = JTAG3_MAX_BYTES;
+		if (_buf_size < 64)
+			_buf_size = 64;
+		if (_verbose)
+			printInfo("max mem block: " + std::to_string(max_mem) +
+				" -> " + std::to_string(_buf_size) + " Bytes by transfer");
+	}
+	_tms.resize(_buf_size, 0);
+	_tdi.resize(_buf_size, 0);
+
+	_xfers.resize(JLINK_MAX_PENDING);
+	for (auto &xfer : _xfers) {
+		xfer.owner = this;
+		xfer.trans = libusb_alloc_transfer(0);
+		xfer.buf.resize(4 + 2 * _buf_size);
+		xfer.numbytes = 0;
+		xfer.tdo = NULL;
+		xfer.pending = 0;
+		if (!xfer.trans)
+			throw std::runtime_error("can't allocate transfers");
+	}
+	_rd_trans = libusb_alloc_transfer(0);
+	if (!_rd_trans)
+		throw std::runtime_error("can't allocate transfers");
+	_rd_buf.resize(JLINK_RD_BUF_SIZE);
+
 	// configure JTAG TCK frequency
 	setClkFreq(clkHz);
 
@@ -78,8 +181,14 @@ Jlink::Jlink(uint32_t clkHz, int8_t verbose, int vid = VID, int pid = PID):_base
 Jlink::~Jlink()
 {
 	// flush buffers before quit
-	if (_num_bits != 0)
-		flush();
+	flush();
+	if (_rd_busy) {
+		libusb_cancel_transfer(_rd_trans);
+		while (_rd_busy && wait_event()) {}
+	}
+	for (auto &xfer : _xfers)
+		libusb_free_transfer(xfer.trans);
+	libusb_free_transfer(_rd_trans);
 	// release interface
 	libusb_release_interface(jlink_handle, jlink_interface);
 	// close device
@@ -96,29 +205,26 @@ int Jlink::writeTMS(const uint8_t *tms, uint32_t len, bool flush_buffer,
 	if (len == 0)
 		return ((flush_buffer) ? flush() : 0);
 
-	for (uint32_t pos = 0; pos < len; pos++) {
+	const uint32_t max_bits = _buf_size * 8;
+	for (uint32_t pos = 0; pos < len;) {
 		// buffer full -> write
-		if (_num_bits == BUF_SIZE * 8) {
-			// write
-			ll_write(NULL);
-			_num_bits = 0;
+		if (_num_bits == max_bits) {
+			if (!ll_write(NULL))
+				return -EXIT_FAILURE;
 		}
 
-		_last_tms = (tms[pos >> 3] & (1 << (pos & 0x07))) ? 1 : 0;
-
-		if (_last_tms)
-			_tms[(_num_bits >> 3)] |= (1 << (_num_bits & 0x07));
-		else
-			_tms[(_num_bits >> 3)] &= ~(1 << (_num_bits & 0x07));
-		if (_last_tdi)
-			_tdi[(_num_bits >> 3)] |= (1 << (_num_bits & 0x07));
-		else
-			_tdi[(_num_bits >> 3)] &= ~(1 << (_num_bits & 0x07));
-		_num_bits++;
+		uint32_t xfer_len = max_bits - _num_bits;
+		if (xfer_len > len - pos)
+			xfer_len = len - pos;
+		copy_bits(_tms.data(), _num_bits, tms, pos, xfer_len);
+		fill_bits(_tdi.data(), _num_bits, xfer_len, _last_tdi);
+		_num_bits += xfer_len;
+		pos += xfer_len;
 	}
+	_last_tms = (tms[(len - 1) >> 3] >> ((len - 1) & 0x07)) & 0x01;
 
 	// flush where it's asked or if the buffer is full
-	if (flush_buffer || _num_bits == BUF_SIZE * 8)
+	if (flush_buffer || _num_bits == max_bits)
 		return flush();
 	return len;
 }
@@ -127,37 +233,47 @@ int Jlink::writeTDI(const uint8_t *tx, uint8_t *rx, uint32_t len, bool end)
 {
 	if (len == 0)  // nothing to do
 		return 0;
-	if (_num_bits != 0)  // flush buffer to simplify next step
-		flush();
+	if (_num_bits != 0 && !ll_write(NULL))  // send buffer to simplify next step
+		return -EXIT_FAILURE;
 
-	uint32_t xfer_len = BUF_SIZE * 8;  // default to buffer capacity
+	uint32_t xfer_len = _buf_size * 8;  // default to buffer capacity
 	uint8_t tms = (_last_tms) ? 0xff : 0x00;  // set tms byte
 	const uint8_t *tx_ptr = tx;
 	uint8_t *rx_ptr = rx;  // use pointer to simplify algo
 
-	/* write by burst */
+	/* write by burst: vectors are directly built in the command */
 	for (uint32_t rest = 0; rest < len; rest += xfer_len) {
 		if ((xfer_len + rest) > len)  // len < buffer size
 			xfer_len = len - rest;  // reduce xfer len
-		uint16_t tt = (xfer_len + 7) >> 3;  // convert to Byte
-		memset(_tms, tms, tt);  // fill tms buffer
+		jlink_xfer_t *xfer = get_xfer(xfer_len);
+		if (!xfer)
+			return -EXIT_FAILURE;
+		uint16_t tt = xfer->numbytes;
+		uint8_t *tms_buf = &xfer->buf[4];
+		uint8_t *tdi_buf = tms_buf + tt;
+		memset(tms_buf, tms, tt);  // fill tms buffer
 		if (tx)
-			memcpy(_tdi, tx_ptr, tt);  // fill tdi buffer
+			memcpy(tdi_buf, tx_ptr, tt);  // fill tdi buffer
 		else
-			memset(_tdi, 0, tt);  // clear tdi buffer
-		_num_bits = xfer_len;  // set buffer size in bit
+			memset(tdi_buf, 0, tt);  // clear tdi buffer
 		if (end && xfer_len + rest == len) {  // last sequence: set tms 1
 			_last_tms = 1;
-			uint16_t idx = _num_bits - 1;
-			_tms[(idx >> 3)] |= (1 << (idx & 0x07));
+			uint16_t idx = xfer_len - 1;
+			tms_buf[(idx >> 3)] |= (1 << (idx & 0x07));
 		}
-		ll_write((rx) ? rx_ptr : NULL);  // write
+		if (!queue_xfer(xfer, (rx) ? rx_ptr : NULL))  // write
+			return -EXIT_FAILURE;
 
-		tx_ptr += tt;
+		if (tx)
+			tx_ptr += tt;
 		if (rx)
 			rx_ptr += tt;
 	}
 
+	// TDO must be available when returning
+	if (rx && !wait_xfers())
+		return -EXIT_FAILURE;
+
 	return len;
 }
 
@@ -167,8 +283,9 @@ int Jlink::toggleClk(uint8_t tms, uint8_t tdi, uint32_t clk_len)
 	// nothing to do
 	if (clk_len == 0)
 		return 0;
-	if (_num_bits != 0)
-		flush();
+	// send buffer before starting
+	if (_num_bits != 0 && !ll_write(NULL))
+		return -EXIT_FAILURE;
 
 	_last_tms = tms;
 	_last_tdi = tdi;
@@ -177,18 +294,18 @@ int Jlink::toggleClk(uint8_t tms, uint8_t tdi, uint32_t clk_len)
 
 	uint32_t len = clk_len;
 
-	// flush buffer before starting
-	if (_num_bits != 0)
-		flush();
-
-	memset(_tdi, curr_tdi, BUF_SIZE);
-	memset(_tms, curr_tms, BUF_SIZE);
 	do {
-		_num_bits = BUF_SIZE * 8;
-		if (len < _num_bits)
-			_num_bits = len;
-		len -= _num_bits;
-		ll_write(NULL);
+		uint32_t xfer_len = _buf_size * 8;
+		if (len < xfer_len)
+			xfer_len = len;
+		jlink_xfer_t *xfer = get_xfer(xfer_len);
+		if (!xfer)
+			return -EXIT_FAILURE;
+		memset(&xfer->buf[4], curr_tms, xfer->numbytes);
+		memset(&xfer->buf[4 + xfer->numbytes], curr_tdi, xfer->numbytes);
+		if (!queue_xfer(xfer, NULL))
+			return -EXIT_FAILURE;
+		len -= xfer_len;
 	} while (len > 0);
 
 	return clk_len;
@@ -196,7 +313,8 @@ int Jlink::toggleClk(uint8_t tms, uint8_t tdi, uint32_t clk_len)
 
 int Jlink::flush()
 {
-	return ll_write(NULL);
+	bool ret = ll_write(NULL);
+	return wait_xfers() && ret;
 }
 
 bool Jlink::writeTMSTDI(const uint8_t *tms, const uint8_t *tdi, uint8_t *tdo,
@@ -209,23 +327,27 @@ bool Jlink::writeTMSTDI(const uint8_t *tms, const uint8_t *tdi, uint8_t *tdo,
 
 	uint32_t xfer_len = 0;
 
+	if (_num_bits != 0 && !ll_write(NULL))
+		return false;
+
 	while (numbits > 0) {
 		// if bits to send are greater than internal buffer
 		// limits to buffer size
-		if (numbits > (BUF_SIZE * 8))
-			xfer_len = BUF_SIZE * 8;
+		if (numbits > (_buf_size * 8))
+			xfer_len = _buf_size * 8;
 		else  // or direct xfer
 			xfer_len = numbits;
+		jlink_xfer_t *xfer = get_xfer(xfer_len);
+		if (!xfer)
+			return false;
 		// convert size in Byte
-		uint16_t numbytes = (xfer_len + 7) >> 8;
+		uint16_t numbytes = xfer->numbytes;
 
-		// copy buffers to internals
-		memcpy(_tms, tms_ptr, numbytes);
-		memcpy(_tdi, tdi_ptr, numbytes);
-		// save size to transmit
-		_num_bits = xfer_len;
+		// copy buffers to command
+		memcpy(&xfer->buf[4], tms_ptr, numbytes);
+		memcpy(&xfer->buf[4 + numbytes], tdi_ptr, numbytes);
 		// send
-		if (!ll_write(tdo_ptr))
+		if (!queue_xfer(xfer, tdo_ptr))
 			return false;
 		// decrement bits to send
 		numbits -= xfer_len;
@@ -236,6 +358,8 @@ bool Jlink::writeTMSTDI(const uint8_t *tms, const uint8_t *tdi, uint8_t *tdo,
 			tdo_ptr += numbytes;
 	}
 
+	if (tdo)
+		return wait_xfers();
 	return true;
 }
 
@@ -243,28 +367,26 @@ bool Jlink::ll_write(uint8_t *tdo)
 {
 	if (_num_bits == 0)
 		return true;
-	uint32_t numbytes = (_num_bits + 7) >> 3;
-	uint8_t rx_buf[numbytes+2];
-	uint8_t status;
-	// 1. cmd + dummy + numbits + tms + tdi
-	_xfer_buf[0] = EMU_CMD_HW_JTAG3;
-	_xfer_buf[1] = 0;  // dummy
-	_xfer_buf[2] = static_cast<uint8_t>((_num_bits >> 0) & 0xff);
-	_xfer_buf[3] = static_cast<uint8_t>((_num_bits >> 8) & 0xff);
-	memcpy(_xfer_buf + 4, _tms, numbytes);
-	memcpy(_xfer_buf + 4 + numbytes, _tdi, numbytes);
+	jlink_xfer_t *xfer = get_xfer(_num_bits);
+	if (!xfer)
+		return false;
+	uint32_t numbytes = xfer->numbytes;
+	uint8_t *xfer_buf = xfer->buf.data();
+	// cmd + dummy + numbits + tms + tdi
+	memcpy(xfer_buf + 4, _tms.data(), numbytes);
+	memcpy(xfer_buf + 4 + numbytes, _tdi.data(), numbytes);
 
 	if (_debug) {
 		printf("Out       : %u\n", numbytes);
-		printf("cmd       : %02x\n", _xfer_buf[0]);
-		printf("dummy     : %02x\n", _xfer_buf[1]);
-		printf("bitlength : %02x %02x (%u)\n", _xfer_buf[2], _xfer_buf[3], _num_bits);
+		printf("cmd       : %02x\n", xfer_buf[0]);
+		printf("dummy     : %02x\n", xfer_buf[1]);
+		printf("bitlength : %02x %02x (%u)\n", xfer_buf[2], xfer_buf[3], _num_bits);
 		printf("tms       : ");
 		if (numbytes > 16) {
 			printf("snip");
 		} else {
 			for (uint32_t i = 0; i < numbytes; i++)
-				printf("%02x ", _xfer_buf[i+4]);
+				printf("%02x ", xfer_buf[i+4]);
 		}
 		printf("\n");
 		printf("tdi       : ");
@@ -272,61 +394,201 @@ bool Jlink::ll_write(uint8_t *tdo)
 			printf("snip");
 		} else {
 			for (uint32_t i = 0; i < numbytes; i++)
-				printf("%02x ", _xfer_buf[i+4+numbytes]);
+				printf("%02x ", xfer_buf[i+4+numbytes]);
 		}
 		printf("\n");
-		printf("buffer    : ");
-		for (uint32_t i = 0; i < 4 + (2 * numbytes); i++)
-			printf("%02x ", _xfer_buf[i]);
-		printf("\n");
 	}
 
-	if (!write_device(_xfer_buf, 4 + (2 * numbytes))) {
-		printError("fails to send buffer");
-		throw std::runtime_error("fails to send buffer");
+	_num_bits = 0;  // clear counter
+
+	if (!queue_xfer(xfer, tdo))
+		return false;
+	if (tdo)
+		return wait_xfers();
+	return true;
+}
+
+Jlink::jlink_xfer_t *Jlink::get_xfer(uint32_t numbits)
+{
+	jlink_xfer_t *xfer = &_xfers[_xfer_idx];
+	// oldest command: wait until sent and answered
+	while (xfer->pending > 0) {
+		if (!wait_event())
+			return NULL;
 	}
+	_xfer_idx = (_xfer_idx + 1) % _xfers.size();
+
+	xfer->numbytes = (numbits + 7) >> 3;
+	xfer->buf[0] = EMU_CMD_HW_JTAG3;
+	xfer->buf[1] = 0;  // dummy
+	xfer->buf[2] = static_cast<uint8_t>((numbits >> 0) & 0xff);
+	xfer->buf[3] = static_cast<uint8_t>((numbits >> 8) & 0xff);
+	return xfer;
+}
 
-	// 2. read tdo + status
-	int ret = read_device(rx_buf, numbytes+1);
+bool Jlink::queue_xfer(jlink_xfer_t *xfer, uint8_t *tdo)
+{
+	xfer->tdo = tdo;
+	libusb_fill_bulk_transfer(xfer->trans, jlink_handle, jlink_write_ep,
+		xfer->buf.data(), 4 + 2 * xfer->numbytes, write_cb, xfer,
+		xfer_timeout());
+	int ret = libusb_submit_transfer(xfer->trans);
 	if (ret < 0) {
-		printError("fails to read tdo");
+		printError("fails to send buffer: " +
+			std::string(libusb_error_name(ret)));
+		throw std::runtime_error("fails to send buffer");
+	}
+	// OUT transfer + answer
+	xfer->pending = 2;
+	_wait_answer.push_back(xfer);
+	submit_read();
+	return true;
+}
+
+bool Jlink::wait_xfers()
+{
+	bool busy;
+	do {
+		busy = !_wait_answer.empty();
+		for (auto &xfer : _xfers)
+			busy |= (xfer.pending > 0);
+		if (busy && !wait_event())
+			break;
+	} while (busy);
+
+	const bool ret = !_xfer_error && !busy;
+	_xfer_error = false;
+	return ret;
+}
+
+bool Jlink::wait_event()
+{
+	struct timeval tv = {1, 0};
+	int ret = libusb_handle_events_timeout_completed(jlink_ctx, &tv, NULL);
+	if (ret < 0 && ret != LIBUSB_ERROR_INTERRUPTED) {
+		printError("libusb events failed: " +
+			std::string(libusb_error_name(ret)));
 		return false;
 	}
+	return true;
+}
 
-	// 3. read status
-	if ((uint32_t)ret == numbytes) {
-		printError("read status");
-		if (!read_device(&status, 1)) {
-			printError("fails to read status\n");
-			return false;
-		}
-	} else {
-		status = rx_buf[numbytes];
+unsigned int Jlink::xfer_timeout()
+{
+	// all queued commands may have to be executed first
+	const uint64_t bits = static_cast<uint64_t>(_xfers.size()) * _buf_size * 8;
+	const uint32_t freq = (_clkHZ > 1000) ? _clkHZ : 1000;
+	return JLINK_TIMEOUT + static_cast<unsigned int>((bits * 1000) / freq);
+}
+
+void Jlink::submit_read()
+{
+	if (_rd_busy || _wait_answer.empty())
+		return;
+	size_t needed = 0;
+	for (auto xfer : _wait_answer)
+		needed += xfer->numbytes + 1;
+	if (_rd_stream.size() >= needed)
+		return;
+
+	libusb_fill_bulk_transfer(_rd_trans, jlink_handle, jlink_read_ep,
+		_rd_buf.data(), _rd_buf.size(), read_cb, this, xfer_timeout());
+	int ret = libusb_submit_transfer(_rd_trans);
+	if (ret < 0) {
+		printError("fails to read tdo: " + std::string(libusb_error_name(ret)));
+		abort_answers();
+		return;
+	}
+	_rd_busy = true;
+}
+
+void LIBUSB_CALL Jlink::write_cb(struct libusb_transfer *transfer)
+{
+	jlink_xfer_t *xfer = static_cast<jlink_xfer_t *>(transfer->user_data);
+	Jlink *self = xfer->owner;
+
+	xfer->pending--;
+	if (transfer->status != LIBUSB_TRANSFER_COMPLETED ||
+			transfer->actual_length != transfer->length) {
+		printError("fails to send buffer");
+		self->abort_answers();
+	}
+}
+
+void LIBUSB_CALL Jlink::read_cb(struct libusb_transfer *transfer)
+{
+	Jlink *self = static_cast<Jlink *>(transfer->user_data);
+	self->_rd_busy = false;
+
+	// answers boundaries are not always aligned with USB transfers
+	// (0-byte after TDO, status alone...): just append to the stream
+	self->_rd_stream.insert(self->_rd_stream.end(), transfer->buffer,
+		transfer->buffer + transfer->actual_length);
+
+	if (transfer->status == LIBUSB_TRANSFER_COMPLETED ||
+			transfer->actual_length > 0) {
+		self->_rd_tries = 3;
+	} else if (transfer->status != LIBUSB_TRANSFER_TIMED_OUT ||
+			--self->_rd_tries <= 0) {
+		printError("fails to read tdo");
+		self->abort_answers();
+		return;
 	}
 
-	if (tdo) {
-		memcpy(tdo, rx_buf, numbytes);
+	self->parse_answers();
+	self->submit_read();
+}
 
-		if (_debug) {
-			printf("tdo       : ");
-			for (uint32_t i = 0; i < numbytes; i+=16) {
-				for (int ii = 0; ii < 16 && ((ii + i) < numbytes); ii++)
-					printf("%02x ", tdo[i+ii]);
-				printf("\n");
+void Jlink::parse_answers()
+{
+	size_t pos = 0;
+	while (!_wait_answer.empty()) {
+		jlink_xfer_t *xfer = _wait_answer.front();
+		const uint32_t numbytes = xfer->numbytes;
+		if (_rd_stream.size() - pos < numbytes + 1)
+			break;
+		const uint8_t *rx_buf = &_rd_stream[pos];
+
+		if (xfer->tdo) {
+			memcpy(xfer->tdo, rx_buf, numbytes);
+
+			if (_debug) {
+				printf("tdo       : ");
+				for (uint32_t i = 0; i < numbytes; i+=16) {
+					for (int ii = 0; ii < 16 && ((ii + i) < numbytes); ii++)
+						printf("%02x ", xfer->tdo[i+ii]);
+					printf("\n");
+				}
 			}
 		}
-	}
-	if (_debug)
-		printf("\n");
+		// status
+		if (rx_buf[numbytes] != 0)
+			_xfer_error = true;
 
-	_num_bits = 0;  // clear counter
+		pos += numbytes + 1;
+		xfer->pending--;
+		_wait_answer.pop_front();
+	}
+	_rd_stream.erase(_rd_stream.begin(), _rd_stream.begin() + pos);
+}
 
-	return status == 0;
+void Jlink::abort_answers()
+{
+	for (auto xfer : _wait_answer)
+		xfer->pending--;
+	_wait_answer.clear();
+	_rd_stream.clear();
+	_xfer_error = true;
+	if (_rd_busy)
+		libusb_cancel_transfer(_rd_trans);
 }
 
 bool Jlink::cmd_read(uint8_t cmd, uint8_t *val, int size)
 {
 	int actual_length;
+	// answers of queued commands come first
+	if (!_wait_answer.empty())
+		wait_xfers();
 	int ret = libusb_bulk_transfer(jlink_handle, jlink_write_ep,
 				&cmd, 1, &actual_length, 5000);
 	if (ret < 0) {
@@ -364,6 +626,8 @@ bool Jlink::cmd_write(uint8_t cmd, uint16_t param)
 	uint8_t tx_buf[3] = {cmd,
 						static_cast<uint8_t>((param >> 0) & 0xff),
 						static_cast<uint8_t>((param >> 8) & 0xff)};
+	if (!_wait_answer.empty())
+		wait_xfers();
 
 	int actual_length;
 	int ret = libusb_bulk_transfer(jlink_handle, jlink_write_ep,
@@ -381,6 +645,8 @@ bool Jlink::cmd_write(uint8_t cmd, uint16_t param)
 bool Jlink::cmd_write(uint8_t cmd, uint8_t param)
 {
 	uint8_t tx_buf[2] = {cmd, param};
+	if (!_wait_answer.empty())
+		wait_xfers();
 
 	int actual_length;
 	int ret = libusb_bulk_transfer(jlink_handle, jlink_write_ep,
@@ -431,6 +697,9 @@ bool Jlink::write_device(const uint8_t *buf, uint32_t size)
 	int rest_size = size, recv = 0;
 	uint8_t *buf_ptr = (uint8_t*)buf;
 
+	if (!_wait_answer.empty())
+		wait_xfers();
+
 	do {
 		int ret = libusb_bulk_transfer(jlink_handle, jlink_write_ep,
 					(uint8_t *)buf_ptr, rest_size, &actual_length,
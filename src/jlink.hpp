@@ -8,6 +8,7 @@
 
 #include <libusb.h>
 
+#include <deque>
 #include <string>
 #include <vector>
 
@@ -85,7 +86,7 @@ class Jlink: public JtagInterface {
 		/*
 		 * unused
 		 */
-		int get_buffer_size() override { return 2048;}
+		int get_buffer_size() override { return _buf_size;}
 		bool isFull() override { return false;}
 
 		// JLINK specifics methods
@@ -150,6 +151,7 @@ class Jlink: public JtagInterface {
 			EMU_CAP_READ_CONFIG    = (1 <<  4),
 			EMU_CAP_WRITE_CONFIG   = (1 <<  5),
 			EMU_CAP_SPEED_INFO     = (1 <<  9),
+			EMU_CAP_GET_MAX_BLOCK_SIZE = (1 << 11),
 			EMU_CAP_GET_HW_INFO    = (1 << 12),
 			EMU_CAP_SELECT_IF      = (1 << 17),
 			EMU_CAP_GET_CPU_CAPS   = (1 << 21)
@@ -193,11 +195,66 @@ class Jlink: public JtagInterface {
 
 		/*!
 		 * \brief lowlevel write: EMU_CMD_HW_JTAGx implementation
+		 *        with _tms/_tdi content. The command is queued: TDO
+		 *        (and status) are only waited when tdo is not null
 		 * \param[out]: tdo: TDO read buffer (may be null)
 		 * \return false when failure
 		 */
 		bool ll_write(uint8_t *tdo);
 
+		/* one EMU_CMD_HW_JTAG3 command and its answer */
+		typedef struct {
+			Jlink *owner;
+			struct libusb_transfer *trans;  /*!< OUT transfer */
+			std::vector<uint8_t> buf;       /*!< cmd + tms + tdi */
+			uint32_t numbytes;              /*!< tms/tdi/tdo size */
+			uint8_t *tdo;                   /*!< TDO destination or NULL */
+			int pending;                    /*!< OUT transfer + answer */
+		} jlink_xfer_t;
+
+		/*!
+		 * \brief return next free command of the ring, filled with
+		 *        EMU_CMD_HW_JTAG3 header for numbits
+		 * \return NULL when an error occurs while waiting
+		 */
+		jlink_xfer_t *get_xfer(uint32_t numbits);
+		/*!
+		 * \brief send a command filled by get_xfer caller
+		 * \param[in] xfer: command
+		 * \param[out] tdo: TDO destination (may be null)
+		 * \return false when failure
+		 */
+		bool queue_xfer(jlink_xfer_t *xfer, uint8_t *tdo);
+		/*!
+		 * \brief wait until all queued commands are answered
+		 * \return false when one of them fails
+		 */
+		bool wait_xfers();
+		/*!
+		 * \brief (re)submit read transfer when answers are expected
+		 */
+		void submit_read();
+		/*!
+		 * \brief dispatch received Bytes to queued commands
+		 */
+		void parse_answers();
+		/*!
+		 * \brief transfer failure: answers will never be received,
+		 *        release all queued commands
+		 */
+		void abort_answers();
+		/*!
+		 * \brief handle libusb events (1s max)
+		 * \return false when libusb fails
+		 */
+		bool wait_event();
+		/*!
+		 * \brief transfer timeout (ms) according to queued bits
+		 */
+		unsigned int xfer_timeout();
+		static void LIBUSB_CALL write_cb(struct libusb_transfer *transfer);
+		static void LIBUSB_CALL read_cb(struct libusb_transfer *transfer);
+
 		/*!
 		 * \brief read size Bytes using read endpoint
 		 * \param[in] cmd: Jlink cmd
@@ -297,17 +354,28 @@ class Jlink: public JtagInterface {
 		bool _debug;   /*!< display debug messages */
 		bool _quiet;   /*!< no messages */
 
-		// buffers for xfer, tdi and tdo
-		// each jlink's buffer have 2K Byte
-		// enough to send full jtag write
-		// buffers must be independent
-		uint8_t _xfer_buf[(2048*2) + 4]; /*!> internal buffer */
-		uint8_t _tms[2048]; /*!< TMS buffer */
-		uint8_t _tdi[2048]; /*!< TDI buffer */
+		// buffers for tms and tdi: size is given by the probe
+		// (max mem block), 2K Byte by default
+		uint8_t _xfer_buf[64]; /*!> buffer for short commands */
+		uint32_t _buf_size; /*!< tms/tdi buffer size (Byte) */
+		std::vector<uint8_t> _tms; /*!< TMS buffer */
+		std::vector<uint8_t> _tdi; /*!< TDI buffer */
 		uint32_t _num_bits; /*!< number of bits stored */
 		uint32_t _last_tms; /*!< last known TMS state */
 		uint32_t _last_tdi; /*!< last known TDI state */
 
+		// commands in flight: answers (tdo + status) are read as a
+		// stream and dispatched in order
+		std::vector<jlink_xfer_t> _xfers; /*!< ring of commands */
+		uint32_t _xfer_idx;        /*!< next command to use */
+		std::deque<jlink_xfer_t *> _wait_answer; /*!< in send order */
+		struct libusb_transfer *_rd_trans; /*!< IN transfer */
+		std::vector<uint8_t> _rd_buf;      /*!< IN transfer buffer */
+		std::vector<uint8_t> _rd_stream;   /*!< received, not dispatched */
+		bool _rd_busy;             /*!< IN transfer submitted */
+		int _rd_tries;             /*!< remaining timeouts */
+		bool _xfer_error;          /*!< transfer or status error */
+
 		uint32_t _caps; /*!< current probe capacity */
 		uint8_t _hw_type;
 		uint8_t _major; /*!< major Jlink probe release number */
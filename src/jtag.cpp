@@ -65,6 +65,13 @@
 
 #define DEBUG 0
 
+/* queued mode: stream is sent when this length (bits) is reached */
+#define JTAG_QUEUE_MAX_LEN (1 << 20)
+/* shiftDR_batch without TDO: above this idle length clock toggles are
+ * more compact as clock commands than as stream bits
+ */
+#define JTAG_BATCH_MAX_STREAM_IDLE 64
+
 #if DEBUG
 #define display(...) \
 	do { if (_verbose) fprintf(stdout, __VA_ARGS__);}while(0)
@@ -106,7 +113,8 @@ Jtag::Jtag(const cable_t &cable, const jtag_pins_conf_t *pin_conf,
 			_tms_buffer_size(128), _num_tms(0),
 			_board_name("nope"), _user_misc_devs(user_misc_devs),
 			device_index(0), _dr_bits_before(0), _dr_bits_after(0),
-			_ir_bits_before(0), _ir_bits_after(0), _curr_tdi(1)
+			_ir_bits_before(0), _ir_bits_after(0), _curr_tdi(1),
+			_tmstdi_support(true), _queue_mode(false), _queue_len(0)
 {
 	switch (cable.type) {
 	case MODE_ANLOGICCABLE:
@@ -235,6 +243,8 @@ Jtag::Jtag(const cable_t &cable, const jtag_pins_conf_t *pin_conf,
 
 Jtag::~Jtag()
 {
+	if (_queue_mode)
+		queue_flush();
 	free(_tms_buffer);
 	delete _jtag;
 }
@@ -402,14 +412,199 @@ int Jtag::flushTMS(bool flush_buffer)
 	if (_num_tms != 0) {
 		display("%s: %d %x\n", __func__, _num_tms, _tms_buffer[0]);
 
-		ret = _jtag->writeTMS(_tms_buffer, _num_tms, flush_buffer, _curr_tdi);
+		if (queue_active()) {
+			queue_op_t op = {QUEUE_OP_TMS, 0, _curr_tdi,
+				static_cast<uint32_t>(_num_tms), 0, NULL};
+			queue_append(op, _tms_buffer, NULL);
+			ret = _num_tms;
+			if (flush_buffer)
+				queue_flush();
+		} else {
+			ret = _jtag->writeTMS(_tms_buffer, _num_tms, flush_buffer, _curr_tdi);
+		}
 
 		/* reset buffer and number of bits */
 		memset(_tms_buffer, 0, _tms_buffer_size);
 		_num_tms = 0;
 	} else if (flush_buffer) {
+		if (_queue_mode)
+			queue_flush();
+		else
+			_jtag->flush();
+	}
+	return ret;
+}
+
+void Jtag::flush()
+{
+	flushTMS();
+	if (_queue_mode)
+		queue_flush();
+	else
 		_jtag->flush();
+}
+
+void Jtag::setQueueMode(bool enable)
+{
+	flush();
+	_queue_mode = enable;
+}
+
+/* OR len bits from src (LSB first) into dst starting at bit pos,
+ * dst bits must be cleared
+ */
+static void insert_bits(uint8_t *dst, size_t pos, const uint8_t *src,
+		uint32_t len)
+{
+	const uint32_t nb_bytes = (len + 7) / 8;
+	const uint8_t shift = pos & 0x07;
+	uint8_t *ptr = dst + (pos >> 3);
+	for (uint32_t i = 0; i < nb_bytes; i++) {
+		uint8_t b = src[i];
+		if (i == nb_bytes - 1 && (len & 0x07))
+			b &= (1 << (len & 0x07)) - 1;
+		if (shift == 0) {
+			ptr[i] = b;
+			continue;
+		}
+		ptr[i] |= b << shift;
+		/* only when bits remain: never past the end of dst */
+		if (b >> (8 - shift))
+			ptr[i + 1] |= b >> (8 - shift);
+	}
+}
+
+/* copy len bits starting at src bit pos to dst (LSB first) */
+static void extract_bits(const uint8_t *src, size_t pos, uint8_t *dst,
+		uint32_t len)
+{
+	const uint32_t nb_bytes = (len + 7) / 8;
+	const uint8_t shift = pos & 0x07;
+	const uint8_t *ptr = src + (pos >> 3);
+	for (uint32_t i = 0; i < nb_bytes; i++) {
+		uint8_t b = ptr[i] >> shift;
+		if (shift != 0 && 8 * i + 8 - shift < len)
+			b |= ptr[i + 1] << (8 - shift);
+		dst[i] = b;
 	}
+	if (len & 0x07)
+		dst[nb_bytes - 1] &= (1 << (len & 0x07)) - 1;
+}
+
+void Jtag::queue_append(queue_op_t op, const uint8_t *tms, const uint8_t *tdi)
+{
+	op.pos = _queue_len;
+	if (op.type == QUEUE_OP_CLK) {
+		/* sent with toggleClk at flush: no bits in the stream, next
+		 * stream segment starts at a byte boundary
+		 */
+		_queue_len = (_queue_len + 7) & ~static_cast<size_t>(0x07);
+	} else {
+		_queue_len += op.len;
+	}
+	const size_t nb_bytes = (_queue_len + 7) / 8;
+	_queue_tms.resize(nb_bytes, 0);
+	_queue_tdi.resize(nb_bytes, 0);
+
+	if (op.type == QUEUE_OP_TMS) {
+		insert_bits(_queue_tms.data(), op.pos, tms, op.len);
+		if (op.tdi) {
+			for (size_t i = op.pos; i < _queue_len; i++)
+				_queue_tdi[i >> 3] |= 1 << (i & 0x07);
+		}
+	} else if (op.type == QUEUE_OP_SHIFT) {
+		if (tdi)
+			insert_bits(_queue_tdi.data(), op.pos, tdi, op.len);
+		if (op.tms && op.len > 0) {
+			const size_t last = _queue_len - 1;
+			_queue_tms[last >> 3] |= 1 << (last & 0x07);
+		}
+	}
+	_queue_ops.push_back(op);
+
+	if (_queue_len >= JTAG_QUEUE_MAX_LEN)
+		queue_flush();
+}
+
+bool Jtag::queue_send(size_t first_op, size_t last_op, size_t start,
+		size_t end)
+{
+	if (end == start)
+		return true;
+
+	/* TDO is read back only when at least one op needs it */
+	bool read = false;
+	for (size_t i = first_op; i < last_op && !read; i++)
+		read = (_queue_ops[i].tdo != NULL);
+	if (read)
+		_queue_tdo.assign((end - start + 7) / 8, 0);
+
+	if (!_jtag->writeTMSTDI(&_queue_tms[start >> 3], &_queue_tdi[start >> 3],
+			(read) ? _queue_tdo.data() : NULL, end - start))
+		return false;
+
+	for (size_t i = first_op; i < last_op && read; i++) {
+		const queue_op_t &op = _queue_ops[i];
+		if (op.type == QUEUE_OP_SHIFT && op.tdo)
+			extract_bits(_queue_tdo.data(), op.pos - start, op.tdo, op.len);
+	}
+	return true;
+}
+
+int Jtag::queue_flush()
+{
+	int ret = 0;
+	size_t first = 0;  // first op of the current stream segment
+	size_t start = 0;  // first bit of the current stream segment
+	bool stream_ok = true;
+
+	/* stream segments are separated by CLK ops */
+	for (size_t i = 0; i <= _queue_ops.size(); i++) {
+		const bool is_end = (i == _queue_ops.size());
+		if (!is_end && _queue_ops[i].type != QUEUE_OP_CLK)
+			continue;
+		const size_t stop = (is_end) ? _queue_len : _queue_ops[i].pos;
+		if (!queue_send(first, i, start, stop)) {
+			stream_ok = false;
+			break;
+		}
+		if (is_end)
+			break;
+		const queue_op_t &op = _queue_ops[i];
+		if (_jtag->toggleClk(op.tms, op.tdi, op.len) < 0)
+			ret = -1;
+		first = i + 1;
+		start = (stop + 7) & ~static_cast<size_t>(0x07);
+	}
+
+	if (!stream_ok) {
+		/* cable without TMS/TDI stream support: replay in direct mode */
+		_tmstdi_support = false;
+		std::vector<uint8_t> buf;
+		for (size_t i = first; i < _queue_ops.size(); i++) {
+			const queue_op_t &op = _queue_ops[i];
+			buf.resize((op.len + 7) / 8);
+			switch (op.type) {
+			case QUEUE_OP_TMS:
+				extract_bits(_queue_tms.data(), op.pos, buf.data(), op.len);
+				_jtag->writeTMS(buf.data(), op.len, false, op.tdi);
+				break;
+			case QUEUE_OP_SHIFT:
+				extract_bits(_queue_tdi.data(), op.pos, buf.data(), op.len);
+				_jtag->writeTDI(buf.data(), op.tdo, op.len, op.tms);
+				break;
+			default:
+				if (_jtag->toggleClk(op.tms, op.tdi, op.len) < 0)
+					ret = -1;
+			}
+		}
+	}
+	_jtag->flush();
+
+	_queue_tms.clear();
+	_queue_tdi.clear();
+	_queue_ops.clear();
+	_queue_len = 0;
 	return ret;
 }
 
@@ -425,7 +620,13 @@ void Jtag::go_test_logic_reset()
 int Jtag::read_write(const uint8_t *tdi, unsigned char *tdo, int len, char last)
 {
 	flushTMS(false);
-	_jtag->writeTDI(tdi, tdo, len, last);
+	if (queue_active()) {
+		queue_op_t op = {QUEUE_OP_SHIFT, static_cast<uint8_t>(last == 1), 0,
+			static_cast<uint32_t>(len), 0, tdo};
+		queue_append(op, NULL, tdi);
+	} else {
+		_jtag->writeTDI(tdi, tdo, len, last);
+	}
 	if (last == 1)
 		_state = (_state == SHIFT_DR) ? EXIT1_DR : EXIT1_IR;
 	return 0;
@@ -435,6 +636,14 @@ void Jtag::toggleClk(int nb, uint8_t tdi)
 {
 	unsigned char c = (TEST_LOGIC_RESET == _state) ? 1 : 0;
 	flushTMS(false);
+	if (queue_active()) {
+		if (nb > 0) {
+			queue_op_t op = {QUEUE_OP_CLK, c, tdi,
+				static_cast<uint32_t>(nb), 0, NULL};
+			queue_append(op, NULL, NULL);
+		}
+		return;
+	}
 	if (_jtag->toggleClk(c, tdi, nb) >= 0)
 		return;
 	throw std::exception();
@@ -475,6 +684,77 @@ int Jtag::shiftDR(const uint8_t *tdi, unsigned char *tdo, int drlen, tapState_t
 	return 0;
 }
 
+/* each scan is:
+ * RTI -> SELECT_DR -> CAPTURE_DR -> SHIFT_DR (bypass + data + bypass)
+ * -> EXIT1_DR -> UPDATE_DR -> RTI (+ idle clocks)
+ * TDO is sampled during data bits.
+ */
+int Jtag::shiftDR_batch(const uint8_t *tdi, uint8_t *tdo, int scan_len,
+		size_t nb_scans, int idle_clk)
+{
+	if ((scan_len % 8) != 0 || scan_len <= 0)
+		return -1;
+	const int scan_bytes = scan_len / 8;
+
+	set_state(RUN_TEST_IDLE);
+
+	if (_tmstdi_support && (tdo || idle_clk <= JTAG_BATCH_MAX_STREAM_IDLE)) {
+		const size_t dr_len = _dr_bits_before + scan_len + _dr_bits_after;
+		const size_t step_len = 3 + dr_len + 2 + idle_clk;
+		const size_t nb_bits = nb_scans * step_len;
+		std::vector<uint8_t> tms_buf((nb_bits + 7) / 8, 0);
+		std::vector<uint8_t> tdi_buf((nb_bits + 7) / 8, 0);
+		std::vector<uint8_t> tdo_buf((tdo) ? (nb_bits + 7) / 8 : 0, 0);
+
+		size_t pos = 0;
+		for (size_t s = 0; s < nb_scans; s++) {
+			tms_buf[pos >> 3] |= 1 << (pos & 0x07);  // SELECT_DR
+			pos += 3;
+			for (size_t i = 0; i < dr_len; i++, pos++) {
+				const size_t b = i - _dr_bits_before;
+				if (tdi && i >= _dr_bits_before && b < (size_t)scan_len &&
+						((tdi[s * scan_bytes + (b >> 3)] >> (b & 0x07)) & 0x01))
+					tdi_buf[pos >> 3] |= 1 << (pos & 0x07);
+				if (i == dr_len - 1)  // EXIT1_DR
+					tms_buf[pos >> 3] |= 1 << (pos & 0x07);
+			}
+			tms_buf[pos >> 3] |= 1 << (pos & 0x07);  // UPDATE_DR
+			pos += 2 + idle_clk;
+		}
+
+		/* pending TMS must precede the stream, no need to
+		 * flush the cable buffer (except queued operations) */
+		flushTMS(_queue_mode);
+		/* no TDO requested: write only (buffered) stream */
+		if (_jtag->writeTMSTDI(tms_buf.data(), tdi_buf.data(),
+				(tdo) ? tdo_buf.data() : NULL, nb_bits)) {
+			if (tdo) {
+				memset(tdo, 0, nb_scans * scan_bytes);
+				pos = 3 + _dr_bits_before;
+				for (size_t s = 0; s < nb_scans; s++, pos += step_len) {
+					uint8_t *d = tdo + s * scan_bytes;
+					for (int b = 0; b < scan_len; b++) {
+						const size_t p = pos + b;
+						if ((tdo_buf[p >> 3] >> (p & 0x07)) & 0x01)
+							d[b >> 3] |= 1 << (b & 0x07);
+					}
+				}
+			}
+			return 0;
+		}
+		/* cable without TMS/TDI stream support: scan by scan */
+		_tmstdi_support = false;
+	}
+
+	for (size_t s = 0; s < nb_scans; s++) {
+		shiftDR((tdi) ? tdi + s * scan_bytes : NULL,
+			(tdo) ? tdo + s * scan_bytes : NULL, scan_len, RUN_TEST_IDLE);
+		if (idle_clk)
+			toggleClk(idle_clk);
+	}
+	return 0;
+}
+
 int Jtag::shiftIR(unsigned char tdi, int irlen, tapState_t end_state)
 {
 	if (irlen > 8) {
@@ -484,7 +764,7 @@ int Jtag::shiftIR(unsigned char tdi, int irlen, tapState_t end_state)
 	return shiftIR(&tdi, NULL, irlen, end_state);
 }
 
-int Jtag::shiftIR(unsigned char *tdi, unsigned char *tdo, int irlen, tapState_t end_state)
+int Jtag::shiftIR(const uint8_t *tdi, unsigned char *tdo, int irlen, tapState_t end_state)
 {
 	display("%s: avant shiftIR\n", __func__);
 
@@ -29,7 +29,11 @@ class Jtag {
 	~Jtag();
 
 	/* maybe to update */
-	int setClkFreq(uint32_t clkHZ) { return _jtag->setClkFreq(clkHZ);}
+	int setClkFreq(uint32_t clkHZ) {
+		if (_queue_mode)
+			flush();
+		return _jtag->setClkFreq(clkHZ);
+	}
 	uint32_t getClkFreq() { return _jtag->getClkFreq();}
 
 	/*!
@@ -125,19 +129,45 @@ class Jtag {
 		UNKNOWN = 16,
 	};
 
-	int shiftIR(unsigned char *tdi, unsigned char *tdo, int irlen,
+	int shiftIR(const uint8_t *tdi, unsigned char *tdo, int irlen,
 		tapState_t end_state = RUN_TEST_IDLE);
 	int shiftIR(unsigned char tdi, int irlen,
 		tapState_t end_state = RUN_TEST_IDLE);
 	int shiftDR(const uint8_t *tdi, unsigned char *tdo, int drlen,
 		tapState_t end_state = RUN_TEST_IDLE);
 	int read_write(const uint8_t *tdi, unsigned char *tdo, int len, char last);
+	/*!
+	 * \brief shift nb_scans DR scans, each one starting and ending in
+	 *        RUN_TEST_IDLE and followed by idle_clk clock cycles.
+	 *        When the cable supports it, the full sequence is sent as one
+	 *        TMS/TDI stream, otherwise (or for a write only sequence with
+	 *        long idle_clk) shiftDR/toggleClk are used for each scan
+	 * \param[in] tdi: scans content, scan_len / 8 Bytes per scan (may be NULL)
+	 * \param[out] tdo: captured content, same layout (may be NULL)
+	 * \param[in] scan_len: scan length (bits, multiple of 8)
+	 * \param[in] nb_scans: number of DR scans
+	 * \param[in] idle_clk: clock cycles in RUN_TEST_IDLE after each scan
+	 * \return 0 on success, -1 otherwise
+	 */
+	int shiftDR_batch(const uint8_t *tdi, uint8_t *tdo, int scan_len,
+		size_t nb_scans, int idle_clk = 0);
 
 	void toggleClk(int nb, uint8_t tdi = 0);
 	void go_test_logic_reset();
 	void set_state(tapState_t newState, const uint8_t tdi = 1);
 	int flushTMS(bool flush_buffer = false);
-	void flush() {flushTMS(); _jtag->flush();}
+	void flush();
+	/*!
+	 * \brief enable/disable queued mode: TMS moves, shifts and clock
+	 *        toggles are accumulated and sent as one TMS/TDI stream
+	 *        at flush (or when the queue is full). In this mode tdo
+	 *        buffers given to shiftIR/shiftDR are filled by flush and
+	 *        must stay valid until then. Cables without TMS/TDI stream
+	 *        support silently stay in direct mode
+	 * \param[in] enable: true to queue, false to flush and go back
+	 *            to direct mode
+	 */
+	void setQueueMode(bool enable);
 	void setTMS(unsigned char tms);
 
 	const char *getStateName(tapState_t s);
@@ -156,6 +186,41 @@ class Jtag {
 	 * \return false if not found, true otherwise
 	 */
 	bool search_and_insert_device_with_idcode(uint32_t idcode);
+
+	/* queued mode */
+	enum queue_op_type_t {
+		QUEUE_OP_TMS = 0,    /**< TMS sequence, constant TDI */
+		QUEUE_OP_SHIFT = 1,  /**< TDI sequence, TMS high with last bit */
+		QUEUE_OP_CLK = 2,    /**< clock toggle count, sent with toggleClk */
+	};
+	typedef struct {
+		uint8_t type;   /**< queue_op_type_t */
+		uint8_t tms;    /**< CLK: TMS level, SHIFT: TMS high with last bit */
+		uint8_t tdi;    /**< TMS/CLK: TDI level */
+		uint32_t len;   /**< length (bits), CLK: number of clocks */
+		size_t pos;     /**< first bit in the stream (CLK: segment end) */
+		uint8_t *tdo;   /**< SHIFT: TDO destination (may be NULL) */
+	} queue_op_t;
+	bool queue_active() const { return _queue_mode && _tmstdi_support;}
+	/*!
+	 * \brief append op to the stream. tms (TMS op) and tdi (SHIFT op)
+	 *        are op.len bits long, tdi may be NULL (zeros)
+	 */
+	void queue_append(queue_op_t op, const uint8_t *tms, const uint8_t *tdi);
+	/*!
+	 * \brief send stream bits [start, end) of ops [first_op, last_op),
+	 *        TDO is requested only when one of these ops has a tdo buffer
+	 * \return false when the cable refuses the stream
+	 */
+	bool queue_send(size_t first_op, size_t last_op, size_t start,
+		size_t end);
+	/*!
+	 * \brief send the stream (one segment between CLK ops) and
+	 *        dispatch TDO, when the cable refuses the stream each
+	 *        op is replayed in direct mode
+	 */
+	int queue_flush();
+
 	bool _verbose;
 	tapState_t _state;
 	int _tms_buffer_size;
@@ -178,5 +243,12 @@ class Jtag {
 	std::vector<uint32_t> _devices_list; /*!< ordered list of devices idcode */
 	std::vector<int16_t> _irlength_list; /*!< ordered list of irlength */
 	uint8_t _curr_tdi;
+	bool _tmstdi_support; /*!< cable supports writeTMSTDI */
+	bool _queue_mode;     /*!< queued mode requested */
+	size_t _queue_len;    /*!< queued stream length (bits) */
+	std::vector<uint8_t> _queue_tms;
+	std::vector<uint8_t> _queue_tdi;
+	std::vector<uint8_t> _queue_tdo;
+	std::vector<queue_op_t> _queue_ops;
 };
 #endif  // SRC_JTAG_HPP_
@@ -69,7 +69,7 @@ class JtagInterface {
 	 * \brief send TMD and TDI and receive tdo bits;
 	 * \param tms: array of TMS values (used to write)
 	 * \param tdi: array of TDI values (used to write)
-	 * \param tdo: array of TDO values (used when read)
+	 * \param tdo: array of TDO values (used when read), may be NULL
 	 * \param len: number of bit to send/receive
 	 * \return true with full buffers are sent, false otherwise
 	 */
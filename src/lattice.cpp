@@ -12,6 +12,7 @@
 #include <string.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <iomanip>
 #include <iostream>
 #include <list>
@@ -636,13 +637,36 @@ bool Lattice::program_mem()
 	return true;
 }
 
+/* rows are programmed/read by 16 Bytes (128 fuses): a JEDEC section with
+ * rows of another length is copied in buf as 16 Bytes rows (zero padded)
+ */
+static const uint8_t *jed_rows_16(const JedSection &sec,
+		std::vector<uint8_t> &buf)
+{
+	bool aligned = true;
+	for (size_t r = 0; r < sec.size() && aligned; r++)
+		aligned = (sec.row_size(r) == 16);
+	if (aligned)
+		return sec.data();
+
+	buf.assign(sec.size() * 16, 0);
+	for (size_t r = 0; r < sec.size(); r++)
+		memcpy(&buf[r * 16], sec.row(r), std::min(sec.row_size(r),
+			static_cast<size_t>(16)));
+	return buf.data();
+}
+
 bool Lattice::program_intFlash(ConfigBitstreamParser *_cbp)
 {
 	uint64_t featuresRow;
 	uint16_t ufm_start = 0;
 	uint16_t feabits;
 	uint8_t eraseMode = 0;
-	std::vector<std::string> ufm_data, cfg_data, ebr_data;
+	/* 16 Bytes rows, stored contiguously */
+	const uint8_t *ufm_data = nullptr, *cfg_data = nullptr, *ebr_data = nullptr;
+	size_t ufm_rows = 0, cfg_rows = 0, ebr_rows = 0;
+	size_t cfg_fuse_offset = 0;  /* first cfg fuse index in JEDEC file */
+	std::vector<uint8_t> ufm_buf, cfg_buf, ebr_buf;  /* non 16 Bytes rows */
 
 	/* bypass */
 	wr_rd(0xff, NULL, 0, NULL, 0);
@@ -663,9 +687,13 @@ bool Lattice::program_intFlash(ConfigBitstreamParser *_cbp)
 		JedParser *_jed = reinterpret_cast<JedParser *>(_cbp);
 		for (size_t i = 0; i < _jed->nb_section(); i++) {
 			std::string note = _jed->noteForSection(i);
+			if (note == "END CONFIG DATA")
+				continue;
+			const JedSection sec = _jed->section(i);
 			if (note == "TAG DATA") {
 				eraseMode |= FLASH_ERASE_UFM;
-				ufm_data = _jed->data_for_section(i);
+				ufm_data = jed_rows_16(sec, ufm_buf);
+				ufm_rows = sec.size();
 				ufm_start = getUFMStartPageFromJEDEC(_jed, i);
 
 				if (_verbose)
@@ -676,12 +704,13 @@ bool Lattice::program_intFlash(ConfigBitstreamParser *_cbp)
 						"calculated flash start address was out of bounds");
 					return false;
 				}
-			} else if (note == "END CONFIG DATA") {
-				continue;
 			} else if (note == "EBR_INIT DATA") {
-				ebr_data = _jed->data_for_section(i);
+				ebr_data = jed_rows_16(sec, ebr_buf);
+				ebr_rows = sec.size();
 			} else {
-				cfg_data = _jed->data_for_section(i);
+				cfg_data = jed_rows_16(sec, cfg_buf);
+				cfg_rows = sec.size();
+				cfg_fuse_offset = _jed->offset_for_section(i);
 			}
 		}
 
@@ -690,7 +719,8 @@ bool Lattice::program_intFlash(ConfigBitstreamParser *_cbp)
 		feabits = _jed->feabits();
 	} else {  // bit file: adapts
 		LatticeBitParser *_bit = reinterpret_cast<LatticeBitParser *>(_cbp);
-		cfg_data = _bit->getDataArray();
+		cfg_data = _bit->getDataArray().data();
+		cfg_rows = _bit->getDataArray().size() / 16;
 		featuresRow = 0;
 		feabits = 0x460;
 	}
@@ -714,17 +744,17 @@ bool Lattice::program_intFlash(ConfigBitstreamParser *_cbp)
 	_jtag->toggleClk(1000);
 
 	/* flash CfgFlash */
-	if (false == flashProg(0, "data", cfg_data))
+	if (false == flashProg(0, "data", cfg_data, cfg_rows))
 		return false;
 
 	/* flash EBR Init */
-	if (ebr_data.size()) {
-		if (false == flashProg(0, "EBR", ebr_data))
+	if (ebr_rows) {
+		if (false == flashProg(0, "EBR", ebr_data, ebr_rows))
 			return false;
 	}
 	/* verify write */
 	if (_verify) {
-		if (Verify(cfg_data) == false)
+		if (Verify(cfg_data, cfg_rows, false, 0, cfg_fuse_offset) == false)
 			return false;
 	}
 
@@ -742,7 +772,7 @@ bool Lattice::program_intFlash(ConfigBitstreamParser *_cbp)
 		_jtag->toggleClk(1000);
 
 		/* Same command to program CFG flash works for UFM. */
-		if (false == flashProg(0, "UFM", ufm_data))
+		if (false == flashProg(0, "UFM", ufm_data, ufm_rows))
 			return false;
 	}
 
@@ -1257,7 +1287,7 @@ uint64_t Lattice::readStatusReg()
 }
 
 bool Lattice::wr_rd(uint8_t cmd,
-					uint8_t *tx, int tx_len,
+					const uint8_t *tx, int tx_len,
 					uint8_t *rx, int rx_len,
 					bool verbose)
 {
@@ -1585,15 +1615,39 @@ bool Lattice::flashErase(uint32_t  mask)
 	return true;
 }
 
-bool Lattice::flashProg(uint32_t start_addr, const std::string &name, std::vector<std::string> data)
+/* MachXO2/XO3 page program time is 200us (tPROG): 2x margin */
+#define MACHXO2_ROW_PROG_US			400
+/* number of rows queued before checking busy flag */
+#define MACHXO2_ROW_BATCH			128
+
+bool Lattice::flashProg(uint32_t start_addr, const std::string &name,
+		const uint8_t *data, size_t nb_rows)
 {
 	(void)start_addr;
-	ProgressBar progress("Writing " + name, data.size(), 50, _quiet);
-	for (uint32_t line = 0; line < data.size(); line++) {
-		wr_rd(PROG_CFG_FLASH, (uint8_t *)data[line].c_str(),
-				16, NULL, 0);
+	/* MachXO2/XO3 tolerate a fixed programming delay: rows are queued
+	 * with idle clocks computed from TCK frequency and busy flag
+	 * is only read every MACHXO2_ROW_BATCH rows.
+	 * Others families poll busy flag after each row.
+	 */
+	const bool fixed_delay = (_fpga_family == MACHXO2_FAMILY ||
+			_fpga_family == MACHXO3_FAMILY);
+	const uint32_t clk_period = 1e9/static_cast<float>(_jtag->getClkFreq());
+	uint32_t delay_clk = (MACHXO2_ROW_PROG_US * 1000) / clk_period;
+	if (delay_clk < 1000)
+		delay_clk = 1000;
+
+	ProgressBar progress("Writing " + name, nb_rows, 50, _quiet);
+	for (uint32_t line = 0; line < nb_rows; line++) {
+		wr_rd(PROG_CFG_FLASH, data + line * 16, 16, NULL, 0);
 		_jtag->set_state(Jtag::RUN_TEST_IDLE);
-		_jtag->toggleClk(1000);
+		if (fixed_delay) {
+			_jtag->toggleClk(delay_clk);
+			if (((line + 1) % MACHXO2_ROW_BATCH) != 0 &&
+					line + 1 != nb_rows)
+				continue;
+		} else {
+			_jtag->toggleClk(1000);
+		}
 		progress.display(line);
 		if (pollBusyFlag() == false)
 			return false;
@@ -1602,9 +1656,15 @@ bool Lattice::flashProg(uint32_t start_addr, const std::string &name, std::vecto
 	return true;
 }
 
-bool Lattice::Verify(std::vector<std::string> data, bool unlock, uint32_t flash_area)
+/* number of rows read before comparing them with reference */
+#define VERIFY_ROW_BATCH			256
+/* max number of mismatch rows displayed */
+#define VERIFY_MAX_ERR_DISP			16
+
+bool Lattice::Verify(const uint8_t *data, size_t nb_rows, bool unlock,
+		uint32_t flash_area, size_t fuse_offset)
 {
-	uint8_t tx_buf[16], rx_buf[16];
+	uint8_t tx_buf[16];
 	if (unlock)
 		EnableISC(0x08);
 
@@ -1624,35 +1684,63 @@ bool Lattice::Verify(std::vector<std::string> data, bool unlock, uint32_t flash_
 	tx_buf[0] = REG_CFG_FLASH;
 	_jtag->shiftIR(tx_buf, NULL, 8, Jtag::PAUSE_IR);
 
-	memset(tx_buf, 0, 16);
-	bool failure = false;
-	ProgressBar progress("Verifying", data.size(), 50, _quiet);
-	for (size_t line = 0;  line< data.size(); line++) {
-		_jtag->set_state(Jtag::RUN_TEST_IDLE);
-		_jtag->toggleClk(2);
-		_jtag->shiftDR(tx_buf, rx_buf, 16*8, Jtag::PAUSE_DR);
-		for (size_t i = 0; i < data[line].size(); i++) {
-			if (rx_buf[i] != (unsigned char)data[line][i]) {
-				printf("%3zu %3zu %02x -> %02x\n", line, i,
-						rx_buf[i], (unsigned char)data[line][i]);
-				failure = true;
+	/* LSC_READ_INCR_NV: page address is incremented between two DR scans
+	 * (update DR + 2 idle clocks) so one scan per row is required.
+	 * A batch of rows is read with one TMS/TDI stream (when the cable
+	 * supports it) and compared once captured: with MPSSE the answers
+	 * are read back once per cable buffer (~25 rows), not per row.
+	 */
+	std::vector<uint8_t> rx_rows(VERIFY_ROW_BATCH * 16);
+	uint32_t nb_err = 0;
+	ProgressBar progress("Verifying", nb_rows, 50, _quiet);
+	for (size_t base = 0; base < nb_rows; base += VERIFY_ROW_BATCH) {
+		const size_t batch_len = std::min(nb_rows - base,
+				static_cast<size_t>(VERIFY_ROW_BATCH));
+		/* first row needs idle clocks before, the next ones are
+		 * preceded by the idle clocks following the previous scan
+		 */
+		if (base == 0) {
+			_jtag->set_state(Jtag::RUN_TEST_IDLE);
+			_jtag->toggleClk(2);
+		}
+		if (_jtag->shiftDR_batch(NULL, rx_rows.data(), 16 * 8, batch_len,
+				2) != 0) {
+			printError("Verify: fails to read rows");
+			nb_err = 1;
+			break;
+		}
+
+		for (size_t r = 0; r < batch_len; r++) {
+			const uint8_t *row = data + (base + r) * 16;
+			const uint8_t *rd = &rx_rows[r * 16];
+			if (memcmp(row, rd, 16) == 0)
+				continue;
+			nb_err++;
+			if (nb_err > VERIFY_MAX_ERR_DISP)
+				continue;
+			for (size_t i = 0; i < 16; i++) {
+				if (rd[i] != row[i]) {
+					printf("row %zu (fuse %zu): byte %zu %02x -> %02x\n",
+						base + r, fuse_offset + (base + r) * 128 + i * 8,
+						i, rd[i], row[i]);
+				}
 			}
 		}
-		if (failure) {
-			printf("Verify Failure\n");
+		if (nb_err != 0) {
+			printf("Verify Failure: %u row(s) mismatch\n", nb_err);
 			break;
 		}
-		progress.display(line);
+		progress.display(base + batch_len - 1);
 	}
 	if (unlock)
 		DisableISC();
 
-	if (failure)
+	if (nb_err != 0)
 		progress.fail();
 	else
 		progress.done();
 
-	return !failure;
+	return nb_err == 0;
 }
 
 uint64_t Lattice::readFeaturesRow()
@@ -2224,7 +2312,6 @@ bool Lattice::program_fea_MachXO3D()
 bool Lattice::program_intFlash_MachXO3D(JedParser& _jed)
 {
 	uint32_t erase_op = 0, prog_op = 0;
-	std::vector<std::string> data;
 	int offset, fuse_count;
 
 	/* bypass */
@@ -2241,15 +2328,17 @@ bool Lattice::program_intFlash_MachXO3D(JedParser& _jed)
 
 	/* this is the size of an CFGx+UFMx area in bits (hence the / 128) */
 	fuse_count = _jed.get_fuse_count() / 128;
+	std::vector<uint8_t> rows_buf;  /* sections with non 16 Bytes rows */
 
 	for (size_t i = 0; i < _jed.nb_section(); i++) {
 		std::string area_name;
 
-		data = _jed.data_for_section(i);
-		if (data.size() < 1) {
+		const JedSection data = _jed.section(i);
+		if (data.empty()) {
 			/* if no data, nothing to do */
 			continue;
 		}
+		const uint8_t *rows = jed_rows_16(data, rows_buf);
 		std::string note = _jed.noteForSection(i);
 		offset = _jed.offset_for_section(i) / 128;
 
@@ -2405,12 +2494,13 @@ bool Lattice::program_intFlash_MachXO3D(JedParser& _jed)
 		_jtag->toggleClk(1000);
 
 		/* flash CfgFlash */
-		if (false == flashProg(0, area_name, data))
+		if (false == flashProg(0, area_name, rows, data.size()))
 			return false;
 
 		/* verify write */
 		if (_verify) {
-			if (Verify(data, false, prog_op) == false)
+			if (Verify(rows, data.size(), false, prog_op,
+					_jed.offset_for_section(i)) == false)
 				return false;
 		}
 	}
@@ -31,8 +31,8 @@ class Lattice: public Device, FlashInterface {
 		void program(unsigned int offset, bool unprotect_flash) override;
 		bool program_mem();
 		bool program_flash(unsigned int offset, bool unprotect_flash);
-		bool Verify(std::vector<std::string> data, bool unlock = false,
-				uint32_t flash_area = 0);
+		bool Verify(const uint8_t *data, size_t nb_rows, bool unlock = false,
+				uint32_t flash_area = 0, size_t fuse_offset = 0);
 		bool dumpFlash(uint32_t base_addr, uint32_t len) override {
 			return FlashInterface::dump(base_addr, len);
 		}
@@ -95,7 +95,7 @@ class Lattice: public Device, FlashInterface {
 
 		bool program_intFlash(ConfigBitstreamParser *_cbp);
 		bool program_extFlash(unsigned int offset, bool unprotect_flash);
-		bool wr_rd(uint8_t cmd, uint8_t *tx, int tx_len,
+		bool wr_rd(uint8_t cmd, const uint8_t *tx, int tx_len,
 				uint8_t *rx, int rx_len, bool verbose = false);
 		/*!
 		 * \brief move device to SPI access
@@ -120,7 +120,7 @@ class Lattice: public Device, FlashInterface {
 		bool flashEraseAll();
 		bool flashErase(uint32_t mask);
 		bool flashProg(uint32_t start_addr, const std::string &name,
-				std::vector<std::string> data);
+				const uint8_t *data, size_t nb_rows);
 		bool checkStatus(uint64_t val, uint64_t mask);
 		void displayReadReg(uint64_t dev);
 		uint64_t readStatusReg();
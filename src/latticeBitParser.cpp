@@ -207,16 +207,12 @@ int LatticeBitParser::parse()
 		_endHeader++;
 		const size_t len = _raw_data.size() - _endHeader;
 		const size_t array_len = (len + 15) / 16;
-		_bit_array.reserve(array_len);
-		for (size_t i = 0; i < len; i += 16) {
-			const size_t max_len = std::min<size_t>(16, len - i);
-			_bit_array.emplace_back(16, '\xff');
-			std::string &tmp = _bit_array.back();
-			for (uint32_t pos = 0; pos < max_len; pos++)
-				tmp[pos] = static_cast<char>(reverseByte(
-					static_cast<uint8_t>(_raw_data[_endHeader + i + pos])));
-		}
-		_bit_length = _bit_array.size() * 16 * 8;
+		/* rows are stored contiguously, last one padded with 0xff */
+		_bit_array.assign(array_len * 16, 0xff);
+		for (size_t i = 0; i < len; i++)
+			_bit_array[i] = reverseByte(
+				static_cast<uint8_t>(_raw_data[_endHeader + i]));
+		_bit_length = _bit_array.size() * 8;
 	}
 
 	return 0;
@@ -22,9 +22,9 @@ class LatticeBitParser: public ConfigBitstreamParser {
 
 		/*!
 		 * \brief return configuration data with structure similar to jedec
-		 * \return configuration data
+		 * \return configuration data: 16 Bytes rows, stored contiguously
 		 */
-		std::vector<std::string> &getDataArray() {return _bit_array;}
+		const std::vector<uint8_t> &getDataArray() const {return _bit_array;}
 
 	private:
 		int parseHeader();
@@ -39,7 +39,7 @@ class LatticeBitParser: public ConfigBitstreamParser {
 		bool _is_machXO2;
 		bool _is_ecp3;
 		/* data storage for machXO2 */
-		std::vector<std::string> _bit_array;
+		std::vector<uint8_t> _bit_array;
 };
 
 #endif  // SRC_LATTICEBITPARSER_HPP_
@@ -347,7 +347,8 @@ int LibgpiodJtagBitbang::toggleClk(uint8_t tms, uint8_t tdi, uint32_t clk_len)
 bool LibgpiodJtagBitbang::writeTMSTDI(const uint8_t *tms, const uint8_t *tdi, uint8_t *tdo,
 				      uint32_t len)
 {
-	memset(tdo, 0, (len+7) / 8);
+	if (tdo)
+		memset(tdo, 0, (len+7) / 8);
 
 	for (uint32_t i = 0; i < len; i++) {
 #ifdef GPIOD_APIV2
@@ -361,7 +362,7 @@ bool LibgpiodJtagBitbang::writeTMSTDI(const uint8_t *tms, const uint8_t *tdi, ui
 		update_pins(0, tmsx, tdix);
 		update_pins(1, tmsx, tdix);
 #endif
-		if (read_tdo() > 0)
+		if (tdo && read_tdo() > 0)
 			tdo[i >> 3] |= 1 << (i & 7);
 	}
 
@@ -65,6 +65,10 @@
 #endif
 #ifdef ENABLE_SVF_JTAG
 #include "svf_jtag.hpp"
+#include "xsvf_jtag.hpp"
+#endif
+#ifdef ENABLE_REMOTEBITBANG
+#include "remoteBitbang_server.hpp"
 #endif
 #ifdef ENABLE_XVC_SERVER
 #include "xvc_server.hpp"
@@ -123,6 +127,7 @@ struct arguments {
 	bool skip_reset;
 	/* xvc server */
 	bool xvc;
+	bool remote_bitbang_server;
 	int port;
 	std::string interface;
 	std::string mcufw;
@@ -132,10 +137,13 @@ struct arguments {
 	bool read_xadc;
 	std::string read_register;
 	std::string user_flash;
+	bool svf_cache;
 };
 
 int run_xvc_server(const struct arguments &args, const cable_t &cable,
 	const jtag_pins_conf_t *pins_config);
+int run_remote_bitbang_server(const struct arguments &args,
+	const cable_t &cable, const jtag_pins_conf_t *pins_config);
 
 #ifdef USE_LIBFTDI
 int spi_comm(struct arguments args, const cable_t &cable,
@@ -168,11 +176,12 @@ int main(int argc, char **argv)
 			/* vid, pid, index bus_addr, device_addr */
 				0,   0,   -1,     0,         0,
 			"127.0.0.1", 0, false, false, false, false, "", false, false,
-			/* xvc server */
-			false, 3721, "-",
+			/* xvc server, remote bitbang server */
+			false, false, 3721, "-",
 			"", false, {},  // mcufw conmcu, user_misc_dev_list
 			false, false, "", // read_dna, read_xadc, read_register
-			"" // user_flash
+			"", // user_flash
+			false, // svf_cache
 	};
 	/* parse arguments */
 	int ret = parse_opt(argc, argv, &args, &pins_config);
@@ -385,6 +394,14 @@ int main(int argc, char **argv)
 	}
 #endif
 
+#ifdef ENABLE_REMOTEBITBANG
+	/* ---------------------- */
+	/* remote bitbang server  */
+	/* ---------------------- */
+	if (args.remote_bitbang_server)
+		return run_remote_bitbang_server(args, cable, &pins_config);
+#endif
+
 	/* ------------------------------ */
 	/* USB-Blaster passive serial mode */
 	/* ------------------------------ */
@@ -508,12 +525,31 @@ int main(int argc, char **argv)
 
 	jtag->device_select(index);
 
+	/* detect xsvf file and program the device */
+	if (!args.file_type.compare("xsvf") ||
+			args.bit_file.find(".xsvf") != std::string::npos) {
+#ifdef ENABLE_SVF_JTAG
+		XSVF_jtag *xsvf = new XSVF_jtag(jtag, args.verbose);
+		try {
+			xsvf->parse(args.bit_file);
+		} catch (std::exception &e) {
+			return EXIT_FAILURE;
+		}
+		return EXIT_SUCCESS;
+#else
+		printError("Support for XSVF Jtag was not enabled at compile time");
+		delete(jtag);
+		return EXIT_FAILURE;
+#endif
+	}
+
 	/* detect svf file and program the device */
 	if (!args.file_type.compare("svf") ||
 			args.bit_file.find(".svf") != std::string::npos) {
 #ifdef ENABLE_SVF_JTAG
 		SVF_jtag *svf = new SVF_jtag(jtag, args.verbose);
 		try {
+			svf->setCache(args.svf_cache);
 			svf->parse(args.bit_file);
 		} catch (std::exception &e) {
 			return EXIT_FAILURE;
@@ -720,6 +756,28 @@ int run_xvc_server(const struct arguments &args, const cable_t &cable,
 }
 #endif
 
+#ifdef ENABLE_REMOTEBITBANG
+int run_remote_bitbang_server(const struct arguments &args,
+	const cable_t &cable, const jtag_pins_conf_t *pins_config)
+{
+	try {
+		RemoteBitbang_server server(args.port, cable, pins_config,
+				args.device, args.usb_serial_num, args.freq, args.verbose,
+				args.ip_adr, args.invert_read_edge, args.probe_firmware,
+				args.user_misc_devs);
+		if (!server.open_connection())
+			return EXIT_FAILURE;
+		server.listen_loop();
+	} catch (std::exception &e) {
+		printError("Remote bitbang server failed with " +
+				std::string(e.what()));
+		return EXIT_FAILURE;
+	}
+	printInfo("Remote bitbang server stopped");
+	return EXIT_SUCCESS;
+}
+#endif
+
 #ifdef USE_LIBFTDI
 int spi_comm(struct arguments args, const cable_t &cable,
 	const jtag_pins_conf_t *pins_config, target_board_t *board)
@@ -1038,6 +1096,8 @@ int parse_opt(int argc, char **argv, struct arguments *args,
 				cxxopts::value<bool>(args->skip_reset))
 			("spi",   "SPI mode (only for FTDI in serial mode)",
 				cxxopts::value<bool>(args->spi))
+			("svf-cache", "store/replay a compiled SVF cache (.svfc) next to the SVF file",
+				cxxopts::value<bool>(args->svf_cache))
 			("unprotect-flash",   "Unprotect flash blocks",
 				cxxopts::value<bool>(args->unprotect_flash))
 			("v,verbose", "Produce verbose output", cxxopts::value<bool>(verbose))
@@ -1052,6 +1112,10 @@ int parse_opt(int argc, char **argv, struct arguments *args,
 #ifdef ENABLE_XVC_SERVER
 			("xvc",   "Xilinx Virtual Cable Functions",
 				cxxopts::value<bool>(args->xvc))
+#endif
+#ifdef ENABLE_REMOTEBITBANG
+			("remote-bitbang-server", "export cable with the remote bitbang protocol (listen on --port)",
+				cxxopts::value<bool>(args->remote_bitbang_server))
 #endif
 			("port", "Xilinx Virtual Cable and remote bitbang Port (default 3721)",
 				cxxopts::value<int>(args->port))
@@ -1148,9 +1212,10 @@ int parse_opt(int argc, char **argv, struct arguments *args,
 			args->prg_type = Device::WR_FLASH;
 
 		if (args->passive_serial) {
-			if (args->spi || args->dfu || args->xvc || args->detect) {
+			if (args->spi || args->dfu || args->xvc ||
+					args->remote_bitbang_server || args->detect) {
 				printError("Error: --passive-serial cannot be combined with "
-					"--spi, --dfu, --xvc or --detect");
+					"--spi, --dfu, --xvc, --remote-bitbang-server or --detect");
 				return -1;
 			}
 		}
@@ -1278,6 +1343,7 @@ int parse_opt(int argc, char **argv, struct arguments *args,
 			!args->disable_quad &&
 			!args->bulk_erase_flash &&
 			!args->xvc &&
+			!args->remote_bitbang_server &&
 			!args->reset &&
 			!args->conmcu &&
 			!args->read_dna &&
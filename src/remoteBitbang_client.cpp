@@ -34,6 +34,11 @@
 #define TMS_BIT    (1 << TMS_OFFSET)
 #define TDI_BIT    (1 << TDI_OFFSET)
 
+/* 'R' requests sent before reading answers: keep it below socket buffers
+ * capacity (server may block when writing answers). Must be a multiple of 8
+ */
+#define MAX_PENDING_READ 16384
+
 RemoteBitbang_client::RemoteBitbang_client(const std::string &ip_addr, int port,
 		int8_t verbose):
 	_xfer_buf(NULL), _num_bytes(0), _last_tms(TMS_BIT),
@@ -107,12 +112,16 @@ int RemoteBitbang_client::writeTDI(const uint8_t *tx, uint8_t *rx, uint32_t len,
 	if (len == 0)  // nothing to do
 		return 0;
 
+	/* the whole scan is sent (clock edges and one 'R' per bit when rx)
+	 * before reading answers, by group of MAX_PENDING_READ
+	 */
+	uint32_t rx_pos = 0;  // first bit not yet received
 	uint8_t base_v = '0' + _last_tms;
 	for (uint32_t pos = 0; pos < len; pos++) {
 		const uint32_t pos_byte = (pos >> 3);
 		const uint32_t pos_bit  = (1 << (pos & 0x07));
-		if ((_num_bytes + 2) >= _buffer_size)
-			flush();
+		if ((_num_bytes + 3) >= _buffer_size)
+			ll_write();
 		_last_tdi = (tx[pos_byte] & pos_bit) ? TDI_BIT : 0;
 		if (end && pos == len - 1) {
 			_last_tms = TMS_BIT;
@@ -121,15 +130,20 @@ int RemoteBitbang_client::writeTDI(const uint8_t *tx, uint8_t *rx, uint32_t len,
 		_xfer_buf[_num_bytes++] = base_v + _last_tdi;
 		_xfer_buf[_num_bytes++] = base_v + _last_tdi + TCK_BIT;
 		if (rx) {
-			uint8_t tdo;
-			ll_write(&tdo);
-			if (tdo == '1')
-				rx[pos_byte] |= pos_bit;
-			else
-				rx[pos_byte] &= ~pos_bit;
+			_xfer_buf[_num_bytes++] = 'R';
+			if (pos + 1 - rx_pos == MAX_PENDING_READ) {
+				if (!ll_write() || !read_tdo(rx, rx_pos, MAX_PENDING_READ))
+					throw std::runtime_error("remote bitbang read failure");
+				rx_pos = pos + 1;
+			}
 		}
 	}
 
+	if (rx && rx_pos < len) {
+		if (!ll_write() || !read_tdo(rx, rx_pos, len - rx_pos))
+			throw std::runtime_error("remote bitbang read failure");
+	}
+
 	return len;
 }
 
@@ -157,7 +171,7 @@ int RemoteBitbang_client::toggleClk([[maybe_unused]] uint8_t tms,
 
 int RemoteBitbang_client::flush()
 {
-	return ll_write(NULL);
+	return ll_write();
 }
 
 int RemoteBitbang_client::setClkFreq(uint32_t clkHz)
@@ -213,25 +227,57 @@ ssize_t RemoteBitbang_client::xfer_pkt(uint8_t instr, uint8_t *rx)
 	return (rx) ? 1 : 0;
 }
 
-bool RemoteBitbang_client::ll_write(uint8_t *tdo)
+bool RemoteBitbang_client::ll_write()
 {
-	if (_num_bytes == 0)
-		return true;
-
-	ssize_t len;
-	// write current buffer
-	if ((len = write(_sock, _xfer_buf, _num_bytes)) == -1) {
-		printError("Send error error: " + std::to_string(len));
-		return false;
+	const uint8_t *ptr = _xfer_buf;
+	while (_num_bytes > 0) {
+		ssize_t len = write(_sock, ptr, _num_bytes);
+		if (len == -1) {
+			printError("Send error error: " + std::to_string(len));
+			return false;
+		}
+		ptr += len;
+		_num_bytes -= len;
 	}
-	_num_bytes = 0;
 
-	// read only one char (if tdo is not null
-	if (tdo) {
-		if (xfer_pkt('R', tdo) < 0) {
+	return true;
+}
+
+bool RemoteBitbang_client::read_tdo(uint8_t *rx, uint32_t pos, uint32_t len)
+{
+	/* one '0'/'1' answer per 'R' request */
+	_rx_buf.resize(len);
+	for (uint32_t rd = 0; rd < len;) {
+		ssize_t ret = recv(_sock, _rx_buf.data() + rd, len - rd, 0);
+		if (ret <= 0) {
 			printError("read request error");
 			return false;
 		}
+		rd += ret;
+	}
+
+	const uint8_t *tdo = _rx_buf.data();
+	uint32_t i = 0;
+	if ((pos & 0x07) == 0) {
+		/* '0' and '1' only differ by bit 0: gather bit 0 of 8
+		 * consecutive answers in one byte
+		 */
+		for (; i + 8 <= len; i += 8) {
+			uint64_t v;
+			memcpy(&v, tdo + i, sizeof(v));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+			v = __builtin_bswap64(v);
+#endif
+			rx[(pos + i) >> 3] = static_cast<uint8_t>(
+				((v & 0x0101010101010101ULL) * 0x0102040810204080ULL) >> 56);
+		}
+	}
+	for (; i < len; i++) {
+		const uint32_t bit = pos + i;
+		if (tdo[i] == '1')
+			rx[bit >> 3] |= (1 << (bit & 0x07));
+		else
+			rx[bit >> 3] &= ~(1 << (bit & 0x07));
 	}
 
 	return true;
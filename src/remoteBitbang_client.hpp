@@ -7,6 +7,7 @@
 #define SRC_REMOTEBITBANG_CLIENT_HPP_
 
 #include <string>
+#include <vector>
 
 #include "jtagInterface.hpp"
 
@@ -95,16 +96,25 @@ class RemoteBitbang_client: public JtagInterface {
 
 		/*!
 		 * \brief lowlevel write: write internal buffer (ASCII format)
-		 *        and read one char when tdo is not NULL.
-		 * \param[out]: tdo: TDO read pointer (may be null)
 		 * \return false when failure
 		 */
-		bool ll_write(uint8_t *tdo);
+		bool ll_write();
+
+		/*!
+		 * \brief receive answers to len 'R' requests already sent
+		 *        and store them in rx starting at bit pos
+		 * \param[out] rx: TDO buffer
+		 * \param[in] pos: first bit position in rx
+		 * \param[in] len: number of answers
+		 * \return false when failure
+		 */
+		bool read_tdo(uint8_t *rx, uint32_t pos, uint32_t len);
 
 		uint8_t *_xfer_buf;    /*!< tx buffer */
 		uint32_t _num_bytes;   /*!< number of bits stored */
 		uint32_t _last_tms;    /*!< last known TMS state */
 		uint32_t _last_tdi;    /*!< last known TDI state */
+		std::vector<uint8_t> _rx_buf; /*!< 'R' answers */
 
 		uint32_t _buffer_size; /*!< buffer max capacity */
 		int _sock;             /*!< socket */
@@ -0,0 +1,459 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+ * Copyright (C) 2023 Gwenhael Goavec-Merou <gwenhael.goavec-merou@trabucayre.com>
+ */
+
+#include "remoteBitbang_server.hpp"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include "display.hpp"
+
+#define TCK_OFFSET 2
+#define TMS_OFFSET 1
+#define TDI_OFFSET 0
+
+/* max read size per call */
+#define RBB_READ_CHUNK (64 * 1024)
+/* cycles stored before sending them to the cable */
+#define RBB_MAX_CYCLES (256 * 1024)
+/* shorter TMS=0 sequences are sent with writeTMS (fallback mode) */
+#define RBB_MIN_TDI_SEQ 8
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+RemoteBitbang_server::RemoteBitbang_server(int port, const cable_t &cable,
+	const jtag_pins_conf_t *pin_conf, const std::string &dev,
+	const std::string &serial, uint32_t clkHZ, int8_t verbose,
+	const std::string &ip_adr, const bool invert_read_edge,
+	const std::string &firmware_path,
+	const std::map<uint32_t, misc_device> &user_misc_devs):
+			_verbose(verbose > 1), _jtag_ctrl(NULL), _jtag(NULL),
+			_port(port), _sock(-1), _thread(NULL),
+			_is_stopped(false), _must_stop(false),
+			_tck(0), _tms(1), _tdi(0), _pending_read(0), _early_edge(-1),
+			_last_tdo(0),
+			_drv_tms(1), _tmstdi_support(true), _reset_warned(false)
+{
+	/* any cable supported by Jtag may be exported */
+	_jtag_ctrl = new Jtag(cable, pin_conf, dev, serial, clkHZ, verbose,
+		ip_adr, port, invert_read_edge, firmware_path, user_misc_devs);
+	_jtag = _jtag_ctrl->get_ll_class();
+}
+
+RemoteBitbang_server::~RemoteBitbang_server()
+{
+	close_connection();
+	delete _jtag_ctrl;
+}
+
+bool RemoteBitbang_server::open_connection()
+{
+	char hostname[256];
+	memset(&_sock_addr, '\0', sizeof(_sock_addr));
+	_sock_addr.sin_family = AF_INET;
+	_sock_addr.sin_port = htons(_port);
+	_sock_addr.sin_addr.s_addr = INADDR_ANY;
+
+	_sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if (_sock < 0) {
+		printError("Socket creation error");
+		return false;
+	}
+
+	int i = 1;
+	setsockopt(_sock, SOL_SOCKET, SO_REUSEADDR, &i, sizeof i);
+
+	if (::bind(_sock, (struct sockaddr*) &_sock_addr, sizeof(_sock_addr)) < 0) {
+		printError("Socket bind error");
+		close(_sock);
+		_sock = -1;
+		return false;
+	}
+
+	if (listen(_sock, 1) < 0) {
+		printError("Socket listen error");
+		close(_sock);
+		_sock = -1;
+		return false;
+	}
+
+	if (gethostname(hostname, sizeof(hostname)) != 0) {
+		printError("hostname lookup");
+		close(_sock);
+		_sock = -1;
+		return false;
+	}
+
+	char mess[512];
+	snprintf(mess, sizeof(mess),
+		"INFO: To connect to this remote bitbang server, use: %s:%d\n",
+		hostname, _port);
+	printInfo(mess);
+
+	return true;
+}
+
+bool RemoteBitbang_server::close_connection()
+{
+	if (_sock != -1)
+		close(_sock);
+	_sock = -1;
+	return true;
+}
+
+bool RemoteBitbang_server::listen_loop()
+{
+	if (_sock == -1)
+		return false;
+
+	_is_stopped = false;
+	_must_stop = false;
+	_thread = new std::thread(&RemoteBitbang_server::thread_listen, this);
+	printInfo("Press to quit");
+	getchar();
+	_must_stop = true;
+	_thread->join();
+	delete _thread;
+	_thread = NULL;
+	close_connection();
+
+	return true;
+}
+
+void RemoteBitbang_server::thread_listen()
+{
+	struct pollfd pfd = {_sock, POLLIN, 0};
+
+	while (!_must_stop) {
+		/* timeout to check _must_stop */
+		int ret = poll(&pfd, 1, 1000);
+		if (ret < 0 && errno != EINTR) {
+			printError("poll error");
+			break;
+		}
+		if (ret <= 0)
+			continue;
+
+		struct sockaddr_in addr;
+		socklen_t addr_len = sizeof(addr);
+		int fd = accept(_sock, (struct sockaddr *)&addr, &addr_len);
+		if (fd < 0) {
+			printError("accept error");
+			continue;
+		}
+
+		int one = 1;
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+		printInfo("connection accepted - fd " + std::to_string(fd));
+
+		try {
+			handle_client(fd);
+		} catch (std::exception &e) {
+			printError("remote bitbang: " + std::string(e.what()));
+		}
+
+		close(fd);
+		printInfo("connection closed - fd " + std::to_string(fd));
+	}
+
+	_is_stopped = true;
+}
+
+void RemoteBitbang_server::handle_client(int fd)
+{
+	std::vector<uint8_t> rx(RBB_READ_CHUNK);
+	std::vector<uint8_t> answers;
+	struct pollfd pfd = {fd, POLLIN, 0};
+	bool quit = false;
+
+	/* new client: pins are in an unknown state */
+	_tck = 0;
+	_tms = 1;
+	_tdi = 0;
+	_pending_read = 0;
+	_early_edge = -1;
+	_cyc_tms.clear();
+	_cyc_tdi.clear();
+	_cyc_reads.clear();
+
+	while (!quit && !_must_stop) {
+		int ret = poll(&pfd, 1, 1000);
+		if (ret < 0 && errno != EINTR)
+			throw std::runtime_error("poll error");
+		if (ret <= 0)
+			continue;
+
+		ssize_t len = recv(fd, rx.data(), rx.size(), 0);
+		if (len < 0) {
+			if (errno == EINTR)
+				continue;
+			throw std::runtime_error("receive error");
+		}
+		if (len == 0)  // client disconnected
+			break;
+
+		answers.clear();
+		quit = !decode(rx.data(), len, answers);
+
+		/* everything received is processed: send to the cable. When
+		 * the client quits there is no need to hold the last cycle
+		 */
+		if (!run_cycles(_tck && !quit, answers))
+			throw std::runtime_error("cable access failure");
+
+		size_t sent = 0;
+		while (sent < answers.size()) {
+			ssize_t r = send(fd, answers.data() + sent,
+				answers.size() - sent, MSG_NOSIGNAL);
+			if (r < 0) {
+				if (errno == EINTR)
+					continue;
+				throw std::runtime_error("send error");
+			}
+			sent += r;
+		}
+	}
+
+	/* disconnection without 'Q': send remaining cycles */
+	answers.clear();
+	run_cycles(false, answers);
+}
+
+bool RemoteBitbang_server::decode(const uint8_t *buf, size_t len,
+		std::vector<uint8_t> &answers)
+{
+	for (size_t i = 0; i < len; i++) {
+		const uint8_t c = buf[i];
+		switch (c) {
+		case '0': case '1': case '2': case '3':
+		case '4': case '5': case '6': case '7': {
+			const uint8_t v = c - '0';
+			const uint8_t tck = (v >> TCK_OFFSET) & 0x01;
+			_tms = (v >> TMS_OFFSET) & 0x01;
+			_tdi = (v >> TDI_OFFSET) & 0x01;
+			/* rising edge: one JTAG cycle */
+			if (tck && !_tck && _early_edge >= 0) {
+				/* cycle already sent to answer its 'R' */
+				if (_early_edge != (_tms | (_tdi << 1)))
+					printWarn("remote bitbang: TMS/TDI changed after an early 'R'");
+				_early_edge = -1;
+			} else if (tck && !_tck) {
+				_cyc_tms.push_back(_tms);
+				_cyc_tdi.push_back(_tdi);
+				_cyc_reads.push_back(_pending_read);
+				_pending_read = 0;
+				if (_cyc_tms.size() >= RBB_MAX_CYCLES &&
+						!run_cycles(true, answers))
+					throw std::runtime_error("cable access failure");
+			}
+			_tck = tck;
+			break;
+		}
+		case 'R':
+			/* TCK high: TDO sampled by the last rising edge.
+			 * TCK low: TDO that will be sampled by the next one
+			 */
+			if (!_tck && _early_edge >= 0)
+				answers.push_back('0' + _last_tdo);
+			else if (!_tck)
+				_pending_read++;
+			else if (!_cyc_reads.empty())
+				_cyc_reads.back()++;
+			else
+				answers.push_back('0' + _last_tdo);
+			break;
+		case 'r': case 's': case 't': case 'u':
+			if (!_reset_warned) {
+				printWarn("remote bitbang: TRST/SRST are not supported, ignored");
+				_reset_warned = true;
+			}
+			break;
+		case 'B': case 'b':  // blink: no LED
+			break;
+		case 'Q':
+			return false;
+		case '\n': case '\r': case ' ':
+			break;
+		default:
+			if (_verbose)
+				printWarn("remote bitbang: unknown command " +
+					std::to_string(c));
+		}
+	}
+
+	/* 'R' with TCK low and nothing more received: the client may wait
+	 * for the answer before the rising edge. This cycle is sent now
+	 * with the current TMS/TDI, and the next rising edge is skipped
+	 */
+	if (_pending_read) {
+		_cyc_tms.push_back(_tms);
+		_cyc_tdi.push_back(_tdi);
+		_cyc_reads.push_back(_pending_read);
+		_pending_read = 0;
+		_early_edge = _tms | (_tdi << 1);
+		if (!run_cycles(false, answers))
+			throw std::runtime_error("cable access failure");
+	}
+
+	return true;
+}
+
+bool RemoteBitbang_server::run_cycles(bool hold_last,
+		std::vector<uint8_t> &answers)
+{
+	uint32_t len = _cyc_tms.size();
+	if (len == 0) {
+		_jtag->flush();
+		return true;
+	}
+	/* an 'R' may still arrive for the cycle with TCK high */
+	if (hold_last && _cyc_reads[len - 1] == 0)
+		len--;
+	if (len == 0)
+		return true;
+
+	const uint32_t nb_bytes = (len + 7) / 8;
+	_tms_buf.assign(nb_bytes, 0);
+	_tdi_buf.assign(nb_bytes, 0);
+	_tdo_buf.assign(nb_bytes, 0);
+	for (uint32_t i = 0; i < len; i++) {
+		if (_cyc_tms[i])
+			_tms_buf[i >> 3] |= (1 << (i & 0x07));
+		if (_cyc_tdi[i])
+			_tdi_buf[i >> 3] |= (1 << (i & 0x07));
+	}
+
+	bool done = false;
+	if (_tmstdi_support) {
+		done = _jtag->writeTMSTDI(_tms_buf.data(), _tdi_buf.data(),
+			_tdo_buf.data(), len);
+		if (!done)
+			_tmstdi_support = false;
+	}
+	if (done) {
+		_drv_tms = _cyc_tms[len - 1];
+		_cyc_tdo.resize(len);
+		for (uint32_t i = 0; i < len; i++)
+			_cyc_tdo[i] = (_tdo_buf[i >> 3] >> (i & 0x07)) & 0x01;
+	} else if (!run_segments(len)) {
+		return false;
+	}
+	_jtag->flush();
+
+	/* answers in order */
+	for (uint32_t i = 0; i < len; i++) {
+		for (uint32_t r = 0; r < _cyc_reads[i]; r++)
+			answers.push_back('0' + _cyc_tdo[i]);
+	}
+	if (_cyc_reads[len - 1])
+		_last_tdo = _cyc_tdo[len - 1];
+
+	_cyc_tms.erase(_cyc_tms.begin(), _cyc_tms.begin() + len);
+	_cyc_tdi.erase(_cyc_tdi.begin(), _cyc_tdi.begin() + len);
+	_cyc_reads.erase(_cyc_reads.begin(), _cyc_reads.begin() + len);
+
+	return true;
+}
+
+bool RemoteBitbang_server::run_segments(uint32_t len)
+{
+	/* TDO isn't driven outside shift states: default value */
+	_cyc_tdo.assign(len, 1);
+
+	/* length of TMS=0 sequence starting at each cycle */
+	std::vector<uint32_t> zero_run(len + 1, 0);
+	for (uint32_t i = len; i > 0; i--)
+		zero_run[i - 1] = (_cyc_tms[i - 1]) ? 0 : zero_run[i] + 1;
+
+	std::vector<uint8_t> buf;
+	/* cycle whose TDO is read back with the next one, len when none */
+	uint32_t tdo_from_next = len;
+	uint32_t i = 0;
+	while (i < len) {
+		uint32_t j = i;
+		const bool rd_first = _cyc_reads[i] != 0 || tdo_from_next != len;
+		/* writeTDI and toggleClk keep TMS unchanged (except with end):
+		 * a TMS=0 cycle after a TMS=1 one must be sent by writeTMS.
+		 * This is the first cycle of a state move (never a shift)
+		 */
+		if ((_cyc_tms[i] == 0 && !_drv_tms) || (_cyc_tms[i] && rd_first)) {
+			/* TMS=0 sequence, optionally ended by a cycle with TMS=1
+			 * (exit shift state): writeTDI, or toggleClk when TDI
+			 * is constant and TDO isn't read
+			 */
+			j += zero_run[i];
+			bool end = false;
+			if (j < len && _cyc_tms[j]) {
+				end = true;
+				j++;
+			}
+			const uint32_t seg_len = j - i;
+			bool rd = rd_first, tdi_const = true;
+			buf.assign((seg_len + 7) / 8, 0);
+			for (uint32_t k = i; k < j; k++) {
+				rd |= _cyc_reads[k] != 0;
+				tdi_const &= _cyc_tdi[k] == _cyc_tdi[i];
+				if (_cyc_tdi[k])
+					buf[(k - i) >> 3] |= (1 << ((k - i) & 0x07));
+			}
+
+			if (!rd && !end && tdi_const) {
+				if (_jtag->toggleClk(0, _cyc_tdi[i], seg_len) < 0)
+					return false;
+			} else {
+				std::vector<uint8_t> rx((rd) ? buf.size() : 0, 0);
+				if (_jtag->writeTDI(buf.data(), (rd) ? rx.data() : NULL,
+						seg_len, end) < 0)
+					return false;
+				for (uint32_t k = i; rd && k < j; k++)
+					_cyc_tdo[k] = (rx[(k - i) >> 3] >> ((k - i) & 0x07)) & 0x01;
+			}
+			if (tdo_from_next != len) {
+				_cyc_tdo[tdo_from_next] = _cyc_tdo[i];
+				tdo_from_next = len;
+			}
+			_drv_tms = (end) ? 1 : 0;
+		} else {
+			/* TMS sequence with constant TDI and no read: short TMS=0
+			 * sequences (state moves, pause) are part of it. The
+			 * first cycle of a longer one too, to leave TMS low.
+			 * An 'R' on this first cycle can't be read back by
+			 * writeTMS: TAP doesn't drive TDO there (state entered
+			 * with TMS=1), its level is read back with the next cycle
+			 */
+			j++;
+			while (!_cyc_reads[i] && j < len && !_cyc_reads[j] &&
+					_cyc_tdi[j] == _cyc_tdi[i] &&
+					(_cyc_tms[j] || zero_run[j] < RBB_MIN_TDI_SEQ ||
+					 _cyc_tms[j - 1]))
+				j++;
+			if (_cyc_reads[i] && j < len)
+				tdo_from_next = i;
+			else if (_cyc_reads[i])
+				_cyc_tdo[i] = _last_tdo;
+			buf.assign((j - i + 7) / 8, 0);
+			for (uint32_t k = i; k < j; k++) {
+				if (_cyc_tms[k])
+					buf[(k - i) >> 3] |= (1 << ((k - i) & 0x07));
+			}
+			if (_jtag->writeTMS(buf.data(), j - i, false, _cyc_tdi[i]) < 0)
+				return false;
+			_drv_tms = _cyc_tms[j - 1];
+		}
+		i = j;
+	}
+
+	return true;
+}
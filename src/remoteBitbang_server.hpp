@@ -0,0 +1,117 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+ * Copyright (C) 2023 Gwenhael Goavec-Merou <gwenhael.goavec-merou@trabucayre.com>
+ */
+
+#ifndef SRC_REMOTEBITBANG_SERVER_HPP_
+#define SRC_REMOTEBITBANG_SERVER_HPP_
+
+#include <netinet/in.h>
+
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "jtag.hpp"
+
+/*!
+ * \brief Remote Bitbang Protocol server: export a local cable to
+ *        OpenOCD (remote_bitbang adapter), simulators or another
+ *        openFPGALoader instance
+ */
+class RemoteBitbang_server {
+	public:
+		RemoteBitbang_server(int port, const cable_t &cable,
+			const jtag_pins_conf_t *pin_conf, const std::string &dev,
+			const std::string &serial, uint32_t clkHZ, int8_t verbose,
+			const std::string &ip_adr, const bool invert_read_edge,
+			const std::string &firmware_path,
+			const std::map<uint32_t, misc_device> &user_misc_devs);
+		~RemoteBitbang_server();
+
+		/*!
+		 * \brief open a server socket
+		 * \return true when success, false otherwise
+		 */
+		bool open_connection();
+		/*!
+		 * \brief close server socket
+		 * \return true when success, false otherwise
+		 */
+		bool close_connection();
+		/*!
+		 * \brief start server loop
+		 * \return true when success, false otherwise
+		 */
+		bool listen_loop();
+
+	private:
+		/*!
+		 * \brief thread dedicated for wait for incoming connection
+		 */
+		void thread_listen();
+		/*!
+		 * \brief serve one client until it quits or disconnects
+		 */
+		void handle_client(int fd);
+		/*!
+		 * \brief decode remote bitbang commands: pins writes are
+		 *        converted to a list of clock cycles
+		 * \param[in] buf: commands received
+		 * \param[in] len: buf size
+		 * \param[out] answers: '0'/'1' for each 'R' already resolved
+		 * \return false when client sent 'Q'
+		 */
+		bool decode(const uint8_t *buf, size_t len,
+			std::vector<uint8_t> &answers);
+		/*!
+		 * \brief send stored cycles to the cable, with one transaction
+		 *        by group of cycles when possible
+		 * \param[in] hold_last: keep last cycle when TCK is high and
+		 *            an 'R' may still be attached to it
+		 * \param[out] answers: '0'/'1' for each 'R'
+		 * \return false when cable access fails
+		 */
+		bool run_cycles(bool hold_last, std::vector<uint8_t> &answers);
+		/*!
+		 * \brief fallback when the cable has no writeTMSTDI: split
+		 *        cycles in writeTMS/writeTDI/toggleClk calls
+		 * \return false when cable access fails
+		 */
+		bool run_segments(uint32_t len);
+
+		int _verbose;                 /*!< verbose level */
+		Jtag *_jtag_ctrl;             /*!< cable owner */
+		JtagInterface *_jtag;         /*!< jtag interface */
+		int _port;                    /*!< network port */
+		int _sock;                    /*!< server socket descriptor */
+		struct sockaddr_in _sock_addr;
+		std::thread *_thread;         /*!< connection thread */
+		volatile bool _is_stopped;    /*!< true when thread is stopped */
+		volatile bool _must_stop;     /*!< true to stop thread */
+
+		/* pins state as written by the client */
+		uint8_t _tck;
+		uint8_t _tms;
+		uint8_t _tdi;
+		uint32_t _pending_read;       /*!< 'R' with TCK low: next cycle */
+		int _early_edge;              /*!< TMS | TDI << 1 of a cycle clocked
+		                               *   before its rising edge, -1 if none */
+		uint8_t _last_tdo;            /*!< TDO of last sent cycle */
+		uint8_t _drv_tms;             /*!< last TMS sent to the cable */
+		bool _tmstdi_support;         /*!< cable supports writeTMSTDI */
+		bool _reset_warned;           /*!< reset request warning displayed */
+
+		/* cycles not yet sent: one entry per rising edge */
+		std::vector<uint8_t> _cyc_tms;
+		std::vector<uint8_t> _cyc_tdi;
+		std::vector<uint8_t> _cyc_tdo;
+		std::vector<uint32_t> _cyc_reads;  /*!< number of 'R' by cycle */
+		/* packed (LSB first) buffers for the cable */
+		std::vector<uint8_t> _tms_buf;
+		std::vector<uint8_t> _tdi_buf;
+		std::vector<uint8_t> _tdo_buf;
+};
+
+#endif  // SRC_REMOTEBITBANG_SERVER_HPP_
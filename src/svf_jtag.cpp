@@ -7,61 +7,293 @@
 
 #include "svf_jtag.hpp"
 
-#include <stdexcept>
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
+#if defined (_WIN64) || defined (_WIN32)
+#include <fstream>
+#include <sstream>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
 
 #include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <iomanip>
 #include <iostream>
-#include <sstream>
-#include <fstream>
-#include <map>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
 #include <vector>
 
+#include "display.hpp"
 #include "jtag.hpp"
 #include "progressBar.hpp"
 
+/* compiled cache (.svfc) header */
+#define SVF_CACHE_MAGIC      "OFLSVFC"
+#define SVF_CACHE_VERSION    1
+#define SVF_CACHE_BYTE_ORDER 0x01020304
 
-void SVF_jtag::split_str(std::string const &str, std::vector<std::string> &vparse)
-{
-	std::string token;
-	std::istringstream tokenStream(str);
-	while (tokenStream >> token){
-		if(!token.empty()){
-			vparse.push_back(token);
+/* deferred TDO checks storage: scans are sent when it's full */
+#define SVF_CHECK_BUF_LEN (1 << 20)
+
+/* parser to player queue: number of commands and max size (Bytes)
+ * a single command bigger than SVF_QUEUE_MAX_BYTES is always accepted
+ */
+#define SVF_QUEUE_LEN       1024
+#define SVF_QUEUE_MAX_BYTES (16 << 20)
+/* slot buffers above this size are released after use */
+#define SVF_SLOT_KEEP_LEN   (64 << 10)
+
+typedef struct {
+	char magic[8];
+	uint32_t version;
+	uint32_t byte_order;  /**< cache is only valid for the host byte order */
+	uint32_t cmd_size;    /**< sizeof(svf_cmd) */
+	uint32_t reserved;
+	uint64_t svf_size;    /**< SVF file size */
+	uint64_t svf_hash;    /**< SVF file content hash */
+} svf_cache_hdr;
+
+namespace {
+/* read-only file content: mapped when possible, copied otherwise */
+class MappedFile {
+ public:
+	MappedFile(): _data(NULL), _size(0) {}
+	~MappedFile() {
+#if !defined (_WIN64) && !defined (_WIN32)
+		if (_data && _size)
+			munmap(const_cast<char *>(_data), _size);
+#endif
+	}
+
+	bool open(const std::string &filename) {
+#if defined (_WIN64) || defined (_WIN32)
+		std::ifstream fs(filename, std::ios::in | std::ios::binary);
+		if (!fs.is_open())
+			return false;
+		std::stringstream ss;
+		ss << fs.rdbuf();
+		_content = ss.str();
+		_data = _content.data();
+		_size = _content.size();
+		return true;
+#else
+		int fd = ::open(filename.c_str(), O_RDONLY);
+		if (fd < 0)
+			return false;
+		struct stat st;
+		if (fstat(fd, &st) != 0) {
+			::close(fd);
+			return false;
+		}
+		_size = st.st_size;
+		if (_size == 0) {
+			::close(fd);
+			_data = "";
+			return true;
+		}
+		void *ptr = mmap(NULL, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+		::close(fd);
+		if (ptr == MAP_FAILED) {
+			_size = 0;
+			return false;
 		}
+		madvise(ptr, _size, MADV_SEQUENTIAL);
+		_data = static_cast<const char *>(ptr);
+		return true;
+#endif
+	}
+
+	const char *data() const { return _data;}
+	size_t size() const { return _size;}
+
+ private:
+	const char *_data;
+	size_t _size;
+#if defined (_WIN64) || defined (_WIN32)
+	std::string _content;
+#endif
+};
+}  // namespace
+
+/* SVF state name to Jtag state */
+static Jtag::tapState_t state_from_name(std::string_view name)
+{
+	static const struct {
+		const char *name;
+		Jtag::tapState_t state;
+	} fsm_state[] = {
+		{"RESET",     Jtag::TEST_LOGIC_RESET},
+		{"IDLE",      Jtag::RUN_TEST_IDLE},
+		{"DRSELECT",  Jtag::SELECT_DR_SCAN},
+		{"DRCAPTURE", Jtag::CAPTURE_DR},
+		{"DRSHIFT",   Jtag::SHIFT_DR},
+		{"DREXIT1",   Jtag::EXIT1_DR},
+		{"DRPAUSE",   Jtag::PAUSE_DR},
+		{"DREXIT2",   Jtag::EXIT2_DR},
+		{"DRUPDATE",  Jtag::UPDATE_DR},
+		{"IRSELECT",  Jtag::SELECT_IR_SCAN},
+		{"IRCAPTURE", Jtag::CAPTURE_IR},
+		{"IRSHIFT",   Jtag::SHIFT_IR},
+		{"IREXIT1",   Jtag::EXIT1_IR},
+		{"IRPAUSE",   Jtag::PAUSE_IR},
+		{"IREXIT2",   Jtag::EXIT2_IR},
+		{"IRUPDATE",  Jtag::UPDATE_IR},
+	};
+	for (auto &&s : fsm_state) {
+		if (name == s.name)
+			return s.state;
+	}
+	throw std::runtime_error("Error: unknown state " + std::string(name));
+}
+
+/* tokens are not null terminated: copy before conversion */
+static double to_double(std::string_view tok)
+{
+	char buf[64];
+	const size_t len = std::min(tok.size(), sizeof(buf) - 1);
+	memcpy(buf, tok.data(), len);
+	buf[len] = '\0';
+	char *end;
+	const double val = strtod(buf, &end);
+	if (end == buf)
+		throw std::runtime_error("Error: invalid number " + std::string(tok));
+	return val;
+}
+
+/* integer fields: parse without going through a double to keep every
+ * digit, scientific notation (1E3) is still accepted through to_double
+ */
+static uint32_t to_ul(std::string_view tok)
+{
+	const char *first = tok.data();
+	const char *last = first + tok.size();
+	uint64_t val;
+	auto res = std::from_chars(first, last, val);
+	if (res.ec == std::errc() && res.ptr != last &&
+			(*res.ptr == '.' || *res.ptr == 'e' || *res.ptr == 'E')) {
+		const double dval = to_double(tok);
+		if (dval < 0 || dval > UINT32_MAX)
+			throw std::runtime_error("Error: number out of range " + std::string(tok));
+		return static_cast<uint32_t>(dval);
 	}
+	if (res.ec == std::errc::result_out_of_range || (res.ec == std::errc() &&
+			val > UINT32_MAX))
+		throw std::runtime_error("Error: number out of range " + std::string(tok));
+	if (res.ec != std::errc() || res.ptr != last)
+		throw std::runtime_error("Error: invalid number " + std::string(tok));
+	return static_cast<uint32_t>(val);
 }
 
-void SVF_jtag::clear_XYR(svf_XYR &t)
+/* convert an hex string (between parenthesis) to bytes (LSB first)
+ * missing digits are set to 0, extra digits are ignored
+ */
+static void parse_hex(std::string_view in, uint8_t *out, size_t byte_length)
 {
-	t.len = 0;
-	t.tdo.clear();
-	t.tdi.clear();
-	t.mask.clear();
-	t.smask.clear();
+	/* drop '(' and ')' */
+	in = in.substr(1, in.size() - 2);
+	memset(out, 0, byte_length);
+	const size_t max_nibble = 2 * byte_length;
+	size_t nibble = 0;
+	for (size_t i = in.size(); i > 0 && nibble < max_nibble; i--) {
+		const char c = in[i - 1];
+		uint8_t v;
+		if (c >= '0' && c <= '9')
+			v = c - '0';
+		else if (c >= 'A' && c <= 'F')
+			v = c - 'A' + 10;
+		else if (c >= 'a' && c <= 'f')
+			v = c - 'a' + 10;
+		else if (isspace(static_cast<unsigned char>(c)))
+			continue;
+		else
+			throw std::runtime_error(std::string("Error: invalid hex digit ") + c);
+		out[nibble >> 1] |= v << ((nibble & 0x01) * 4);
+		nibble++;
+	}
 }
 
-static unsigned char *parse_hex(std::string const &in, size_t byte_length,
-		bool default_value)
+/* FNV-1a like hash, 64 bits at a time */
+static uint64_t svf_hash(const char *data, size_t len)
 {
-	unsigned char *txbuf = new unsigned char[byte_length];
-	char c;
-	ssize_t last_iter = in.size() - (2 * byte_length);
-	for (ssize_t i = (in.size() - 1), pos = 0; i >= last_iter; i--, pos++) {
-		if (i < 0) {
-			c = default_value ? 0x0f : 0x00;
+	uint64_t h = 0xcbf29ce484222325ULL;
+	size_t i = 0;
+	for (; i + 8 <= len; i += 8) {
+		uint64_t w;
+		memcpy(&w, data + i, 8);
+		h = (h ^ w) * 0x100000001b3ULL;
+	}
+	for (; i < len; i++)
+		h = (h ^ static_cast<uint8_t>(data[i])) * 0x100000001b3ULL;
+	return h;
+}
+
+/* return next token: a word, ';' or a full (...) content
+ * spaces and comments ('!' or '//' until end of line) are skipped
+ */
+bool SVF_jtag::next_token(std::string_view &tok)
+{
+	while (_cur < _end) {
+		const char c = *_cur;
+		if (c == '\n') {
+			_lineno++;
+			_cur++;
+		} else if (isspace(static_cast<unsigned char>(c))) {
+			_cur++;
+		} else if (c == '!' || (c == '/' && _cur + 1 < _end && _cur[1] == '/')) {
+			const char *eol = static_cast<const char *>(
+				memchr(_cur, '\n', _end - _cur));
+			_cur = (eol) ? eol : _end;
 		} else {
-			if (in[i] <= '9')
-				c = 0x0f & (in[i] - '0');
-			else
-				c = 0x0f & (in[i] - 'A' + 10);
+			break;
 		}
-		if (!(pos & 1))
-			txbuf[pos / 2] = c;
-		else
-			txbuf[pos / 2] |= c << 4;
 	}
-	return txbuf;
+	if (_cur >= _end)
+		return false;
+
+	const char *start = _cur;
+	if (*_cur == '(') {
+		const char *close = static_cast<const char *>(
+			memchr(_cur, ')', _end - _cur));
+		if (!close)
+			throw std::runtime_error("Error: missing ')'");
+		_lineno += std::count(_cur, close, '\n');
+		_cur = close + 1;
+	} else if (*_cur == ';') {
+		_cur++;
+	} else {
+		while (_cur < _end && !isspace(static_cast<unsigned char>(*_cur)) &&
+				*_cur != ';' && *_cur != '(')
+			_cur++;
+	}
+	tok = std::string_view(start, _cur - start);
+	return true;
+}
+
+/* fill _tokens with the next statement (without ';')
+ * return false at end of file
+ */
+bool SVF_jtag::next_statement()
+{
+	std::string_view tok;
+	_tokens.clear();
+	while (next_token(tok)) {
+		if (_tokens.empty())
+			_stmt_line = _lineno;
+		if (tok == ";")
+			return true;
+		_tokens.push_back(tok);
+	}
+	if (!_tokens.empty())
+		throw std::runtime_error("Error: missing ';' at end of file");
+	return false;
 }
 
 /* pas clair:
@@ -69,165 +301,91 @@ static unsigned char *parse_hex(std::string const &in, size_t byte_length,
 * tdi, mask et smask sont memorises. Si pas present c'est la memoire
 * qui est utilise
 * tdo si absent on s'en fout
-* TODO: ameliorer l'analyse des chaines de caracteres
 */
-void SVF_jtag::parse_XYR(std::vector<std::string> const &vstr, svf_XYR &t)
+void SVF_jtag::parse_XYR(svf_XYR &t)
 {
-	if (_verbose)
-		std::cout << std::endl;
-	int mode = 0;
-	std::string s;
-	std::string full_line;
-	full_line.reserve(1276);
-	int write_data = -1;
-
-	if (vstr[0][0] == 'S')
-		write_data = ((vstr[0][1] == 'I') ? 0 : 1);
+	if (_tokens.size() < 2)
+		throw std::runtime_error("Error parsing instruction: missing length");
 
-	uint32_t new_length = stoul(vstr[1]);
+	const uint32_t new_length = to_ul(_tokens[1]);
+	const size_t byte_len = (new_length + 7) / 8;
 	if (new_length != t.len) {
-		clear_XYR(t);
+		t.tdi.assign(byte_len, 0);
+		t.mask.assign(byte_len, 0xff);
+		t.smask.assign(byte_len, 0xff);
+		t.tdo.assign(byte_len, 0);
 	}
 	t.len = new_length;
-	t.tdo.clear();
-	if (t.len == 0)
-		return;
-	for (size_t pos = 2; pos < vstr.size(); pos++) {
-		s = vstr[pos];
-
-		if (s.empty()){
-			throw std::runtime_error("Error parsing instruction: extraneous spaces");
-			return;
-		}
+	t.has_tdo = false;
 
-		if (!s.compare("TDO")) {
-			mode = 1;
-			continue;
-		} else if (!s.compare("TDI")) {
-			mode = 2;
-			continue;
-		} else if (!s.compare("MASK")) {
-			mode = 3;
-			continue;
-		} else if (!s.compare("SMASK")) {
-			mode = 4;
-			continue;
-		}
-
-		if (s.front() == '(')
-			s = s.substr(1);
-		if (s.front() == '\t')
-			s = s.substr(1);
-		if (s.back() == ')')
-			s = s.substr(0, s.size() - 1);
-
-		/* faut analyser et convertir le string ici
-		 * quand s.back() == ')'
-		 */
-
-		full_line += s;
-		s.clear();
-
-		if (vstr[pos].back() == ')') {
-			switch (mode) {
-			case 1:
-				t.tdo.clear();
-				t.tdo = full_line;
-				break;
-			case 2:
-				t.tdi = full_line;
-				break;
-			case 3:
-				t.mask.clear();
-				t.mask = full_line;
-				break;
-			case 4:
-				t.smask.clear();
-				t.smask = full_line;
-				break;
-			}
-			full_line.clear();
-		}
-	}
-	if (write_data != -1) {
-		size_t byte_len = (t.len + 7) / 8;
-		if (byte_len == 0)
-			return;
-		unsigned char *write_buffer = parse_hex(t.tdi, byte_len, 0);
-		if (!t.smask.empty()) {
-			unsigned char *smaskbuff = parse_hex(t.smask, byte_len, 0);
-			for (unsigned int b = 0; b < byte_len; b++) {
-				write_buffer[b] &= smaskbuff[b];
-			}
-			delete[] smaskbuff;
-		}
-		unsigned char *read_buffer = NULL;
-		if (!t.tdo.empty()) {
-			read_buffer = new unsigned char[byte_len];
-			read_buffer[byte_len - 1] = 0;  // clear the last byte which may not be full;
+	for (size_t pos = 2; pos < _tokens.size(); pos += 2) {
+		const std::string_view key = _tokens[pos];
+		if (pos + 1 >= _tokens.size() || _tokens[pos + 1].front() != '(')
+			throw std::runtime_error("Error parsing instruction: " +
+				std::string(key) + " without value");
+		std::vector<uint8_t> *dst;
+		if (key == "TDI") {
+			dst = &t.tdi;
+		} else if (key == "TDO") {
+			dst = &t.tdo;
+			t.has_tdo = true;
+		} else if (key == "MASK") {
+			dst = &t.mask;
+		} else if (key == "SMASK") {
+			dst = &t.smask;
 		} else {
-			read_buffer = NULL;
+			throw std::runtime_error("Error parsing instruction: unknown field " +
+				std::string(key));
 		}
-		if (write_data == 0)
-			_jtag->shiftIR(write_buffer, read_buffer, t.len, _endir);
-		else
-			_jtag->shiftDR(write_buffer, read_buffer, t.len, _enddr);
-		if (!t.tdo.empty()) {
-			unsigned char *tdobuf = parse_hex(t.tdo, byte_len, 0);
-			unsigned char *maskbuf = parse_hex(t.mask, byte_len, t.mask.empty() ? 1 : 0);
-			for (size_t i = 0; i < byte_len; i++) {
-				if ((read_buffer[i] ^ tdobuf[i]) & maskbuf[i]) {
-					std::cerr << "TDO value ";
-					for (int j = byte_len - 1; j >= 0; j--) {
-						std::cerr << std::uppercase << std::hex << int(read_buffer[j]);
-					}
-					std::cerr << " isn't the one expected: " << std::uppercase << t.tdo << std::endl;
-					delete[] tdobuf;
-					delete[] maskbuf;
-					throw std::exception();
-				}
-			}
-			delete[] tdobuf;
-			delete[] maskbuf;
-		}
-		delete[] write_buffer;
-		delete[] read_buffer;
+		parse_hex(_tokens[pos + 1], dst->data(), byte_len);
 	}
 }
 
+void SVF_jtag::display_XYR(const char *name, const svf_XYR &t)
+{
+	if (!_verbose)
+		return;
+	std::cout << name << std::endl;
+	std::cout << "\tlen   : " << t.len << std::endl;
+	std::cout << "\ttdo   : " << ((t.has_tdo) ? t.tdo.size() * 8 : 0) << std::endl;
+	std::cout << "\ttdi   : " << t.tdi.size() * 8 << std::endl;
+	std::cout << "\tmask  : " << t.mask.size() * 8 << std::endl;
+	std::cout << "\tsmask : " << t.smask.size() * 8 << std::endl;
+}
+
 /* Implementation partielle de la spec */
-void SVF_jtag::parse_runtest(std::vector<std::string> const &vstr)
+void SVF_jtag::parse_runtest()
 {
-	unsigned int pos = 1;
-	int nb_iter = 0;
+	const std::vector<std::string_view> &vstr = _tokens;
+	size_t pos = 1;
+	uint32_t nb_iter = 0;
 	int run_state = -1;
 	int end_state = -1;
 	double min_duration = -1;
 	// 0 => RUNTEST
 	// 1 => Ca depend
-	if (isalpha(vstr[pos][0])) {
-		run_state = fsm_state[vstr[1]];
+	if (pos < vstr.size() && isalpha(static_cast<unsigned char>(vstr[pos][0]))) {
+		run_state = state_from_name(vstr[pos]);
 		pos++;
 	}
-	if (!vstr[pos + 1].compare("SEC")) {
-		min_duration = atof(vstr[pos].c_str());
-		pos++;
-		pos++;
+	if (pos + 1 >= vstr.size())
+		throw std::runtime_error("Error: RUNTEST: missing arguments");
+	if (vstr[pos + 1] == "SEC") {
+		min_duration = to_double(vstr[pos]);
+		pos += 2;
 	} else {
-		nb_iter = atoi(vstr[pos].c_str());
-		pos++;
-		pos++;  // run_clk field, ignored.
-		if (((pos + 1) < vstr.size()) &&
-			(!vstr[pos + 1].compare("SEC"))) {
-			min_duration = atof(vstr[pos].c_str());
-			pos++;
-			pos++;
+		nb_iter = to_ul(vstr[pos]);
+		pos += 2;  // run_clk field, ignored.
+		if (((pos + 1) < vstr.size()) && (vstr[pos + 1] == "SEC")) {
+			min_duration = to_double(vstr[pos]);
+			pos += 2;
 		}
 	}
-	auto res = find(begin(vstr) + pos, end(vstr), "ENDSTATE");
-	if (res != end(vstr)) {
-		res++;
-		end_state = fsm_state[*res];
+	for (; pos + 1 < vstr.size(); pos++) {
+		if (vstr[pos] == "ENDSTATE") {
+			end_state = state_from_name(vstr[pos + 1]);
+			break;
+		}
 	}
 	if (run_state != -1) {
 		_run_state = (Jtag::tapState_t)run_state;
@@ -237,197 +395,487 @@ void SVF_jtag::parse_runtest(std::vector<std::string> const &vstr)
 	} else if (run_state != -1) {
 		_end_state = (Jtag::tapState_t)run_state;
 	}
-	_jtag->set_state(_run_state);
-	_jtag->toggleClk(nb_iter);
-	_jtag->flush();
-	if (min_duration > 0)
-	{
-		usleep((useconds_t)(min_duration * 1.0E6));
-	}
-	_jtag->set_state(_end_state);
-	}
 
-void SVF_jtag::handle_instruction(std::vector<std::string> const &vstr)
+	svf_cmd cmd = {};
+	cmd.type = SVF_CMD_RUNTEST;
+	cmd.state = _run_state;
+	cmd.end_state = _end_state;
+	cmd.len = nb_iter;
+	cmd.value = min_duration;
+	emit_cmd(cmd);
+}
+
+void SVF_jtag::handle_instruction()
 {
-	if (!vstr[0].compare("FREQUENCY")) {
-		_freq_hz = atof(vstr[1].c_str());
-		if (_verbose) {
-			std::cout << "frequency value " << vstr[1] << " unit " << vstr[2];
-			std::cout << _freq_hz << std::endl;
-		}
-		_jtag->setClkFreq(_freq_hz);
-	} else if (!vstr[0].compare("TRST")) {
-		if (_verbose) std::cout << "trst value : " << vstr[1] << std::endl;
-	} else if (!vstr[0].compare("ENDDR")) {
-		if (_verbose) std::cout << "enddr value : " << vstr[1] << std::endl;
-		_enddr = (Jtag::tapState_t)fsm_state[vstr[1]];
-	} else if (!vstr[0].compare("ENDIR")) {
-		if (_verbose) std::cout << "endir value : " << vstr[1] << std::endl;
-		_endir = (Jtag::tapState_t)fsm_state[vstr[1]];
-	} else if (!vstr[0].compare("STATE")) {
-		if (_verbose) std::cout << "state value : " << vstr[1] << std::endl;
-		_jtag->set_state((Jtag::tapState_t)fsm_state[vstr[1]]);
-	} else if (!vstr[0].compare("RUNTEST")) {
-		parse_runtest(vstr);
-	} else if (!vstr[0].compare("HIR")) {
-		parse_XYR(vstr, hir);
+	const std::vector<std::string_view> &vstr = _tokens;
+	const std::string_view instr = vstr[0];
+
+	if (_verbose && instr != "HDR" && instr != "HIR" &&
+			instr != "SDR" && instr != "SIR") {
+		for (auto &&word : vstr)
+			std::cout << word << " ";
+		std::cout << std::endl;
+	}
+
+	if (instr == "FREQUENCY") {
+		/* no value: full speed -> keep current frequency */
+		if (vstr.size() < 2)
+			return;
+		_freq_hz = to_double(vstr[1]);
+		svf_cmd cmd = {};
+		cmd.type = SVF_CMD_FREQUENCY;
+		cmd.value = _freq_hz;
+		emit_cmd(cmd);
+	} else if (instr == "TRST") {
+		/* nothing to do */
+	} else if (instr == "ENDDR") {
+		_enddr = state_from_name(vstr.at(1));
+	} else if (instr == "ENDIR") {
+		_endir = state_from_name(vstr.at(1));
+	} else if (instr == "STATE") {
+		/* only the last (stable) state matters: path is computed by Jtag */
+		svf_cmd cmd = {};
+		cmd.type = SVF_CMD_STATE;
+		cmd.state = state_from_name(vstr.at(vstr.size() - 1));
+		emit_cmd(cmd);
+	} else if (instr == "RUNTEST") {
+		parse_runtest();
+	} else if (instr == "HIR") {
+		parse_XYR(hir);
 		if (hir.len > 0) {
 			std::cerr << "HIR length supported is only 0 " << std::endl;
 		}
-		if (_verbose) {
-			std::cout << "HIR" << std::endl;
-			std::cout << "\tlen   : " << hir.len << std::endl;
-			std::cout << "\ttdo   : " << hir.tdo.size()*4 << std::endl;
-			std::cout << "\ttdi   : " << hir.tdi.size()*4 << std::endl;
-			std::cout << "\tmask  : " << hir.mask.size()*4 << std::endl;
-			std::cout << "\tsmask : " << hir.smask.size()*4 << std::endl;
-		}
-	} else if (!vstr[0].compare("HDR")) {
-		parse_XYR(vstr, hdr);
+		display_XYR("HIR", hir);
+	} else if (instr == "HDR") {
+		parse_XYR(hdr);
 		if (hdr.len > 0) {
 			std::cerr << "HDR length supported is only 0" << std::endl;
 		}
-		if (_verbose) {
-			std::cout << "HDR" << std::endl;
-			std::cout << "\tlen   : " << hdr.len << std::endl;
-			std::cout << "\ttdo   : " << hdr.tdo.size()*4 << std::endl;
-			std::cout << "\ttdi   : " << hdr.tdi.size()*4 << std::endl;
-			std::cout << "\tmask  : " << hdr.mask.size()*4 << std::endl;
-			std::cout << "\tsmask : " << hdr.smask.size()*4 << std::endl;
-		}
-	} else if (!vstr[0].compare("SIR")) {
-		parse_XYR(vstr, sir);
-		if (_verbose) {
-			for (auto &&t : vstr)
-				std::cout << t << " ";
-			std::cout << std::endl;
-			std::cout << "\tlen   : " << sir.len << std::endl;
-			std::cout << "\ttdo   : " << sir.tdo.size()*4 << std::endl;
-			std::cout << "\ttdi   : " << sir.tdi.size()*4 << std::endl;
-			std::cout << "\tmask  : " << sir.mask.size()*4 << std::endl;
-			std::cout << "\tsmask : " << sir.smask.size()*4 << std::endl;
-		}
-	} else if (!vstr[0].compare("SDR")) {
-		parse_XYR(vstr, sdr);
-		if (_verbose) {
-			std::cout << "SDR" << std::endl;
-			std::cout << "\tlen   : " << sdr.len << std::endl;
-			std::cout << "\ttdo   : " << sdr.tdo.size()*4 << std::endl;
-			std::cout << "\ttdi   : " << sdr.tdi.size()*4 << std::endl;
-			std::cout << "\tmask  : " << sdr.mask.size()*4 << std::endl;
-			std::cout << "\tsmask : " << sdr.smask.size()*4 << std::endl;
-		}
-	} else if (!vstr[0].compare("TDR")) {
-		parse_XYR(vstr, tdr);
+		display_XYR("HDR", hdr);
+	} else if (instr == "SIR") {
+		parse_XYR(sir);
+		display_XYR("SIR", sir);
+		emit_scan(SVF_CMD_SIR, sir, _endir);
+	} else if (instr == "SDR") {
+		parse_XYR(sdr);
+		display_XYR("SDR", sdr);
+		emit_scan(SVF_CMD_SDR, sdr, _enddr);
+	} else if (instr == "TDR") {
+		parse_XYR(tdr);
 		if (tdr.len > 0) {
 			std::cerr << "TDR length supported is only 0" << std::endl;
 		}
-		if (_verbose) {
-			std::cout << "TDR" << std::endl;
-			std::cout << "\tlen   : " << tdr.len << std::endl;
-			std::cout << "\ttdo   : " << tdr.tdo.size() * 4 << std::endl;
-			std::cout << "\ttdi   : " << tdr.tdi.size() * 4 << std::endl;
-			std::cout << "\tmask  : " << tdr.mask.size() * 4 << std::endl;
-			std::cout << "\tsmask : " << tdr.smask.size() * 4 << std::endl;
-		}
-	} else if (!vstr[0].compare("TIR")) {
-		parse_XYR(vstr, tir);
+		display_XYR("TDR", tdr);
+	} else if (instr == "TIR") {
+		parse_XYR(tir);
 		if (tir.len > 0) {
 			std::cerr << "TIR length supported is only 0" << std::endl;
 		}
-		if (_verbose) {
-			std::cout << "TIR" << std::endl;
-			std::cout << "\tlen   : " << tir.len << std::endl;
-			std::cout << "\ttdo   : " << tir.tdo.size() * 4 << std::endl;
-			std::cout << "\ttdi   : " << tir.tdi.size() * 4 << std::endl;
-			std::cout << "\tmask  : " << tir.mask.size() * 4 << std::endl;
-			std::cout << "\tsmask : " << tir.smask.size() * 4 << std::endl;
-		}
+		display_XYR("TIR", tir);
 	} else {
-		std::cout << "error: unhandled instruction " << vstr[0] << std::endl;
-		throw std::exception();
+		throw std::runtime_error("unhandled SVF instruction " + std::string(instr));
+	}
+}
+
+void SVF_jtag::emit_scan(uint8_t type, const svf_XYR &t,
+		Jtag::tapState_t end_state)
+{
+	if (t.len == 0)
+		return;
+
+	const size_t byte_len = (t.len + 7) / 8;
+	svf_cmd cmd = {};
+	cmd.type = type;
+	cmd.has_tdo = t.has_tdo;
+	cmd.state = end_state;
+	cmd.len = t.len;
+	cmd.lineno = _stmt_line;
+
+	std::vector<uint8_t> &buf = slot_acquire();
+	buf.resize(cmd_size(cmd));
+	memcpy(buf.data(), &cmd, sizeof(svf_cmd));
+	uint8_t *payload = buf.data() + sizeof(svf_cmd);
+	/* only tdi bits with smask set are significant */
+	for (size_t i = 0; i < byte_len; i++)
+		payload[i] = t.tdi[i] & t.smask[i];
+	if (t.has_tdo) {
+		memcpy(payload + byte_len, t.tdo.data(), byte_len);
+		memcpy(payload + 2 * byte_len, t.mask.data(), byte_len);
+	}
+
+	if (_cache_fd)
+		fwrite(buf.data(), 1, buf.size(), _cache_fd);
+	slot_commit();
+}
+
+void SVF_jtag::emit_cmd(const svf_cmd &cmd)
+{
+	std::vector<uint8_t> &buf = slot_acquire();
+	buf.resize(sizeof(svf_cmd));
+	memcpy(buf.data(), &cmd, sizeof(svf_cmd));
+	reinterpret_cast<svf_cmd *>(buf.data())->lineno = _stmt_line;
+	if (_cache_fd)
+		fwrite(buf.data(), 1, sizeof(svf_cmd), _cache_fd);
+	slot_commit();
+}
+
+/* parser side: wait for a free slot. Slot content is only touched by
+ * the parser until slot_commit
+ */
+std::vector<uint8_t> &SVF_jtag::slot_acquire()
+{
+	std::unique_lock<std::mutex> lock(_queue_mutex);
+	_queue_not_full.wait(lock, [this]{
+		return _queue_abort || (_queue_count < SVF_QUEUE_LEN &&
+			(_queue_count == 0 || _queue_bytes < SVF_QUEUE_MAX_BYTES));
+	});
+	if (_queue_abort)
+		throw std::runtime_error("SVF playback aborted");
+	return _queue[(_queue_head + _queue_count) % SVF_QUEUE_LEN].data;
+}
+
+void SVF_jtag::slot_commit()
+{
+	std::lock_guard<std::mutex> lock(_queue_mutex);
+	svf_slot &slot = _queue[(_queue_head + _queue_count) % SVF_QUEUE_LEN];
+	slot.file_pos = _cur - _start;
+	_queue_bytes += slot.data.size();
+	_queue_count++;
+	_queue_not_empty.notify_one();
+}
+
+/* player side: wait for a command, NULL when parser is done */
+SVF_jtag::svf_slot *SVF_jtag::slot_front()
+{
+	std::unique_lock<std::mutex> lock(_queue_mutex);
+	_queue_not_empty.wait(lock, [this]{
+		return _queue_count > 0 || _parse_done;
+	});
+	if (_queue_count == 0)
+		return NULL;
+	return &_queue[_queue_head];
+}
+
+void SVF_jtag::slot_release()
+{
+	std::lock_guard<std::mutex> lock(_queue_mutex);
+	svf_slot &slot = _queue[_queue_head];
+	_queue_bytes -= slot.data.size();
+	/* don't keep huge scans (bitstreams) allocated */
+	if (slot.data.capacity() > SVF_SLOT_KEEP_LEN)
+		std::vector<uint8_t>().swap(slot.data);
+	_queue_head = (_queue_head + 1) % SVF_QUEUE_LEN;
+	_queue_count--;
+	_queue_not_full.notify_one();
+}
+
+/* parser thread */
+void SVF_jtag::parse_thread()
+{
+	try {
+		while (next_statement()) {
+			if (_tokens.empty())
+				continue;
+			handle_instruction();
+		}
+	} catch (std::exception &e) {
+		_parse_error = std::current_exception();
 	}
+	std::lock_guard<std::mutex> lock(_queue_mutex);
+	_parse_done = true;
+	_queue_not_empty.notify_one();
 }
 
-SVF_jtag::SVF_jtag(Jtag *jtag, bool verbose):_verbose(verbose), _freq_hz(0),
-	_enddr((Jtag::tapState_t)fsm_state["IDLE"]), _endir((Jtag::tapState_t)fsm_state["IDLE"]),
-	_run_state((Jtag::tapState_t)fsm_state["IDLE"]), _end_state((Jtag::tapState_t)fsm_state["IDLE"])
+size_t SVF_jtag::cmd_size(const svf_cmd &cmd)
+{
+	if (cmd.type != SVF_CMD_SIR && cmd.type != SVF_CMD_SDR)
+		return sizeof(svf_cmd);
+	const size_t byte_len = (cmd.len + 7) / 8;
+	return sizeof(svf_cmd) + byte_len * ((cmd.has_tdo) ? 3 : 1);
+}
+
+void SVF_jtag::run_cmd(const svf_cmd &cmd, const uint8_t *payload)
+{
+	switch (cmd.type) {
+	case SVF_CMD_SIR:
+	case SVF_CMD_SDR: {
+		const size_t byte_len = (cmd.len + 7) / 8;
+		uint8_t *rx = NULL;
+		if (cmd.has_tdo)
+			queue_check(cmd, payload + byte_len, payload + 2 * byte_len, &rx);
+		if (cmd.type == SVF_CMD_SIR)
+			_jtag->shiftIR(payload, rx, cmd.len, (Jtag::tapState_t)cmd.state);
+		else
+			_jtag->shiftDR(payload, rx, cmd.len, (Jtag::tapState_t)cmd.state);
+		break;
+	}
+	case SVF_CMD_STATE:
+		_jtag->set_state((Jtag::tapState_t)cmd.state);
+		break;
+	case SVF_CMD_RUNTEST:
+		_jtag->set_state((Jtag::tapState_t)cmd.state);
+		_jtag->toggleClk(cmd.len);
+		flush_checks();
+		if (cmd.value > 0)
+			usleep((useconds_t)(cmd.value * 1.0E6));
+		_jtag->set_state((Jtag::tapState_t)cmd.end_state);
+		break;
+	case SVF_CMD_FREQUENCY:
+		if (_verbose)
+			std::cout << "frequency value " << cmd.value << std::endl;
+		flush_checks();
+		_jtag->setClkFreq(cmd.value);
+		break;
+	default:
+		throw std::runtime_error("Error: unknown SVF command");
+	}
+}
+
+/* store expected TDO and mask and reserve rx space. Jtag is in queued
+ * mode: rx must stay at the same address until flush_checks
+ */
+void SVF_jtag::queue_check(const svf_cmd &cmd, const uint8_t *tdo,
+		const uint8_t *mask, uint8_t **rx)
+{
+	const size_t byte_len = (cmd.len + 7) / 8;
+	size_t offset = _check_buf.size();
+	if (offset + 3 * byte_len > _check_buf.capacity()) {
+		flush_checks();
+		offset = 0;
+		if (3 * byte_len > _check_buf.capacity())
+			_check_buf.reserve(3 * byte_len);
+	}
+	_check_buf.resize(offset + 3 * byte_len, 0);
+	memcpy(_check_buf.data() + offset + byte_len, tdo, byte_len);
+	memcpy(_check_buf.data() + offset + 2 * byte_len, mask, byte_len);
+	_checks.push_back({offset, cmd.len, cmd.lineno});
+	*rx = _check_buf.data() + offset;
+}
 
+/* send queued scans and compare TDO with expected values */
+void SVF_jtag::flush_checks()
 {
+	_jtag->flush();
+
+	for (auto &&chk : _checks) {
+		const size_t byte_len = (chk.len + 7) / 8;
+		const uint8_t *rx = _check_buf.data() + chk.offset;
+		const uint8_t *tdo = rx + byte_len;
+		const uint8_t *mask = tdo + byte_len;
+		/* bits above len are not part of the scan */
+		const uint8_t last_mask = (chk.len % 8) ? (1 << (chk.len % 8)) - 1 : 0xff;
+		for (size_t i = 0; i < byte_len; i++) {
+			uint8_t m = mask[i];
+			if (i == byte_len - 1)
+				m &= last_mask;
+			if (((rx[i] ^ tdo[i]) & m) == 0)
+				continue;
+			std::cerr << "TDO value ";
+			for (int j = byte_len - 1; j >= 0; j--)
+				std::cerr << std::uppercase << std::hex << std::setw(2)
+					<< std::setfill('0') << int(rx[j]);
+			std::cerr << " isn't the one expected: ";
+			for (int j = byte_len - 1; j >= 0; j--)
+				std::cerr << std::uppercase << std::hex << std::setw(2)
+					<< std::setfill('0') << int(tdo[j]);
+			std::cerr << std::dec << " (line " << chk.lineno << ")" << std::endl;
+			_err_line = chk.lineno;
+			_checks.clear();
+			_check_buf.clear();
+			throw std::runtime_error("Error: TDO mismatch");
+		}
+	}
+	_checks.clear();
+	_check_buf.clear();
+}
+
+/* replay a compiled cache when it matches SVF file
+ * return false when cache is missing or outdated
+ */
+bool SVF_jtag::replay_cache(const std::string &cache_name, uint64_t svf_size,
+		uint64_t svf_hash)
+{
+	MappedFile cache;
+	if (!cache.open(cache_name))
+		return false;
+	svf_cache_hdr hdr;
+	if (cache.size() < sizeof(hdr))
+		return false;
+	memcpy(&hdr, cache.data(), sizeof(hdr));
+	if (memcmp(hdr.magic, SVF_CACHE_MAGIC, sizeof(hdr.magic)) != 0 ||
+			hdr.version != SVF_CACHE_VERSION ||
+			hdr.byte_order != SVF_CACHE_BYTE_ORDER ||
+			hdr.cmd_size != sizeof(svf_cmd) ||
+			hdr.svf_size != svf_size || hdr.svf_hash != svf_hash)
+		return false;
+
+	printInfo("Using compiled SVF cache " + cache_name);
+
+	const uint8_t *data = reinterpret_cast<const uint8_t *>(cache.data());
+	const size_t size = cache.size();
+	size_t pos = sizeof(hdr);
+	ProgressBar progress("Writing SVF " + cache_name, size, 50, _verbose);
+	_jtag->setQueueMode(true);
+	try {
+		while (pos < size) {
+			svf_cmd cmd;
+			if (pos + sizeof(cmd) > size)
+				throw std::runtime_error("Error: truncated SVF cache");
+			memcpy(&cmd, data + pos, sizeof(cmd));
+			const size_t len = cmd_size(cmd);
+			if (pos + len > size)
+				throw std::runtime_error("Error: truncated SVF cache");
+			_err_line = cmd.lineno;
+			run_cmd(cmd, data + pos + sizeof(cmd));
+			pos += len;
+			progress.display(pos);
+		}
+		flush_checks();
+	} catch (std::exception &e) {
+		std::cerr << "Cannot proceed because of error(s) at line " << std::dec
+			<< _err_line << std::endl;
+		progress.fail();
+		_jtag->setQueueMode(false);
+		throw;
+	}
+	_jtag->setQueueMode(false);
+	progress.done();
+	return true;
+}
+
+bool SVF_jtag::open_cache(const std::string &cache_name)
+{
+	_cache_fd = fopen(cache_name.c_str(), "wb");
+	if (!_cache_fd) {
+		printWarn("Warning: can't create SVF cache " + cache_name);
+		return false;
+	}
+	/* header is written when the whole file is successfully played */
+	svf_cache_hdr hdr = {};
+	fwrite(&hdr, 1, sizeof(hdr), _cache_fd);
+	return true;
+}
+
+void SVF_jtag::close_cache(const std::string &cache_name, bool success,
+		uint64_t svf_size, uint64_t svf_hash)
+{
+	if (!_cache_fd)
+		return;
+	if (success) {
+		svf_cache_hdr hdr = {};
+		memcpy(hdr.magic, SVF_CACHE_MAGIC, sizeof(hdr.magic));
+		hdr.version = SVF_CACHE_VERSION;
+		hdr.byte_order = SVF_CACHE_BYTE_ORDER;
+		hdr.cmd_size = sizeof(svf_cmd);
+		hdr.svf_size = svf_size;
+		hdr.svf_hash = svf_hash;
+		if (fseek(_cache_fd, 0, SEEK_SET) != 0 ||
+				fwrite(&hdr, 1, sizeof(hdr), _cache_fd) != sizeof(hdr))
+			success = false;
+	}
+	if (fclose(_cache_fd) != 0)
+		success = false;
+	_cache_fd = NULL;
+	if (!success)
+		remove(cache_name.c_str());
+}
+
+SVF_jtag::SVF_jtag(Jtag *jtag, bool verbose):_verbose(verbose),
+	_use_cache(false), _freq_hz(0),
+	_enddr(Jtag::RUN_TEST_IDLE), _endir(Jtag::RUN_TEST_IDLE),
+	_run_state(Jtag::RUN_TEST_IDLE), _end_state(Jtag::RUN_TEST_IDLE),
+	hdr(), hir(), sdr(), sir(), tdr(), tir(),
+	_start(NULL), _cur(NULL), _end(NULL), _lineno(0), _stmt_line(0),
+	_cache_fd(NULL), _err_line(0), _queue(SVF_QUEUE_LEN), _queue_head(0),
+	_queue_count(0), _queue_bytes(0), _queue_abort(false), _parse_done(false)
+{
+	_check_buf.reserve(SVF_CHECK_BUF_LEN);
 	_jtag = jtag;
 	_jtag->go_test_logic_reset();
 }
 
 SVF_jtag::~SVF_jtag() {}
 
-bool is_space(char x) {
-	return !!isspace(x);
-}
-/* Read SVF file line by line
- * concat continuous lines
+/* Map SVF file, split it in statements (until ';')
  * and pass instruction to handle_instruction
  */
 void SVF_jtag::parse(std::string filename)
 {
-	std::string str;
-	std::vector<std::string> vstr;
-	bool is_complete;
-	std::ifstream fs;
+	MappedFile fs;
 
-	fs.open(filename);
-	if (!fs.is_open()) {
+	if (!fs.open(filename)) {
 		std::cerr << "Error opening svf file " << filename << std::endl;
 		return;
 	}
-	unsigned int lineno = 0;
-	int lines_total = std::count(std::istreambuf_iterator<char>(fs),
-             std::istreambuf_iterator<char>(), '\n') + 1;
-	fs.clear();
-	fs.seekg(0,std::ios::beg);
-	printf("Reading %s with %d lines", filename.c_str(), lines_total);
 
-	ProgressBar progress("Writing SVF " + filename, lines_total, 50, _verbose);
+	uint64_t hash = 0;
+	const std::string cache_name = filename + "c";
+	if (_use_cache) {
+		hash = svf_hash(fs.data(), fs.size());
+		if (replay_cache(cache_name, fs.size(), hash)) {
+			std::cout << "end of SVF file" << std::endl;
+			return;
+		}
+		open_cache(cache_name);
+	}
+
+	printf("Reading %s (%zu Bytes)\n", filename.c_str(), fs.size());
+
+	ProgressBar progress("Writing SVF " + filename, fs.size(), 50, _verbose);
+
+	_start = _cur = fs.data();
+	_end = fs.data() + fs.size();
+	_lineno = 1;
+	_queue_head = _queue_count = _queue_bytes = 0;
+	_queue_abort = _parse_done = false;
+	_parse_error = nullptr;
+
+	/* scans are queued and TDO compared at flush_checks */
+	_jtag->setQueueMode(true);
+
+	/* parser thread lowers statements into commands, this thread
+	 * plays them
+	 */
+	std::thread parser(&SVF_jtag::parse_thread, this);
 
 	try	{
-		while (getline(fs, str)) {
-			if(str.empty()){
-				continue;
-			}
-			/* sanity check: DOS CR */
-			if (str.back() == '\r')
-				str.pop_back();
-			lineno++;
-			is_complete = false;
-			if (str[0] == '!')  // comment
-				continue;
-			if (str.back() == ';') {
-				str.pop_back();
-				is_complete = true;
-			}
-			replace_if(begin(str), end(str), is_space, ' ');
-			split_str(str, vstr);
-			if (is_complete) {
-				if (_verbose) {
-					if (vstr[0].compare("HDR") && vstr[0].compare("HIR")
-						&& vstr[0].compare("SDR") && vstr[0].compare("SIR")) {
-						for (auto &&word : vstr)
-							std::cout << word << " ";
-						std::cout << std::endl;
-					}
-				}
-				handle_instruction(vstr);
-				vstr.clear();
-			}
-			progress.display(lineno);
+		svf_slot *slot;
+		while ((slot = slot_front()) != NULL) {
+			svf_cmd cmd;
+			memcpy(&cmd, slot->data.data(), sizeof(svf_cmd));
+			_err_line = cmd.lineno;
+			run_cmd(cmd, slot->data.data() + sizeof(svf_cmd));
+			progress.display(slot->file_pos);
+			slot_release();
+		}
+		parser.join();
+		if (_parse_error) {
+			flush_checks();  // previous lines first
+			_err_line = _stmt_line;
+			std::rethrow_exception(_parse_error);
 		}
+		flush_checks();
 	}
 	catch (std::exception &e)
 	{
-		std::cerr << "Cannot proceed because of error(s) at line " << std::dec << lineno << std::endl;
+		if (parser.joinable()) {
+			{
+				std::lock_guard<std::mutex> lock(_queue_mutex);
+				_queue_abort = true;
+				_queue_not_full.notify_one();
+			}
+			parser.join();
+		}
+		std::cerr << "Cannot proceed because of error(s) at line " << std::dec
+			<< _err_line << std::endl;
 		progress.fail();
+		close_cache(cache_name, false, 0, 0);
+		_jtag->setQueueMode(false);
 		throw;
 	}
+	_jtag->setQueueMode(false);
 
+	close_cache(cache_name, true, fs.size(), hash);
 	progress.done();
 	std::cout << "end of SVF file" << std::endl;
 }
@@ -5,10 +5,16 @@
 
 #ifndef SRC_SVF_JTAG_HPP_
 #define SRC_SVF_JTAG_HPP_
+#include <stdint.h>
+#include <stdio.h>
+
+#include <condition_variable>
+#include <exception>
 #include <iostream>
+#include <mutex>
 #include <string>
+#include <string_view>
 #include <vector>
-#include <map>
 
 #include "jtag.hpp"
 
@@ -18,43 +24,87 @@ class SVF_jtag {
 	~SVF_jtag();
 	void parse(std::string filename);
 	void setVerbose(bool verbose) {_verbose = verbose;}
+	/*!
+	 * \brief enable compiled cache: parsed commands are stored in
+	 *        <filename>c (.svfc) and replayed, without parsing, as long
+	 *        as the SVF file content is unchanged
+	 */
+	void setCache(bool use_cache) {_use_cache = use_cache;}
 
 	private:
 	typedef struct {
 		uint32_t len;
-		std::string tdo;
-		std::string tdi;
-		std::string mask;
-		std::string smask;
+		bool has_tdo;
+		std::vector<uint8_t> tdo;
+		std::vector<uint8_t> tdi;
+		std::vector<uint8_t> mask;
+		std::vector<uint8_t> smask;
 	} svf_XYR;
 
-		void split_str(const std::string &str, std::vector<std::string> &vparse);
-		void clear_XYR(svf_XYR &t);
-		void parse_XYR(const std::vector<std::string> &vstr/*, svf_stat &svfs*/, svf_XYR &t);
-		void parse_runtest(const std::vector<std::string> &vstr);
-		void handle_instruction(const std::vector<std::string> &vstr);
-
-	std::map<std::string, uint8_t> fsm_state = {
-		{"RESET", 0},
-		{"IDLE", 1},
-		{"DRSELECT", 2},
-		{"DRCAPTURE", 3},
-		{"DRSHIFT", 4},
-		{"DREXIT1", 5},
-		{"DRPAUSE", 6},
-		{"DREXIT2", 7},
-		{"DRUPDATE", 8},
-		{"IRSELECT", 9},
-		{"IRCAPTURE", 10},
-		{"IRSHIFT", 11},
-		{"IREXIT1", 12},
-		{"IRPAUSE", 13},
-		{"IREXIT2", 14},
-		{"IRUPDATE", 15}
+	/* commands produced by the parser and executed by run_cmd */
+	enum svf_cmd_type {
+		SVF_CMD_SIR = 0,
+		SVF_CMD_SDR = 1,
+		SVF_CMD_STATE = 2,
+		SVF_CMD_RUNTEST = 3,
+		SVF_CMD_FREQUENCY = 4,
 	};
 
+	/*!
+	 * \brief command header. For scans it's followed by tdi and,
+	 *        when has_tdo is set, by tdo and mask ((len + 7) / 8 Bytes each)
+	 */
+	typedef struct {
+		uint8_t type;       /**< svf_cmd_type */
+		uint8_t has_tdo;    /**< scans: tdo and mask follow tdi */
+		uint8_t state;      /**< scans/STATE: end state, RUNTEST: run state */
+		uint8_t end_state;  /**< RUNTEST: end state */
+		uint32_t lineno;    /**< SVF line number */
+		uint32_t len;       /**< scans: length (bits), RUNTEST: clock count */
+		uint32_t reserved;
+		double value;       /**< FREQUENCY: Hz, RUNTEST: min duration (s) */
+	} svf_cmd;
+
+	/* lexer */
+	bool next_token(std::string_view &tok);
+	bool next_statement();
+
+	/* parser */
+	void parse_XYR(svf_XYR &t);
+	void parse_runtest();
+	void handle_instruction();
+	void display_XYR(const char *name, const svf_XYR &t);
+	void emit_scan(uint8_t type, const svf_XYR &t, Jtag::tapState_t end_state);
+	void emit_cmd(const svf_cmd &cmd);
+
+	/* parser -> player queue */
+	typedef struct {
+		std::vector<uint8_t> data;  /**< svf_cmd + payload */
+		size_t file_pos;            /**< parser position (progress) */
+	} svf_slot;
+	std::vector<uint8_t> &slot_acquire();
+	void slot_commit();
+	svf_slot *slot_front();
+	void slot_release();
+	void parse_thread();
+
+	/* player */
+	static size_t cmd_size(const svf_cmd &cmd);
+	void run_cmd(const svf_cmd &cmd, const uint8_t *payload);
+	void queue_check(const svf_cmd &cmd, const uint8_t *tdo,
+		const uint8_t *mask, uint8_t **rx);
+	void flush_checks();
+
+	/* compiled cache */
+	bool replay_cache(const std::string &cache_name, uint64_t svf_size,
+		uint64_t svf_hash);
+	bool open_cache(const std::string &cache_name);
+	void close_cache(const std::string &cache_name, bool success,
+		uint64_t svf_size, uint64_t svf_hash);
+
 	Jtag *_jtag;
 	bool _verbose;
+	bool _use_cache;
 
 	uint32_t _freq_hz;
 	Jtag::tapState_t _enddr;
@@ -67,5 +117,39 @@ class SVF_jtag {
 	svf_XYR sir;
 	svf_XYR tdr;
 	svf_XYR tir;
+
+	/* parser thread only (up to join) */
+	const char *_start;    /**< SVF content */
+	const char *_cur;      /**< lexer position in SVF content */
+	const char *_end;      /**< end of SVF content */
+	uint32_t _lineno;      /**< current line (lexer) */
+	uint32_t _stmt_line;   /**< first line of the current statement */
+	std::vector<std::string_view> _tokens;  /**< current statement */
+	FILE *_cache_fd;       /**< compiled cache being written */
+	std::exception_ptr _parse_error;
+
+	/* player only */
+	uint32_t _err_line;    /**< line of the command being played/checked */
+	/* deferred TDO checks: rx, tdo and mask ((len + 7) / 8 Bytes each)
+	 * are stored in _check_buf, rx is filled by the next Jtag flush
+	 */
+	typedef struct {
+		size_t offset;    /**< rx position in _check_buf */
+		uint32_t len;     /**< scan length (bits) */
+		uint32_t lineno;  /**< SVF line number */
+	} svf_check;
+	std::vector<uint8_t> _check_buf;
+	std::vector<svf_check> _checks;
+
+	/* bounded queue (ring of reusable slots), guarded by _queue_mutex */
+	std::vector<svf_slot> _queue;
+	size_t _queue_head;
+	size_t _queue_count;
+	size_t _queue_bytes;
+	bool _queue_abort;   /**< player failed: parser must stop */
+	bool _parse_done;    /**< no more commands */
+	std::mutex _queue_mutex;
+	std::condition_variable _queue_not_full;
+	std::condition_variable _queue_not_empty;
 };
 #endif  // SRC_SVF_JTAG_HPP_
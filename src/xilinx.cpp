@@ -329,6 +329,7 @@ Xilinx::Xilinx(Jtag *jtag, const std::string &filename,
 				 skip_reset),
 	_device_package(device_package), _spiOverJtagPath(spiOverJtagPath),
 	_irlen(6), _secondary_filename(secondary_filename), _soj_is_v2(false),
+	_soj_has_poll(false),
 	_jtag_chain_len(1), _is_bpi_board(!spi_flash_type)
 {
 	if (prg_type == Device::RD_FLASH) {
@@ -757,9 +758,12 @@ bool Xilinx::prepare_flash_access()
 
 	/* check SpiOverJtag version */
 	if (ret) {
-		if (get_spiOverJtag_version() == 2.0f)
+		const float soj_version = get_spiOverJtag_version();
+		if (soj_version >= 2.0f)
 			_soj_is_v2 = true;
-		printf("SOJ version: %f\n", _soj_is_v2 ? 2.0f : 1.0f);
+		if (soj_version >= 2.1f)
+			_soj_has_poll = true;
+		printf("SOJ version: %f\n", soj_version);
 	}
 	return ret;
 }
@@ -880,7 +884,7 @@ bool Xilinx::dumpFlash_bpi(uint32_t base_addr, uint32_t len)
 	if (len == 0)
 		len = _bpi_flash->capacity();
 	std::vector<uint8_t> buf(len);
-	printInfo("Reading BPI flash (slow, one word per USB round-trip)...");
+	printInfo("Reading BPI flash...");
 	if (!_bpi_flash->read(buf.data(), base_addr, len)) {
 		printError("BPI Flash read failed");
 		return false;
@@ -1637,8 +1641,7 @@ bool Xilinx::flow_program(JedParser *jed)
 			uint8_t mode = (ii == 14) ? 0x3 : 0x1;
 			int id = i * 15 + ii;
 
-			memcpy(wr_buf, jed->data_for_section(id)[0].c_str(),
-					_xc95_line_len);
+			memcpy(wr_buf, jed->section(id).row(0), _xc95_line_len);
 			wr_buf[_xc95_line_len] = (uint8_t) addr2&0xff;
 			wr_buf[_xc95_line_len+ 1 ] = (uint8_t)((addr2 >> 8) & 0xff);
 
@@ -1683,7 +1686,7 @@ bool Xilinx::flow_program(JedParser *jed)
 		for (size_t section = 0; section < nb_section; section++) {
 			for (size_t subsection = 0; subsection < 15; subsection++) {
 				int id = section * 15 + subsection;
-				std::string content = jed->data_for_section(id)[0];
+				const uint8_t *content = jed->section(id).row(0);
 				for (int col = 0; col < _xc95_line_len; col++, flash_pos++) {
 					if ((uint8_t)content[col] != (uint8_t)flash[flash_pos]) {
 						char error[256];
@@ -2337,6 +2340,9 @@ int Xilinx::spi_wait(uint8_t cmd, uint8_t mask, uint8_t cond,
 	const uint8_t shift = _jtag_chain_len;
 	uint8_t idx = 0;
 
+	if (_soj_has_poll)
+		return spi_wait_v2(cmd, mask, cond, timeout, verbose);
+
 	if (_soj_is_v2)
 		tx[idx++] = (0x2 << 1) | 1;
 	tx[idx++] = McsParser::reverseByte(cmd);
@@ -2373,10 +2379,158 @@ int Xilinx::spi_wait(uint8_t cmd, uint8_t mask, uint8_t cond,
 	}
 }
 
+/* minimal chunk length (bytes) used by SpiOverJtag v2 streaming transfers */
+#define SOJ_MIN_CHUNK_LEN 4096
+
+/* reverse bits order in each byte of a 64bits word */
+static inline uint64_t reverse_bits_in_bytes(uint64_t v)
+{
+	v = ((v >> 1) & 0x5555555555555555ULL) | ((v & 0x5555555555555555ULL) << 1);
+	v = ((v >> 2) & 0x3333333333333333ULL) | ((v & 0x3333333333333333ULL) << 2);
+	v = ((v >> 4) & 0x0F0F0F0F0F0F0F0FULL) | ((v & 0x0F0F0F0F0F0F0F0FULL) << 4);
+	return v;
+}
+
+/* dst[i] = reverseByte(src[i]) for len bytes */
+static void soj_reverse_buf(uint8_t *dst, const uint8_t *src, uint32_t len)
+{
+	uint32_t i = 0;
+	for (; i + 8 <= len; i += 8) {
+		uint64_t w;
+		memcpy(&w, src + i, 8);
+		w = reverse_bits_in_bytes(w);
+		memcpy(dst + i, &w, 8);
+	}
+	for (; i < len; i++)
+		dst[i] = McsParser::reverseByte(src[i]);
+}
+
+/* realign bytes received from the bridge: TDO is delayed by shift bits
+ * so each byte is built with raw[i] >> shift and the shift LSB of
+ * raw[i + 1], then bit reversed (SPI is MSB first).
+ * raw must contains len + 1 bytes. dst may be equal to raw.
+ */
+static void soj_realign_buf(uint8_t *dst, const uint8_t *raw, uint32_t len,
+		uint8_t shift)
+{
+	uint32_t i = 0;
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+	if (shift > 0 && shift < 8) {
+		for (; i + 8 <= len; i += 8) {
+			uint64_t w;
+			memcpy(&w, raw + i, 8);
+			w = (w >> shift) | (static_cast<uint64_t>(raw[i + 8]) << (64 - shift));
+			w = reverse_bits_in_bytes(w);
+			memcpy(dst + i, &w, 8);
+		}
+	}
+#endif
+	for (; i < len; i++)
+		dst[i] = McsParser::reverseByte(
+			(0xff & ((raw[i] >> shift) | (raw[i + 1] << (8 - shift)))));
+}
+
+int Xilinx::spi_read_v2(uint8_t cmd, const uint8_t *tx, uint8_t *rx,
+		uint32_t len)
+{
+	const uint8_t shift = _jtag_chain_len;
+	/* start bit + infinite mode: no length, transfer ends with update DR */
+	const uint8_t header[2] = {(0x2 << 1) | 1, McsParser::reverseByte(cmd)};
+	uint8_t pad = 0, tail[2];
+
+	uint32_t chunk_len = _jtag->get_ll_class()->get_buffer_size();
+	if (chunk_len < SOJ_MIN_CHUNK_LEN)
+		chunk_len = SOJ_MIN_CHUNK_LEN;
+	if (chunk_len > len)
+		chunk_len = len;
+	_soj_tx_buf.assign(chunk_len, 0);
+
+	/* addr BSCAN user1 */
+	_jtag->shiftIR(get_ircode(_ircode_map, _user_instruction), NULL, _irlen);
+	_jtag->shiftDR(header, NULL, 16, Jtag::SHIFT_DR);
+
+	for (uint32_t pos = 0; pos < len; pos += chunk_len) {
+		const uint32_t xfer_len = (len - pos < chunk_len) ? len - pos : chunk_len;
+		if (tx)
+			soj_reverse_buf(_soj_tx_buf.data(), tx + pos, xfer_len);
+		_jtag->shiftDR(_soj_tx_buf.data(), rx + pos, 8 * xfer_len,
+			Jtag::SHIFT_DR);
+	}
+	/* last byte needs shift bits more */
+	_jtag->shiftDR(&pad, &tail[1], 8);
+	_jtag->go_test_logic_reset();
+	_jtag->flush();
+
+	/* rx[len-1] must be computed before being overwritten */
+	tail[0] = rx[len - 1];
+	soj_realign_buf(rx, rx, len - 1, shift);
+	soj_realign_buf(&rx[len - 1], tail, 1, shift);
+
+	return 0;
+}
+
+/* first SpiOverJtag poll length (bytes), doubled after each flag read */
+#define SOJ_POLL_MIN_LEN 64
+
+int Xilinx::spi_wait_v2(uint8_t cmd, uint8_t mask, uint8_t cond,
+		uint32_t timeout, bool verbose)
+{
+	/* start bit + poll mode, secondary header: mask and cond, then cmd */
+	const uint8_t header[4] = {(0x3 << 1) | 1, mask, cond,
+		McsParser::reverseByte(cmd)};
+	uint8_t pad = 0, done = 0;
+	uint32_t count = 0;
+
+	uint32_t max_len = _jtag->get_ll_class()->get_buffer_size();
+	if (max_len < SOJ_MIN_CHUNK_LEN)
+		max_len = SOJ_MIN_CHUNK_LEN;
+	uint32_t poll_len = SOJ_POLL_MIN_LEN;
+	_soj_tx_buf.assign(max_len, 0);
+
+	_jtag->shiftIR(get_ircode(_ircode_map, _user_instruction), NULL, _irlen);
+	_jtag->shiftDR(header, NULL, 8 * 4, Jtag::SHIFT_DR);
+
+	/* bridge compares one status byte every 8 TCK: TDO is the sticky
+	 * completion flag. Poll window grows until cable buffer size to
+	 * keep short waits (WEL) fast and long ones (erase) cheap.
+	 * timeout is a number of status register reads (as for v1): each
+	 * polled byte counts as one read
+	 */
+	do {
+		if (poll_len > timeout - count)
+			poll_len = timeout - count;
+		if (poll_len > 0)
+			_jtag->shiftDR(_soj_tx_buf.data(), NULL, 8 * poll_len,
+				Jtag::SHIFT_DR);
+		_jtag->shiftDR(&pad, &done, 8, Jtag::SHIFT_DR);
+		_jtag->flush();
+		count += poll_len + 1;
+		if (verbose)
+			printf("%x %x %u %u %02x\n", mask, cond, count, poll_len, done);
+		if (poll_len < max_len)
+			poll_len = (2 * poll_len > max_len) ? max_len : 2 * poll_len;
+	} while (done == 0 && count < timeout);
+
+	_jtag->shiftDR(&pad, NULL, 8);
+	_jtag->go_test_logic_reset();
+	_jtag->flush();
+
+	if (done == 0) {
+		std::cout << "wait: Error" << std::endl;
+		return -ETIME;
+	}
+	return 0;
+}
+
 int Xilinx::spi_put_v2(uint8_t cmd, const uint8_t *tx, uint8_t *rx,
 		uint32_t len)
 {
 	const uint32_t real_len = len + 1;  // rx/tx length + cmd
+
+	/* large read (flash dump/verify): stream it */
+	if (rx && real_len > 32)
+		return spi_read_v2(cmd, tx, rx, len);
+
 	uint32_t kPktLen = real_len + 2;  // One header and +1 due to the needs of an additional bit/byte
 	uint8_t mode = 0x01;
 	if (real_len > 32) {
@@ -176,6 +176,31 @@ class Xilinx: public Device, FlashInterface {
 		/* SpiOverJtag v2 specifics methods */
 		int spi_put_v2(uint8_t cmd, const uint8_t *tx, uint8_t *rx,
 				uint32_t len);
+		/*!
+		 * \brief SpiOverJtag v2 streaming transfer: send a header in
+		 *        infinite mode followed by the command, then shift len
+		 *        bytes by chunks sized from the cable buffer. TDO is
+		 *        written directly into rx and realigned in place
+		 * \param[in] cmd: SPI command
+		 * \param[in] tx: bytes to send after cmd (may be NULL)
+		 * \param[out] rx: buffer to fill (len bytes)
+		 * \param[in] len: number of bytes to send/receive (cmd not comprise)
+		 * \return 0 when success
+		 */
+		int spi_read_v2(uint8_t cmd, const uint8_t *tx, uint8_t *rx,
+				uint32_t len);
+		/*!
+		 * \brief SpiOverJtag v2.1 status polling: the bridge reads
+		 *        register continuously and compares it with mask/cond.
+		 *        Host only shifts long DR and reads completion flag
+		 * \param[in] cmd: register to read
+		 * \param[in] mask: mask used with read byte
+		 * \param[in] cond: condition to wait
+		 * \param[in] timeout: number of flag read before fail
+		 * \return 0 when success, -ETIME when timeout occur
+		 */
+		int spi_wait_v2(uint8_t cmd, uint8_t mask, uint8_t cond,
+				uint32_t timeout, bool verbose);
 
 	protected:
 		/*!
@@ -277,6 +302,8 @@ class Xilinx: public Device, FlashInterface {
 		int _flash_chips; /* bitfield to select the target in boards with two flash chips */
 		std::string _user_instruction; /* which USER bscan instruction to interface with SPI */
 		bool _soj_is_v2; /* SpiOverJtag version (1.0 or 2.0) */
+		bool _soj_has_poll; /* SpiOverJtag >= 2.1: bridge side status polling */
+		std::vector<uint8_t> _soj_tx_buf; /* SpiOverJtag v2 stream chunk */
 		uint32_t _jtag_chain_len; /* Jtag Chain Length */
 		bool _is_bpi_board; /* true if board uses BPI parallel flash */
 		std::unique_ptr<BPIFlash> _bpi_flash; /* BPI flash instance */
@@ -98,7 +98,6 @@ int XilinxMapParser::parse()
  */
 bool XilinxMapParser::jedApplyMap()
 {
-	std::string listfuse = _jed->get_fuselist();
 	std::string tmp;
 	int row = 0;
 
@@ -119,7 +118,7 @@ bool XilinxMapParser::jedApplyMap()
 					bit_val = 1;
 					break;
 				default:  // map_val is an offset: get bit value from jed
-					bit_val = listfuse[map_val] - '0';
+					bit_val = _jed->get_fuse(map_val);
 			}
 			tmp += bit_val;
 			_bit_length++;
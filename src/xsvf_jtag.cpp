@@ -0,0 +1,392 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+ * Copyright (C) 2019-2022 Gwenhael Goavec-Merou <gwenhael.goavec-merou@trabucayre.com>
+ */
+
+#include "xsvf_jtag.hpp"
+
+#include <string.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "display.hpp"
+#include "jtag.hpp"
+#include "progressBar.hpp"
+
+/* XSVF instructions (XAPP503) */
+#define XCOMPLETE    0x00
+#define XTDOMASK     0x01
+#define XSIR         0x02
+#define XSDR         0x03
+#define XRUNTEST     0x04
+#define XREPEAT      0x07
+#define XSDRSIZE     0x08
+#define XSDRTDO      0x09
+#define XSETSDRMASKS 0x0A
+#define XSDRINC      0x0B
+#define XSDRB        0x0C
+#define XSDRC        0x0D
+#define XSDRE        0x0E
+#define XSDRTDOB     0x0F
+#define XSDRTDOC     0x10
+#define XSDRTDOE     0x11
+#define XSTATE       0x12
+#define XENDIR       0x13
+#define XENDDR       0x14
+#define XSIR2        0x15
+#define XCOMMENT     0x16
+#define XWAIT        0x17
+
+/* deferred TDO checks storage: scans are sent when it's full */
+#define XSVF_CHECK_BUF_LEN (1 << 20)
+
+XSVF_jtag::XSVF_jtag(Jtag *jtag, bool verbose): _jtag(jtag),
+	_verbose(verbose), _pos(0), _cmd_pos(0), _sdr_size(0), _max_repeat(0),
+	_runtest(0), _enddr(Jtag::RUN_TEST_IDLE), _endir(Jtag::RUN_TEST_IDLE)
+{
+	_check_buf.reserve(XSVF_CHECK_BUF_LEN);
+	_jtag->go_test_logic_reset();
+}
+
+XSVF_jtag::~XSVF_jtag() {}
+
+uint8_t XSVF_jtag::get_u8()
+{
+	if (_pos >= _data.size())
+		throw std::runtime_error("Error: unexpected end of XSVF file");
+	return _data[_pos++];
+}
+
+uint16_t XSVF_jtag::get_u16()
+{
+	uint16_t val = get_u8() << 8;
+	return val | get_u8();
+}
+
+uint32_t XSVF_jtag::get_u32()
+{
+	uint32_t val = 0;
+	for (int i = 0; i < 4; i++)
+		val = (val << 8) | get_u8();
+	return val;
+}
+
+void XSVF_jtag::get_vector(std::vector<uint8_t> &out, uint32_t bits)
+{
+	const size_t byte_len = (bits + 7) / 8;
+	if (_pos + byte_len > _data.size())
+		throw std::runtime_error("Error: unexpected end of XSVF file");
+	out.resize(byte_len);
+	/* first byte in file is the most significant one */
+	for (size_t i = 0; i < byte_len; i++)
+		out[i] = _data[_pos + byte_len - 1 - i];
+	_pos += byte_len;
+}
+
+void XSVF_jtag::wait(uint32_t usec)
+{
+	if (usec == 0)
+		return;
+	/* at least one TCK per microsecond (XAPP058 reference player),
+	 * and the full delay whatever the frequency
+	 */
+	_jtag->toggleClk(usec);
+	flush_checks();
+	usleep(usec);
+}
+
+bool XSVF_jtag::compare(uint32_t len, const uint8_t *rx, const uint8_t *tdo,
+		const uint8_t *mask)
+{
+	const size_t byte_len = (len + 7) / 8;
+	/* bits above len are not part of the scan */
+	const uint8_t last_mask = (len % 8) ? (1 << (len % 8)) - 1 : 0xff;
+	for (size_t i = 0; i < byte_len; i++) {
+		uint8_t m = mask[i];
+		if (i == byte_len - 1)
+			m &= last_mask;
+		if ((rx[i] ^ tdo[i]) & m)
+			return false;
+	}
+	return true;
+}
+
+void XSVF_jtag::report_mismatch(uint32_t len, const uint8_t *rx,
+		const uint8_t *tdo, size_t cmd_pos)
+{
+	const int byte_len = (len + 7) / 8;
+	std::cerr << "TDO value ";
+	for (int j = byte_len - 1; j >= 0; j--)
+		std::cerr << std::uppercase << std::hex << std::setw(2)
+			<< std::setfill('0') << int(rx[j]);
+	std::cerr << " isn't the one expected: ";
+	for (int j = byte_len - 1; j >= 0; j--)
+		std::cerr << std::uppercase << std::hex << std::setw(2)
+			<< std::setfill('0') << int(tdo[j]);
+	std::cerr << " (offset 0x" << cmd_pos << ")" << std::dec << std::endl;
+}
+
+/* store expected TDO and mask and reserve rx space. Jtag is in queued
+ * mode: rx must stay at the same address until flush_checks
+ */
+void XSVF_jtag::queue_check(uint32_t len, const uint8_t *tdo,
+		const uint8_t *mask, uint8_t **rx)
+{
+	const size_t byte_len = (len + 7) / 8;
+	size_t offset = _check_buf.size();
+	if (offset + 3 * byte_len > _check_buf.capacity()) {
+		flush_checks();
+		offset = 0;
+		if (3 * byte_len > _check_buf.capacity())
+			_check_buf.reserve(3 * byte_len);
+	}
+	_check_buf.resize(offset + 3 * byte_len, 0);
+	memcpy(_check_buf.data() + offset + byte_len, tdo, byte_len);
+	memcpy(_check_buf.data() + offset + 2 * byte_len, mask, byte_len);
+	_checks.push_back({offset, len, _cmd_pos});
+	*rx = _check_buf.data() + offset;
+}
+
+/* send queued scans and compare TDO with expected values */
+void XSVF_jtag::flush_checks()
+{
+	_jtag->flush();
+
+	for (auto &&chk : _checks) {
+		const size_t byte_len = (chk.len + 7) / 8;
+		const uint8_t *rx = _check_buf.data() + chk.offset;
+		const uint8_t *tdo = rx + byte_len;
+		if (!compare(chk.len, rx, tdo, tdo + byte_len)) {
+			report_mismatch(chk.len, rx, tdo, chk.cmd_pos);
+			_cmd_pos = chk.cmd_pos;
+			_checks.clear();
+			_check_buf.clear();
+			throw std::runtime_error("Error: TDO mismatch");
+		}
+	}
+	_checks.clear();
+	_check_buf.clear();
+}
+
+void XSVF_jtag::shift(bool is_ir, uint32_t len, const uint8_t *tdi,
+		const uint8_t *tdo, const uint8_t *mask, Jtag::tapState_t end_state,
+		uint32_t runtest, uint8_t max_repeat)
+{
+	/* XSVF 2.00 compatibility: no shift, only wait in Run-Test/Idle */
+	if (len == 0) {
+		if (runtest) {
+			_jtag->set_state(Jtag::RUN_TEST_IDLE);
+			wait(runtest);
+		}
+		return;
+	}
+
+	bool may_retry = !is_ir && tdo && runtest && max_repeat;
+	if (may_retry) {
+		/* nothing to compare: no retry possible */
+		may_retry = false;
+		for (size_t i = 0; i < (len + 7) / 8 && !may_retry; i++)
+			may_retry = mask[i] != 0;
+	}
+
+	/* no retry: scan is queued and TDO compared later */
+	if (!may_retry) {
+		uint8_t *rx = NULL;
+		if (tdo)
+			queue_check(len, tdo, mask, &rx);
+		if (is_ir)
+			_jtag->shiftIR(tdi, rx, len, end_state);
+		else
+			_jtag->shiftDR(tdi, rx, len, end_state);
+		if (runtest) {
+			_jtag->set_state(Jtag::RUN_TEST_IDLE);
+			wait(runtest);
+		}
+		return;
+	}
+
+	/* retry needs TDO before next scan */
+	flush_checks();
+	_rx.assign((len + 7) / 8, 0);
+	uint8_t repeat = 0;
+	bool match;
+	do {
+		_jtag->shiftDR(tdi, _rx.data(), len, Jtag::EXIT1_DR);
+		_jtag->flush();
+		match = compare(len, _rx.data(), tdo, mask);
+		if (!match && repeat < max_repeat) {
+			/* exception handling: Pause-DR -> Shift-DR (one extra
+			 * bit) and wait 25% longer
+			 */
+			_jtag->set_state(Jtag::PAUSE_DR);
+			_jtag->set_state(Jtag::SHIFT_DR);
+			runtest += runtest >> 2;
+			if (_verbose)
+				printWarn("XSVF: TDO mismatch, retry " +
+					std::to_string(repeat + 1));
+		} else {
+			_jtag->set_state(end_state);
+		}
+		_jtag->set_state(Jtag::RUN_TEST_IDLE);
+		wait(runtest);
+	} while (!match && repeat++ < max_repeat);
+
+	if (!match) {
+		report_mismatch(len, _rx.data(), tdo, _cmd_pos);
+		throw std::runtime_error("Error: TDO mismatch");
+	}
+}
+
+void XSVF_jtag::handle_instruction(uint8_t cmd)
+{
+	switch (cmd) {
+	case XTDOMASK:
+		get_vector(_tdo_mask, _sdr_size);
+		break;
+	case XSIR:
+	case XSIR2: {
+		const uint32_t len = (cmd == XSIR) ? get_u8() : get_u16();
+		get_vector(_tdi, len);
+		shift(true, len, _tdi.data(), NULL, NULL, _endir, _runtest, 0);
+		break;
+	}
+	case XSDR:
+		/* compared with last XSDRTDO value */
+		get_vector(_tdi, _sdr_size);
+		shift(false, _sdr_size, _tdi.data(), _tdo.data(), _tdo_mask.data(),
+			_enddr, _runtest, _max_repeat);
+		break;
+	case XSDRTDO:
+		get_vector(_tdi, _sdr_size);
+		get_vector(_tdo, _sdr_size);
+		shift(false, _sdr_size, _tdi.data(), _tdo.data(), _tdo_mask.data(),
+			_enddr, _runtest, _max_repeat);
+		break;
+	case XRUNTEST:
+		_runtest = get_u32();
+		break;
+	case XREPEAT:
+		_max_repeat = get_u8();
+		break;
+	case XSDRSIZE:
+		_sdr_size = get_u32();
+		_tdo.assign((_sdr_size + 7) / 8, 0);
+		_tdo_mask.assign((_sdr_size + 7) / 8, 0);
+		_full_mask.assign((_sdr_size + 7) / 8, 0xff);
+		break;
+	case XSETSDRMASKS:
+		get_vector(_addr_mask, _sdr_size);
+		get_vector(_data_mask, _sdr_size);
+		break;
+	case XSDRB:
+	case XSDRC:
+	case XSDRE:
+	case XSDRTDOB:
+	case XSDRTDOC:
+	case XSDRTDOE: {
+		/* split DR shift: begin/continue stay in Shift-DR */
+		const bool has_tdo = (cmd >= XSDRTDOB);
+		const uint8_t step = cmd - ((has_tdo) ? XSDRTDOB : XSDRB);
+		get_vector(_tdi, _sdr_size);
+		if (has_tdo)
+			get_vector(_tdo, _sdr_size);
+		shift(false, _sdr_size, _tdi.data(),
+			(has_tdo) ? _tdo.data() : NULL, _full_mask.data(),
+			(step == 2) ? _enddr : Jtag::SHIFT_DR, 0, 0);
+		break;
+	}
+	case XSTATE: {
+		const uint8_t state = get_u8();
+		if (state > Jtag::UPDATE_IR)
+			throw std::runtime_error("Error: XSTATE: invalid state");
+		/* Test-Logic-Reset is always forced */
+		if (state == Jtag::TEST_LOGIC_RESET)
+			_jtag->go_test_logic_reset();
+		else
+			_jtag->set_state((Jtag::tapState_t)state);
+		break;
+	}
+	case XENDIR:
+		_endir = (get_u8()) ? Jtag::PAUSE_IR : Jtag::RUN_TEST_IDLE;
+		break;
+	case XENDDR:
+		_enddr = (get_u8()) ? Jtag::PAUSE_DR : Jtag::RUN_TEST_IDLE;
+		break;
+	case XCOMMENT: {
+		const size_t start = _pos;
+		while (get_u8() != 0) {}
+		if (_verbose)
+			printInfo(std::string(reinterpret_cast<const char *>(
+				_data.data() + start)));
+		break;
+	}
+	case XWAIT: {
+		const uint8_t wait_state = get_u8();
+		const uint8_t end_state = get_u8();
+		const uint32_t usec = get_u32();
+		if (wait_state > Jtag::UPDATE_IR || end_state > Jtag::UPDATE_IR)
+			throw std::runtime_error("Error: XWAIT: invalid state");
+		_jtag->set_state((Jtag::tapState_t)wait_state);
+		wait(usec);
+		_jtag->set_state((Jtag::tapState_t)end_state);
+		break;
+	}
+	case XSDRINC:
+		throw std::runtime_error("Error: XSDRINC is not supported");
+	default: {
+		char mess[64];
+		snprintf(mess, sizeof(mess), "Error: unknown XSVF instruction 0x%02x",
+			cmd);
+		throw std::runtime_error(mess);
+	}
+	}
+}
+
+void XSVF_jtag::parse(const std::string &filename)
+{
+	std::ifstream fs(filename, std::ios::in | std::ios::binary);
+	if (!fs.is_open()) {
+		printError("Error opening xsvf file " + filename);
+		throw std::runtime_error("Error opening xsvf file");
+	}
+	_data.assign(std::istreambuf_iterator<char>(fs),
+		std::istreambuf_iterator<char>());
+	fs.close();
+
+	printf("Reading %s (%zu Bytes)\n", filename.c_str(), _data.size());
+
+	ProgressBar progress("Writing XSVF " + filename, _data.size(), 50,
+		_verbose);
+
+	_pos = 0;
+	/* scans are queued and TDO compared at flush_checks */
+	_jtag->setQueueMode(true);
+
+	try {
+		while (true) {
+			_cmd_pos = _pos;
+			const uint8_t cmd = get_u8();
+			if (cmd == XCOMPLETE)
+				break;
+			handle_instruction(cmd);
+			progress.display(_pos);
+		}
+		flush_checks();
+	} catch (std::exception &e) {
+		std::cerr << "Cannot proceed because of error(s) at offset 0x"
+			<< std::hex << _cmd_pos << std::dec << std::endl;
+		progress.fail();
+		_jtag->setQueueMode(false);
+		throw;
+	}
+	_jtag->setQueueMode(false);
+
+	progress.done();
+	std::cout << "end of XSVF file" << std::endl;
+}
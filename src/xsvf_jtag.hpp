@@ -0,0 +1,92 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+ * Copyright (C) 2019-2022 Gwenhael Goavec-Merou <gwenhael.goavec-merou@trabucayre.com>
+ */
+
+#ifndef SRC_XSVF_JTAG_HPP_
+#define SRC_XSVF_JTAG_HPP_
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "jtag.hpp"
+
+/*!
+ * \brief XSVF (Xilinx XAPP503 binary SVF) player
+ */
+class XSVF_jtag {
+ public:
+	XSVF_jtag(Jtag *jtag, bool verbose);
+	~XSVF_jtag();
+	/*!
+	 * \brief read and play an XSVF file
+	 * \param[in] filename: XSVF file
+	 * throw an exception on error (TDO mismatch, malformed file)
+	 */
+	void parse(const std::string &filename);
+	void setVerbose(bool verbose) {_verbose = verbose;}
+
+ private:
+	/* decoder: values are big endian */
+	uint8_t get_u8();
+	uint16_t get_u16();
+	uint32_t get_u32();
+	/*!
+	 * \brief read a bits long vector (MSB first in file)
+	 *        and store it LSB first in out
+	 */
+	void get_vector(std::vector<uint8_t> &out, uint32_t bits);
+
+	void handle_instruction(uint8_t cmd);
+	/*!
+	 * \brief shift IR/DR from Run-Test/Idle (or current shift state)
+	 *        compare TDO with tdo/mask (when not NULL), retry
+	 *        (XREPEAT) with XRUNTEST delay when they mismatch
+	 */
+	void shift(bool is_ir, uint32_t len, const uint8_t *tdi,
+		const uint8_t *tdo, const uint8_t *mask,
+		Jtag::tapState_t end_state, uint32_t runtest, uint8_t max_repeat);
+	/*!
+	 * \brief clock TCK and wait at least usec microseconds
+	 */
+	void wait(uint32_t usec);
+
+	/* deferred TDO checks (same scheme as SVF_jtag) */
+	void queue_check(uint32_t len, const uint8_t *tdo, const uint8_t *mask,
+		uint8_t **rx);
+	void flush_checks();
+	static bool compare(uint32_t len, const uint8_t *rx, const uint8_t *tdo,
+		const uint8_t *mask);
+	void report_mismatch(uint32_t len, const uint8_t *rx, const uint8_t *tdo,
+		size_t cmd_pos);
+
+	Jtag *_jtag;
+	bool _verbose;
+
+	std::vector<uint8_t> _data;  /**< XSVF content */
+	size_t _pos;                 /**< decoder position */
+	size_t _cmd_pos;             /**< current command position */
+
+	uint32_t _sdr_size;          /**< XSDRSIZE (bits) */
+	uint8_t _max_repeat;         /**< XREPEAT */
+	uint32_t _runtest;           /**< XRUNTEST (us) */
+	Jtag::tapState_t _enddr;
+	Jtag::tapState_t _endir;
+	std::vector<uint8_t> _tdi;
+	std::vector<uint8_t> _tdo;       /**< last XSDRTDO expected value */
+	std::vector<uint8_t> _tdo_mask;  /**< XTDOMASK */
+	std::vector<uint8_t> _addr_mask; /**< XSETSDRMASKS */
+	std::vector<uint8_t> _data_mask; /**< XSETSDRMASKS */
+	std::vector<uint8_t> _full_mask; /**< all ones (XSDRTDOx) */
+	std::vector<uint8_t> _rx;
+
+	typedef struct {
+		size_t offset;   /**< rx position in _check_buf */
+		uint32_t len;    /**< scan length (bits) */
+		size_t cmd_pos;  /**< XSVF command offset */
+	} xsvf_check;
+	std::vector<uint8_t> _check_buf;
+	std::vector<xsvf_check> _checks;
+};
+#endif  // SRC_XSVF_JTAG_HPP_
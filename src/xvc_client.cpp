@@ -6,7 +6,9 @@
 #include "xvc_client.hpp"
 
 #include <arpa/inet.h>
+#include <errno.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <stdio.h>
@@ -25,19 +27,38 @@
 
 #include "display.hpp"
 
+/* largest vector length (TMS + TDI, in Byte) accepted from getinfo: */
+#define XVC_MAX_VECTOR_LEN (1 << 20)
+/* answer bytes allowed in flight before waiting for the server: keep it
+ * below socket buffers capacity to avoid a deadlock with servers that
+ * block on write
+ */
+#define XVC_MAX_INFLIGHT (1 << 17)
+#define XVC_SHIFT_HDR_LEN 10  // "shift:" + num bits
 
 XVC_client::XVC_client(const std::string &ip_addr, int port,
 		uint32_t clkHz, int8_t verbose):
 	_verbose(verbose > 0), _xfer_buf(NULL), _tms(NULL), _tditdo(NULL),
-	_num_bits(0), _last_tms(0), _last_tdi(0), _buffer_size(0), _sock(0),
-	_port(port)
+	_num_bits(0), _last_tms(0), _last_tdi(0), _buffer_size(0),
+	_inflight(0), _reply_pos(0), _sock(0), _port(port)
 {
 	if (!open_connection(ip_addr))
 		throw std::runtime_error("connection failure");
 
-	uint8_t buffer[2048];
-	if (xfer_pkt("getinfo:", NULL, 0, buffer, 2048) <= 0)
+	/* answer is "xvcServer_v1.0:<max vector len>\n": may be
+	 * received in more than one chunk
+	 */
+	char buffer[2048];
+	if (xfer_pkt("getinfo:", NULL, 0, NULL, 0) < 0)
 		throw std::runtime_error("can't read info");
+	size_t pos = 0;
+	while (pos < sizeof(buffer) - 1 && (pos == 0 || buffer[pos - 1] != '\n')) {
+		ssize_t ret = recv(_sock, buffer + pos, sizeof(buffer) - 1 - pos, 0);
+		if (ret <= 0)
+			throw std::runtime_error("can't read info");
+		pos += ret;
+	}
+	buffer[pos] = '\0';
 
 	std::regex r("[_:]");
 	std::string rep((const char *)buffer);
@@ -50,10 +71,16 @@ XVC_client::XVC_client(const std::string &ip_addr, int port,
 
 	_server_name = std::move(toto[0]);
 	_server_vers = std::move(toto[1]);
-	_buffer_size = stoi(toto[2]) / 2;  // buffer_size is for tms + tdi
+	/* use the largest vector supported by the server */
+	uint32_t vector_len = std::stoul(toto[2]);
+	if (vector_len < 2)
+		throw std::runtime_error("wrong getinfo: vector length");
+	if (vector_len > XVC_MAX_VECTOR_LEN)
+		vector_len = XVC_MAX_VECTOR_LEN;
+	_buffer_size = vector_len / 2;  // buffer_size is for tms + tdi
 
 	_xfer_buf = reinterpret_cast<uint8_t *>(malloc(sizeof(uint8_t)
-				* ((2*_buffer_size) + 4)));
+				* ((2*_buffer_size) + XVC_SHIFT_HDR_LEN)));
 	_tms = reinterpret_cast<uint8_t *>(malloc(sizeof(uint8_t) * _buffer_size));
 	_tditdo = reinterpret_cast<uint8_t *>(malloc(sizeof(uint8_t) *
 				_buffer_size));
@@ -71,8 +98,8 @@ XVC_client::XVC_client(const std::string &ip_addr, int port,
 
 XVC_client::~XVC_client()
 {
-	// flush buffers before quit
-	if (_num_bits != 0)
+	// flush buffers and wait for pending answers before quit
+	if (_num_bits != 0 || !_pending.empty())
 		flush();
 
 	// cleanup
@@ -126,8 +153,8 @@ int XVC_client::writeTDI(const uint8_t *tx, uint8_t *rx, uint32_t len, bool end)
 {
 	if (len == 0)  // nothing to do
 		return 0;
-	if (_num_bits != 0)  // flush buffer to simplify next step
-		flush();
+	if (_num_bits != 0 && !ll_write(NULL))  // send buffer to simplify next step
+		throw std::runtime_error("xvc ll_write fails");
 
 	uint32_t xfer_len = _buffer_size * 8;  // default to buffer capacity
 	uint8_t tms = (_last_tms) ? 0xff : 0x00;  // set tms byte
@@ -138,13 +165,13 @@ int XVC_client::writeTDI(const uint8_t *tx, uint8_t *rx, uint32_t len, bool end)
 	for (uint32_t rest = 0; rest < len; rest += xfer_len) {
 		if ((xfer_len + rest) > len)  // len < buffer size
 			xfer_len = len - rest;  // reduce xfer len
-		uint16_t tt = (xfer_len + 7) >> 3;  // convert to Byte
+		uint32_t tt = (xfer_len + 7) >> 3;  // convert to Byte
 		memset(_tms, tms, tt);  // fill tms buffer
 		memcpy(_tditdo, tx_ptr, tt);  // fill tdi buffer
 		_num_bits = xfer_len;  // set buffer size in bit
 		if (end && xfer_len + rest == len) {  // last sequence: set tms 1
 			_last_tms = 1;
-			uint16_t idx = _num_bits - 1;
+			uint32_t idx = _num_bits - 1;
 			_tms[(idx >> 3)] |= (1 << (idx & 0x07));
 		}
 		if(!ll_write((rx) ? rx_ptr : NULL))  // write
@@ -155,6 +182,10 @@ int XVC_client::writeTDI(const uint8_t *tx, uint8_t *rx, uint32_t len, bool end)
 			rx_ptr += tt;
 	}
 
+	/* bursts are pipelined: only wait when TDO is requested */
+	if (rx && !sync())
+		throw std::runtime_error("xvc ll_write fails");
+
 	return len;
 }
 
@@ -164,8 +195,8 @@ int XVC_client::toggleClk(uint8_t tms, uint8_t tdi, uint32_t clk_len)
 	// nothing to do
 	if (clk_len == 0)
 		return 0;
-	if (_num_bits != 0)
-		flush();
+	if (_num_bits != 0 && !ll_write(NULL))
+		throw std::runtime_error("xvc ll_write fails");
 
 	_last_tms = tms;
 	_last_tdi = tdi;
@@ -174,10 +205,6 @@ int XVC_client::toggleClk(uint8_t tms, uint8_t tdi, uint32_t clk_len)
 
 	uint32_t len = clk_len;
 
-	// flush buffer before starting
-	if (_num_bits != 0)
-		flush();
-
 	memset(_tditdo, curr_tdi, _buffer_size);
 	memset(_tms, curr_tms, _buffer_size);
 	do {
@@ -192,14 +219,48 @@ int XVC_client::toggleClk(uint8_t tms, uint8_t tdi, uint32_t clk_len)
 	return clk_len;
 }
 
+bool XVC_client::writeTMSTDI(const uint8_t *tms, const uint8_t *tdi,
+		uint8_t *tdo, uint32_t len)
+{
+	if (len == 0)
+		return true;
+	if (_num_bits != 0 && !ll_write(NULL))
+		return false;
+
+	const uint32_t max_bits = _buffer_size * 8;
+	for (uint32_t pos = 0; pos < len; pos += max_bits) {
+		const uint32_t offset = pos >> 3;  // max_bits is a multiple of 8
+		_num_bits = (len - pos > max_bits) ? max_bits : len - pos;
+		const uint32_t tt = (_num_bits + 7) >> 3;
+		memcpy(_tms, tms + offset, tt);
+		memcpy(_tditdo, tdi + offset, tt);
+		if (!ll_write((tdo) ? tdo + offset : NULL))
+			return false;
+	}
+
+	const uint32_t last = len - 1;
+	_last_tms = (tms[last >> 3] >> (last & 0x07)) & 0x01;
+	_last_tdi = (tdi[last >> 3] >> (last & 0x07)) & 0x01;
+
+	return (tdo) ? sync() : true;
+}
+
 int XVC_client::flush()
 {
-	return ll_write(NULL);
+	if (!ll_write(NULL) || !sync())
+		return 0;
+	return 1;
 }
 
 
 int XVC_client::setClkFreq(uint32_t clkHz)
 {
+	/* settck: answer comes after all pending shift: answers */
+	if (!sync()) {
+		printError("setClkFreq: fail to receive pending answers");
+		return -EXIT_FAILURE;
+	}
+
 	double clk_periodf = (1e9 / clkHz);
 	uint32_t clk_period = (uint32_t)floor(clk_periodf);
 
@@ -241,6 +302,11 @@ bool XVC_client::open_connection(const std::string &ip_addr)
 		return false;
 	}
 
+	/* commands are pipelined: don't delay small packets */
+	int flag = 1;
+	if (setsockopt(_sock, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag)) < 0)
+		printWarn("Unable to set TCP_NODELAY");
+
 	return true;
 }
 
@@ -321,25 +387,76 @@ ssize_t XVC_client::xfer_pkt(const std::string &instr,
 
 bool XVC_client::ll_write(uint8_t *tdo)
 {
-	int ret;
 	if (_num_bits == 0)
 		return true;
 	uint32_t numbytes = (_num_bits + 7) >> 3;
 
-	_xfer_buf[0] = static_cast<uint8_t>((_num_bits >>  0) & 0xff);
-	_xfer_buf[1] = static_cast<uint8_t>((_num_bits >>  8) & 0xff);
-	_xfer_buf[2] = static_cast<uint8_t>((_num_bits >> 16) & 0xff);
-	_xfer_buf[3] = static_cast<uint8_t>((_num_bits >> 24) & 0xff);
-	memcpy(_xfer_buf + 4, _tms, numbytes);
-	memcpy(_xfer_buf + 4 + numbytes, _tditdo, numbytes);
+	/* limit answers in flight: wait for the oldest ones */
+	if (_inflight + numbytes > XVC_MAX_INFLIGHT) {
+		size_t max_inflight = (numbytes > XVC_MAX_INFLIGHT) ? 0 :
+			XVC_MAX_INFLIGHT - numbytes;
+		if (!read_replies(max_inflight))
+			return false;
+	}
 
-	if ((ret = xfer_pkt("shift:\0", _xfer_buf, (2 * numbytes) + 4,
-					_tditdo, numbytes, true)) < 0)
+	memcpy(_xfer_buf, "shift:", 6);
+	_xfer_buf[6] = static_cast<uint8_t>((_num_bits >>  0) & 0xff);
+	_xfer_buf[7] = static_cast<uint8_t>((_num_bits >>  8) & 0xff);
+	_xfer_buf[8] = static_cast<uint8_t>((_num_bits >> 16) & 0xff);
+	_xfer_buf[9] = static_cast<uint8_t>((_num_bits >> 24) & 0xff);
+	memcpy(_xfer_buf + XVC_SHIFT_HDR_LEN, _tms, numbytes);
+	memcpy(_xfer_buf + XVC_SHIFT_HDR_LEN + numbytes, _tditdo, numbytes);
+
+	if (sendall(_sock, _xfer_buf, XVC_SHIFT_HDR_LEN + (2 * numbytes), 0) < 0) {
+		printError("Send failed");
 		return false;
+	}
 	_num_bits = 0;  // clear counter
 
-	if (tdo)
-		memcpy(tdo, _tditdo, numbytes);
+	_pending.push_back({tdo, numbytes});
+	_inflight += numbytes;
+
+	/* consume answers already received without waiting */
+	return read_replies(0, false);
+}
+
+bool XVC_client::read_replies(size_t max_inflight, bool block)
+{
+	uint8_t discard[4096];
+	const int flags = (block) ? 0 : MSG_DONTWAIT;
+
+	while (_inflight > max_inflight) {
+		xvc_reply_t &reply = _pending.front();
+		uint32_t rx_size = reply.len - _reply_pos;
+		uint8_t *rx = discard;
+		if (reply.tdo)
+			rx = reply.tdo + _reply_pos;
+		else if (rx_size > sizeof(discard))
+			rx_size = sizeof(discard);
+
+		ssize_t ret = recv(_sock, rx, rx_size, flags);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			if (!block && (errno == EAGAIN || errno == EWOULDBLOCK))
+				return true;
+			printError("Receive error");
+			return false;
+		} else if (ret == 0) {
+			printError("Server orderly shut down the connection");
+			return false;
+		}
+
+		_reply_pos += ret;
+		_inflight -= ret;
+		if (_reply_pos == reply.len) {
+			if (_verbose)
+				printInfo("received " + std::to_string(reply.len) +
+					" Bytes (" + std::to_string(reply.len * 8) + ")");
+			_pending.pop_front();
+			_reply_pos = 0;
+		}
+	}
 
 	return true;
 }
@@ -6,6 +6,7 @@
 #ifndef SRC_XVC_CLIENT_HPP_
 #define SRC_XVC_CLIENT_HPP_
 
+#include <deque>
 #include <string>
 
 #include "jtagInterface.hpp"
@@ -65,7 +66,19 @@ class XVC_client: public JtagInterface {
 		int toggleClk(uint8_t tms, uint8_t tdi, uint32_t clk_len) override;
 
 		/*!
-		 * \brief flush internal buffer
+		 * \brief send TMS and TDI and receive TDO bits
+		 * \param tms: array of TMS values (used to write)
+		 * \param tdi: array of TDI values (used to write)
+		 * \param tdo: array of TDO values (used when read, may be NULL)
+		 * \param len: number of bit to send/receive
+		 * \return true with full buffers are sent, false otherwise
+		 */
+		bool writeTMSTDI(const uint8_t *tms, const uint8_t *tdi, uint8_t *tdo,
+				uint32_t len) override;
+
+		/*!
+		 * \brief flush internal buffer and wait for all pending
+		 *        shift answers
 		 * \return <=0 if something fail, > 0 otherwise
 		 */
 		int flush() override;
@@ -103,15 +116,38 @@ class XVC_client: public JtagInterface {
 				uint8_t *rx, uint32_t rx_size, bool rx_exact = false);
 
 		/*!
-		 * \brief lowlevel write: EMU_CMD_HW_JTAGx implementation
-		 * \param[out]: tdo: TDO read buffer (may be null)
+		 * \brief lowlevel write: send a shift: command with _num_bits
+		 *        from _tms/_tditdo without waiting for the answer
+		 * \param[out]: tdo: TDO read buffer (may be null), filled
+		 *               when the answer is received (see sync)
 		 * \return false when failure
 		 */
 		bool ll_write(uint8_t *tdo);
 
+		/*!
+		 * \brief receive shift: answers until at most max_inflight
+		 *        bytes are pending
+		 * \param[in] max_inflight: pending answer bytes allowed
+		 * \param[in] block: when false, stop when nothing is available
+		 * \return false when connection is broken
+		 */
+		bool read_replies(size_t max_inflight, bool block = true);
+
+		/*!
+		 * \brief wait for all pending shift: answers
+		 * \return false when connection is broken
+		 */
+		bool sync() { return read_replies(0); }
+
+		/* shift: command sent, answer not yet received */
+		typedef struct {
+			uint8_t *tdo;     /*!< destination (may be NULL) */
+			uint32_t len;     /*!< answer size (Byte) */
+		} xvc_reply_t;
+
 		bool _verbose; /*!< display informations */
 
-		uint8_t *_xfer_buf; /*!> tx buffer */
+		uint8_t *_xfer_buf; /*!< tx buffer */
 		uint8_t *_tms;      /*!< TMS internal buffer */
 		uint8_t *_tditdo;   /*!< TDI/TDO internal buffer */
 		uint32_t _num_bits; /*!< number of bits stored */
@@ -119,6 +155,9 @@ class XVC_client: public JtagInterface {
 		uint32_t _last_tdi; /*!< last known TDI state */
 
 		uint32_t _buffer_size;
+		std::deque<xvc_reply_t> _pending; /*!< answers not yet received */
+		size_t _inflight;         /*!< pending answers size (Byte) */
+		uint32_t _reply_pos;      /*!< bytes received for _pending.front() */
 		std::string _server_name;
 		std::string _server_vers;
 		int _sock;
@@ -7,10 +7,17 @@
 
 #include <arpa/inet.h>
 #include <sys/socket.h>
+#ifdef __linux__
+#include <sys/epoll.h>
+#else
+#include <poll.h>
+#endif
 #include <errno.h>
+#include <fcntl.h>
 #include <netinet/tcp.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <cstring>
 #include <stdexcept>
 
@@ -21,6 +28,20 @@
 #include "cable.hpp"
 #include "display.hpp"
 
+/* events mask */
+#define XVC_EV_READ  (1 << 0)
+#define XVC_EV_WRITE (1 << 1)
+#define XVC_EV_ERROR (1 << 2)
+/* max events handled by one epoll_wait call */
+#define XVC_MAX_EVENTS 16
+/* "shift:" + length */
+#define XVC_CMD_HDR_LEN 10
+/* max read size per call */
+#define XVC_READ_CHUNK (64 * 1024)
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
 
 XVC_server::XVC_server(int port, const cable_t & cable,
 	const jtag_pins_conf_t * pin_conf, std::string dev,
@@ -29,7 +50,8 @@ XVC_server::XVC_server(int port, const cable_t & cable,
 	const std::string & firmware_path):_verbose(verbose > 1),
 			_jtag(NULL), _port(port), _sock(-1),
 			_is_stopped(false), _must_stop(false),
-			_buffer_size(1048576), _state(Jtag::RUN_TEST_IDLE)
+			_buffer_size(1048576), _state(Jtag::RUN_TEST_IDLE), _ev_fd(-1),
+			_owner(-1)
 {
 	(void)pin_conf;
 	(void)ip_adr;
@@ -117,7 +139,7 @@ bool XVC_server::open_connection()
 		return false;
 	}
 
-	if (listen(_sock, 1) < 0) {
+	if (listen(_sock, 4) < 0) {
 		printError("Socket listen error");
 		close(_sock);
 		return false;
@@ -146,75 +168,252 @@ bool XVC_server::close_connection()
 	return true;
 }
 
-void XVC_server::thread_listen()
+/* event loop helpers */
+#ifdef __linux__
+bool XVC_server::ev_init()
 {
-	fd_set conn;
-	int maxfd = 0;
+	_ev_fd = epoll_create1(0);
+	return _ev_fd >= 0;
+}
 
-	FD_ZERO(&conn);
-	FD_SET(_sock, &conn);
+void XVC_server::ev_close()
+{
+	if (_ev_fd >= 0)
+		close(_ev_fd);
+	_ev_fd = -1;
+}
 
-	maxfd = _sock;
+void XVC_server::ev_set(int fd, uint32_t events)
+{
+	struct epoll_event ev;
+	memset(&ev, 0, sizeof(ev));
+	ev.data.fd = fd;
+	if (events & XVC_EV_READ)
+		ev.events |= EPOLLIN;
+	if (events & XVC_EV_WRITE)
+		ev.events |= EPOLLOUT;
+
+	if (events == 0) {
+		epoll_ctl(_ev_fd, EPOLL_CTL_DEL, fd, &ev);
+	} else if (epoll_ctl(_ev_fd, EPOLL_CTL_MOD, fd, &ev) < 0 &&
+			errno == ENOENT) {
+		epoll_ctl(_ev_fd, EPOLL_CTL_ADD, fd, &ev);
+	}
+}
+
+bool XVC_server::ev_wait(std::vector<std::pair<int, uint32_t>> &ready)
+{
+	struct epoll_event evs[XVC_MAX_EVENTS];
+	ready.clear();
+	int nfds = epoll_wait(_ev_fd, evs, XVC_MAX_EVENTS, 1000);
+	if (nfds < 0)
+		return errno == EINTR;
+	for (int i = 0; i < nfds; i++) {
+		uint32_t events = 0;
+		if (evs[i].events & EPOLLIN)
+			events |= XVC_EV_READ;
+		if (evs[i].events & EPOLLOUT)
+			events |= XVC_EV_WRITE;
+		if (evs[i].events & (EPOLLERR | EPOLLHUP))
+			events |= XVC_EV_ERROR;
+		const int fd = evs[i].data.fd;
+		ready.push_back({fd, events});
+	}
+	return true;
+}
+#else
+bool XVC_server::ev_init()
+{
+	return true;
+}
+
+void XVC_server::ev_close()
+{
+}
+
+void XVC_server::ev_set(int fd, uint32_t events)
+{
+	/* events are rebuilt from _conns by ev_wait */
+	(void)fd;
+	(void)events;
+}
+
+bool XVC_server::ev_wait(std::vector<std::pair<int, uint32_t>> &ready)
+{
+	std::vector<struct pollfd> fds;
+	fds.push_back({_sock, POLLIN, 0});
+	for (auto &&c : _conns) {
+		short events = 0;
+		if (c.second.events & XVC_EV_READ)
+			events |= POLLIN;
+		if (c.second.events & XVC_EV_WRITE)
+			events |= POLLOUT;
+		fds.push_back({c.first, events, 0});
+	}
+
+	ready.clear();
+	if (poll(fds.data(), fds.size(), 1000) < 0)
+		return errno == EINTR;
+	for (auto &&p : fds) {
+		uint32_t events = 0;
+		if (p.revents & POLLIN)
+			events |= XVC_EV_READ;
+		if (p.revents & POLLOUT)
+			events |= XVC_EV_WRITE;
+		if (p.revents & (POLLERR | POLLHUP | POLLNVAL))
+			events |= XVC_EV_ERROR;
+		if (events)
+			ready.push_back({p.fd, events});
+	}
+	return true;
+}
+#endif
+
+void XVC_server::accept_client()
+{
+	socklen_t nsize = sizeof(_sock_addr);
+	int newfd = accept(_sock, (struct sockaddr*) &_sock_addr, &nsize);
+	if (newfd < 0) {
+		if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+			return;
+		throw std::runtime_error("accept");
+	}
+	printf("connection accepted - fd %d\n", newfd);
+
+	printInfo("setting TCP_NODELAY to 1\n");
+	int flag = 1;
+	if (setsockopt(newfd, IPPROTO_TCP, TCP_NODELAY, (char *)&flag,
+			sizeof(int)) < 0) {
+		close(newfd);
+		throw std::runtime_error("TCP_NODELAY error");
+	}
+	/* a full shift request (and its reply) fits in socket buffers */
+	int buf_size = _buffer_size;
+	setsockopt(newfd, SOL_SOCKET, SO_RCVBUF, &buf_size, sizeof(buf_size));
+	setsockopt(newfd, SOL_SOCKET, SO_SNDBUF, &buf_size, sizeof(buf_size));
+	fcntl(newfd, F_SETFL, fcntl(newfd, F_GETFL, 0) | O_NONBLOCK);
+
+	xvc_conn_t &conn = _conns[newfd];
+	conn.rx.reserve(XVC_CMD_HDR_LEN + _buffer_size);
+	conn.events = XVC_EV_READ;
+	conn.waiting = false;
+	ev_set(newfd, conn.events);
+	if (_conns.size() > 1)
+		printInfo("XVC: " + std::to_string(_conns.size()) +
+			" clients connected, TAP access is serialized");
+}
+
+void XVC_server::drop_client(int fd)
+{
+	ev_set(fd, 0);
+	close(fd);
+	_conns.erase(fd);
+
+	if (_owner != fd)
+		return;
+	/* client left in the middle of a sequence: reset TAP and
+	 * go to Run-Test/Idle before giving it to the next client
+	 */
+	_owner = -1;
+	if (_state != Jtag::RUN_TEST_IDLE && _state != Jtag::TEST_LOGIC_RESET) {
+		const uint8_t tms = 0x1f;
+		if (_jtag->writeTMS(&tms, 6, true) < 0)
+			printError("XVC: TAP reset failed");
+		set_state(&tms, 6);
+	}
+}
+
+void XVC_server::serve_waiting()
+{
+	bool progress = true;
+	/* each pass gives one session to each waiting client */
+	while (progress && _owner == -1) {
+		progress = false;
+		std::vector<int> fds;
+		for (auto &&c : _conns)
+			if (c.second.waiting)
+				fds.push_back(c.first);
+
+		for (int fd : fds) {
+			auto it = _conns.find(fd);
+			if (it == _conns.end())
+				continue;
+			xvc_conn_t &conn = it->second;
+			const size_t rx_len = conn.rx.size();
+			if (handle_commands(fd, conn) != 0 || !flush_tx(fd, conn)) {
+				printInfo("connection closed - fd " + std::to_string(fd));
+				drop_client(fd);
+				continue;
+			}
+			if (conn.rx.size() != rx_len)
+				progress = true;
+			update_events(fd, conn);
+		}
+	}
+}
+
+void XVC_server::thread_listen()
+{
+	std::vector<std::pair<int, uint32_t>> ready;
+
+	if (!ev_init()) {
+		printError("event loop creation error");
+		_is_stopped = true;
+		return;
+	}
+	fcntl(_sock, F_SETFL, fcntl(_sock, F_GETFL, 0) | O_NONBLOCK);
+	ev_set(_sock, XVC_EV_READ);
 
 	try {
 		while (!_must_stop) {
-			fd_set read = conn, except = conn;
-			int fd;
-
-			struct timeval tv;
-			tv.tv_sec = 1;
-			tv.tv_usec = 0;
-			if (select(maxfd + 1, &read, 0, &except, &tv) < 0) {
-				printError("select");
+			if (!ev_wait(ready)) {
+				printError("event wait");
 				break;
 			}
 
-			for (fd = 0; fd <= maxfd; ++fd) {
-				if (FD_ISSET(fd, &read)) {
-					if (fd == _sock) {
-						int newfd;
-						socklen_t nsize = sizeof(_sock_addr);
-
-						newfd = accept(_sock, (struct sockaddr*) &_sock_addr,
-							&nsize);
-
-						printf("connection accepted - fd %d\n", newfd);
-						if (newfd < 0) {
-							throw std::runtime_error("accept");
-						} else {
-							printInfo("setting TCP_NODELAY to 1\n");
-							int flag = 1;
-							int optResult = setsockopt(newfd, IPPROTO_TCP,
-									TCP_NODELAY, (char *)&flag, sizeof(int));
-							if (optResult < 0)
-								throw std::runtime_error("TCP_NODELAY error");
-							if (newfd > maxfd) {
-								maxfd = newfd;
-							}
-							FD_SET(newfd, &conn);
-						}
-					} else {
-						int ret = handle_data(fd);
-						if (ret != 0) {
-							printInfo("connection closed - fd " + std::to_string(fd));
-							close(fd);
-							FD_CLR(fd, &conn);
-							if (ret == 3)
-								throw std::runtime_error("communication failure");
-						}
-					}
-				} else if (FD_ISSET(fd, &except)) {
-					printWarn("connection aborted - fd " + std::to_string(fd));
-					close(fd);
-					FD_CLR(fd, &conn);
-					if (fd == _sock)
-						break;
+			for (auto &&ev : ready) {
+				const int fd = ev.first;
+				if (fd == _sock) {
+					if (ev.second & XVC_EV_ERROR)
+						throw std::runtime_error("server socket error");
+					accept_client();
+					continue;
+				}
+
+				auto it = _conns.find(fd);
+				if (it == _conns.end())
+					continue;
+				xvc_conn_t &conn = it->second;
+
+				int ret = 0;
+				if (ev.second & XVC_EV_WRITE) {
+					if (!flush_tx(fd, conn))
+						ret = 2;
+				}
+				/* a client stopped because of its tx backlog
+				 * may have pending commands
+				 */
+				if (ret == 0 && (ev.second & (XVC_EV_READ | XVC_EV_WRITE |
+						XVC_EV_ERROR)))
+					ret = handle_data(fd, conn);
+
+				if (ret != 0) {
+					printInfo("connection closed - fd " + std::to_string(fd));
+					drop_client(fd);
+				} else {
+					update_events(fd, conn);
 				}
 			}
+			/* TAP released: resume clients with queued commands */
+			serve_waiting();
 		}
 	} catch (const std::runtime_error& e) {
 		std::cerr << "thread exiting with error: " << e.what() << std::endl;
 	}
+
+	while (!_conns.empty())
+		drop_client(_conns.begin()->first);
+	ev_close();
 	_is_stopped = true;
 }
 
@@ -234,153 +433,298 @@ bool XVC_server::listen_loop()
 	return true;
 }
 
-int XVC_server::sread(int fd, void *target, int len)
+void XVC_server::update_events(int fd, xvc_conn_t &conn)
 {
-	unsigned char *t = (unsigned char *)target;
-	while (len) {
-		int r = read(fd, t, len);
-		if (r == 0){  // connection closed
-			return 2;
+	uint32_t events = 0;
+	/* client not reading replies or waiting for the TAP:
+	 * stop reading its requests
+	 */
+	if (conn.tx.size() < _buffer_size && !conn.waiting)
+		events |= XVC_EV_READ;
+	if (!conn.tx.empty())
+		events |= XVC_EV_WRITE;
+	if (events != conn.events) {
+		conn.events = events;
+		ev_set(fd, events);
+	}
+}
+
+bool XVC_server::flush_tx(int fd, xvc_conn_t &conn)
+{
+	size_t sent = 0;
+	while (sent < conn.tx.size()) {
+		ssize_t r = send(fd, conn.tx.data() + sent, conn.tx.size() - sent,
+			MSG_NOSIGNAL);
+		if (r < 0) {
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				break;
+			if (errno == EINTR)
+				continue;
+			printError("write");
+			return false;
+		}
+		sent += r;
+	}
+	conn.tx.erase(conn.tx.begin(), conn.tx.begin() + sent);
+	return true;
+}
+
+int XVC_server::handle_data(int fd, xvc_conn_t &conn)
+{
+	bool closed = false;
+
+	/* read ahead: everything available up to one full shift request */
+	const size_t max_rx = XVC_CMD_HDR_LEN + _buffer_size;
+	while (conn.tx.size() < _buffer_size && conn.rx.size() < max_rx &&
+			!conn.waiting) {
+		const size_t pos = conn.rx.size();
+		const size_t chunk = std::min(max_rx - pos, (size_t)XVC_READ_CHUNK);
+		conn.rx.resize(pos + chunk);
+		ssize_t r = read(fd, conn.rx.data() + pos, chunk);
+		conn.rx.resize(pos + ((r > 0) ? r : 0));
+		if (r == 0) {  // connection closed
+			closed = true;
+			break;
 		} else if (r < 0) {
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				break;
+			if (errno == EINTR)
+				continue;
+			/* broken connection: only this client is closed */
 			char err[256];
-			snprintf(err, 256, "Read error (%d) %d %s\n", r,
+			snprintf(err, 256, "Read error (%zd) %d %s\n", r,
 				errno, strerror(errno));
 			printError(err);
-			return 3;
+			return 2;
 		}
+		/* handle complete commands before reading more */
+		if (handle_commands(fd, conn) != 0)
+			return 1;
+	}
+
+	if (!conn.waiting && handle_commands(fd, conn) != 0)
+		return 1;
+	if (!flush_tx(fd, conn))
+		return 2;
+
+	return (closed) ? 2 : 0;
+}
 
-		t += r;
-		len -= r;
+/* copy len bits from src (starting at bit src_pos) to dst (at bit dst_pos) */
+static void copy_bits(uint8_t *dst, size_t dst_pos, const uint8_t *src,
+		size_t src_pos, uint32_t len)
+{
+	if ((dst_pos & 0x07) == 0 && (src_pos & 0x07) == 0) {
+		memcpy(dst + (dst_pos >> 3), src + (src_pos >> 3), len >> 3);
+		dst_pos += len & ~0x07;
+		src_pos += len & ~0x07;
+		len &= 0x07;
+	}
+	for (uint32_t i = 0; i < len; i++, dst_pos++, src_pos++) {
+		const uint8_t mask = 1 << (dst_pos & 0x07);
+		if ((src[src_pos >> 3] >> (src_pos & 0x07)) & 0x01)
+			dst[dst_pos >> 3] |= mask;
+		else
+			dst[dst_pos >> 3] &= ~mask;
 	}
-	return 1;
 }
 
-int XVC_server::handle_data(int fd)
+bool XVC_server::run_batch(xvc_conn_t &conn, std::vector<xvc_shift_t> &batch)
 {
-	char xvcInfo[32];
-	int ret;
+	if (batch.empty())
+		return true;
+
+	/* _tmstdi: TMS in first half, TDI in second half */
+	const size_t half = _buffer_size / 2;
+	size_t nb_bits = 0;
+	for (auto &&sh : batch) {
+		if (sh.skip)
+			continue;
+		const size_t nr_bytes = (sh.len + 7) / 8;
+		const uint8_t *tms = conn.rx.data() + sh.rx_offset;
+		copy_bits(_tmstdi, nb_bits, tms, 0, sh.len);
+		copy_bits(_tmstdi + half, nb_bits, tms + nr_bytes, 0, sh.len);
+		nb_bits += sh.len;
+	}
+
+	bool ret = true;
+	if (nb_bits > 0) {
+		memset(_result, 0, (nb_bits + 7) / 8);
+		ret = _jtag->writeTMSTDI(_tmstdi, _tmstdi + half, _result, nb_bits);
+		if (_verbose)
+			printInfo("\tbatch: " + std::to_string(batch.size()) +
+				" shift(s), " + std::to_string(nb_bits) + " bits");
+	}
+
+	size_t pos = 0;
+	for (auto &&sh : batch) {
+		if (sh.skip)
+			continue;
+		copy_bits(conn.tx.data() + sh.tx_offset, 0, _result, pos, sh.len);
+		pos += sh.len;
+	}
+	batch.clear();
+
+	return ret;
+}
 
-	do {
-		char cmd[16];
-		memset(cmd, 0, 16);
+int XVC_server::handle_commands(int fd, xvc_conn_t &conn)
+{
+	std::vector<xvc_shift_t> batch;
+	size_t batch_bytes = 0;
+	size_t pos = 0;
+	int ret = 0;
+
+	conn.waiting = false;
+	while (ret == 0) {
+		const uint8_t *cmd = conn.rx.data() + pos;
+		const size_t avail = conn.rx.size() - pos;
+		if (avail < 2)
+			break;
 
-		if ((ret = sread(fd, cmd, 2)) != 1) {
-			return ret;
+		/* TAP owned by another client: keep commands queued (replies
+		 * order must be preserved)
+		 */
+		if (_owner != -1 && _owner != fd &&
+				(memcmp(cmd, "sh", 2) == 0 || memcmp(cmd, "se", 2) == 0)) {
+			conn.waiting = true;
+			break;
 		}
 
 		/* getinfo */
 		if (memcmp(cmd, "ge", 2) == 0) {
-			if ((ret = sread(fd, cmd, 6)) != 1)
-				return ret;
+			if (avail < 8)
+				break;
+			char xvcInfo[32];
 			snprintf(xvcInfo, sizeof(xvcInfo),
 				"xvcServer_v1.0:%u\n", _buffer_size);
-			if (send(fd, xvcInfo, strlen(xvcInfo), 0) !=
-				(ssize_t) strlen(xvcInfo)) {
-				perror("write");
-				return 1;
-			}
+			conn.tx.insert(conn.tx.end(), xvcInfo, xvcInfo + strlen(xvcInfo));
 			if (_verbose) {
 				printInfo(std::to_string((int)time(NULL)) +
 							" : Received command: 'getinfo'");
 				printInfo("\t Replied with " + std::string(xvcInfo));
 			}
-			break;
+			pos += 8;
 		/* settck */
 		} else if (memcmp(cmd, "se", 2) == 0) {
-			if ((ret = sread(fd, cmd, 9)) != 1)
-				return ret;
-			memcpy(_result, cmd + 5, 4);
-			if (write(fd, _result, 4) != 4) {
-				printError("write");
-				return 1;
-			}
+			if (avail < 11)
+				break;
+			/* frequency change applies after previous shifts */
+			if (!run_batch(conn, batch))
+				ret = 1;
+			batch_bytes = 0;
+			conn.tx.insert(conn.tx.end(), cmd + 7, cmd + 11);
 			uint32_t clk_period =
-				(static_cast<uint32_t>(_result[0]) <<  0) |
-				(static_cast<uint32_t>(_result[1]) <<  8) |
-				(static_cast<uint32_t>(_result[2]) << 16) |
-				(static_cast<uint32_t>(_result[3]) << 24);
+				(static_cast<uint32_t>(cmd[7]) <<  0) |
+				(static_cast<uint32_t>(cmd[8]) <<  8) |
+				(static_cast<uint32_t>(cmd[9]) << 16) |
+				(static_cast<uint32_t>(cmd[10]) << 24);
 
-			_jtag->setClkFreq(static_cast<uint32_t>(1e9/clk_period));
+			if (clk_period != 0)
+				_jtag->setClkFreq(static_cast<uint32_t>(1e9/clk_period));
 
 			if (_verbose) {
 				printInfo(std::to_string((int)time(NULL)) +
 						" : Received command: 'settck'");
-				printf("\t Replied with '%.*s'\n\n", 4,
-					   cmd + 5);
+				printf("\t Replied with '%.*s'\n\n", 4, cmd + 7);
 			}
-			break;
+			pos += 11;
 		} else if (memcmp(cmd, "de", 2) == 0) {	 // DEBUG CODE
-			if ((ret = sread(fd, cmd, 3)) != 1)
-				return ret;
+			if (avail < 5)
+				break;
 			printf("%u : Received command: 'debug'\n",
 				   (int)time(NULL));
-			break;
+			pos += 5;
 		} else if (memcmp(cmd, "of", 2) == 0) {	 // DEBUG CODE
-			if ((ret = sread(fd, cmd, 1)) != 1)
-				return ret;
+			if (avail < 3)
+				break;
 			printf("%u : Received command: 'off'\n",
 				   (int)time(NULL));
-			break;
+			pos += 3;
 		} else if (memcmp(cmd, "sh", 2) == 0) {
-			if ((ret = sread(fd, cmd, 4)) != 1)
-				return ret;
+			/* Handling for -> "shift:<num bits><tms vector><tdi vector>" */
+			if (avail < XVC_CMD_HDR_LEN)
+				break;
+			/* 1. len */
+			uint32_t len;
+			memcpy(&len, cmd + 6, 4);
+			/* 2. convert len (in bits) to nr_bytes (in bytes) */
+			const uint32_t nr_bytes = (len + 7) / 8;
+			/* check buffer size */
+			if (nr_bytes * 2 > _buffer_size) {
+				printError("buffer size exceeded");
+				ret = 1;
+				break;
+			}
+			/* 3. wait for 2 x nr_bytes (TMS + TDI) */
+			if (avail < XVC_CMD_HDR_LEN + nr_bytes * 2)
+				break;
+
 			if (_verbose) {
 				printInfo(std::to_string((int)time(NULL)) +
 						" : Received command: 'shift'");
+				printInfo("\tNumber of Bits  : " + std::to_string(len));
+				printInfo("\tNumber of Bytes : " + std::to_string(nr_bytes));
+				printInfo("\n");
 			}
-		} else {
-			printError("invalid cmd '" + std::string(cmd) + "'");
-			return 1;
-		}
-
-		/* Handling for -> "shift:<num bits><tms vector><tdi vector>" */
-		uint32_t len, nr_bytes;
-		/* 1. len */
-		if ((ret = sread(fd, &len, 4)) != 1) {
-			printError("reading length failed");
-			return ret;
-		}
-
-		/* 2. convert len (in bits) to nr_bytes (in bytes) */
-		nr_bytes = (len + 7) / 8;
-		/* check buffer size */
-		if (nr_bytes * 2 > _buffer_size) {
-			printError("buffer size exceeded");
-			return 1;
-		}
-
-		/* 3. receive 2 x nr_bytes (TMS + TDI) */
-		if ((ret = sread(fd, _tmstdi, nr_bytes * 2)) != 1) {
-			printError("reading data failed");
-			return ret;
-		}
-		memset(_result, 0, nr_bytes);
 
-		if (_verbose) {
-			printInfo("\tNumber of Bits  : " + std::to_string(len));
-			printInfo("\tNumber of Bytes : " + std::to_string(nr_bytes));
-			printInfo("\n");
-		}
+			/* merged sequence must fit in _tmstdi */
+			if (batch_bytes + nr_bytes + 1 > _buffer_size / 2) {
+				if (!run_batch(conn, batch)) {
+					ret = 1;
+					break;
+				}
+				batch_bytes = 0;
+			}
 
-		// Due to a weird bug(??) xilinx impacts goes through another
-		// "capture_ir"/"capture_dr" cycle after reading IR/DR which
-		// unfortunately sets IR to the read-out IR value.
-		// Just ignore these transactions.
-		// ref: https://github.com/tmbinc/xvcd/blob/ftdi/src/xvcd.c#L265
-		if (!((_state == Jtag::EXIT1_IR && len == 5 && _tmstdi[0] == 0x17) ||
-				(_state == Jtag::EXIT1_DR && len == 4 && _tmstdi[0] == 0x6b))) {
+			const uint8_t *tms = cmd + XVC_CMD_HDR_LEN;
+			xvc_shift_t sh;
+			sh.rx_offset = pos + XVC_CMD_HDR_LEN;
+			sh.tx_offset = conn.tx.size();
+			sh.len = len;
+			// Due to a weird bug(??) xilinx impacts goes through another
+			// "capture_ir"/"capture_dr" cycle after reading IR/DR which
+			// unfortunately sets IR to the read-out IR value.
+			// Just ignore these transactions.
+			// ref: https://github.com/tmbinc/xvcd/blob/ftdi/src/xvcd.c#L265
+			sh.skip = ((_state == Jtag::EXIT1_IR && len == 5 && tms[0] == 0x17) ||
+				(_state == Jtag::EXIT1_DR && len == 4 && tms[0] == 0x6b));
 			// update state using tms sequence
-			set_state(_tmstdi, len);
-			_jtag->writeTMSTDI(_tmstdi, _tmstdi + nr_bytes, _result, len);
+			if (!sh.skip)
+				set_state(tms, len);
+			/* reply (TDO) is filled by run_batch */
+			conn.tx.resize(conn.tx.size() + nr_bytes, 0);
+			batch.push_back(sh);
+			batch_bytes += nr_bytes;
+			pos += XVC_CMD_HDR_LEN + nr_bytes * 2;
+
+			if (_state != Jtag::RUN_TEST_IDLE &&
+					_state != Jtag::TEST_LOGIC_RESET) {
+				_owner = fd;
+				continue;
+			}
+			/* session done: give other clients a chance */
+			_owner = -1;
+			for (auto &&c : _conns) {
+				if (c.first != fd && c.second.waiting) {
+					conn.waiting = true;
+					break;
+				}
+			}
+			if (conn.waiting)
+				break;
+		} else {
+			printError("invalid cmd '" +
+				std::string(reinterpret_cast<const char *>(cmd), 2) + "'");
+			ret = 1;
 		}
+	}
 
-		/* send received TDO sequence */
-		if (send(fd, _result, nr_bytes, 0) != nr_bytes) {
-			printError("write");
-			return 1;
-		}
-	} while (1);
-	return 0;
+	if (ret == 0 && !run_batch(conn, batch))
+		ret = 1;
+	conn.rx.erase(conn.rx.begin(), conn.rx.begin() + pos);
+
+	return ret;
 }
 
 /* loops over tms_seq, extracts bit by bit values and update
@@ -404,7 +748,7 @@ Jtag::tapState_t XVC_server::set_state(const uint8_t *tms_seq, uint32_t len)
 				_state = (tms) ? Jtag::EXIT1_DR : Jtag::SHIFT_DR;
 				break;
 			case Jtag::SHIFT_DR:
-				_state = (tms) ? Jtag::EXIT1_DR : Jtag::CAPTURE_DR;
+				_state = (tms) ? Jtag::EXIT1_DR : Jtag::SHIFT_DR;
 				break;
 			case Jtag::EXIT1_DR:
 				_state = (tms) ? Jtag::UPDATE_DR : Jtag::PAUSE_DR;
@@ -427,7 +771,7 @@ Jtag::tapState_t XVC_server::set_state(const uint8_t *tms_seq, uint32_t len)
 				_state = (tms) ? Jtag::EXIT1_IR : Jtag::SHIFT_IR;
 				break;
 			case Jtag::SHIFT_IR:
-				_state = (tms) ? Jtag::EXIT1_IR : Jtag::CAPTURE_IR;
+				_state = (tms) ? Jtag::EXIT1_IR : Jtag::SHIFT_IR;
 				break;
 			case Jtag::EXIT1_IR:
 				_state = (tms) ? Jtag::UPDATE_IR : Jtag::PAUSE_IR;
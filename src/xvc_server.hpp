@@ -12,8 +12,10 @@
 
 #include <netinet/in.h>
 
+#include <map>
 #include <string>
 #include <thread>
+#include <vector>
 
 #include "jtag.hpp"
 
@@ -59,20 +61,85 @@ class XVC_server {
 		 * \brief thread dedicated for wait for incoming connection
 		 */
 		void thread_listen();
-		/*!
-		 * \brief parser and dispatcher for XVC transactions
-		 * \return 2 when connection is closed, 1 when transactions fails,
-		 *         0 otherwise
+		/* connection with one client: non blocking socket, commands
+		 * are read ahead in rx and replies wait in tx until sent
 		 */
-		int handle_data(int fd);
+		typedef struct {
+			std::vector<uint8_t> rx;  /*!< received, not yet handled */
+			std::vector<uint8_t> tx;  /*!< replies not yet sent */
+			uint32_t events;          /*!< events currently registered */
+			bool waiting;             /*!< commands queued: TAP owned by another client */
+		} xvc_conn_t;
+		/* shift command waiting in the current batch */
+		typedef struct {
+			size_t rx_offset;  /*!< TMS vector position in rx */
+			size_t tx_offset;  /*!< TDO reply position in tx */
+			uint32_t len;      /*!< number of bits */
+			bool skip;         /*!< transaction ignored (see handle_commands) */
+		} xvc_shift_t;
+
+		/* event loop: epoll on Linux, poll otherwise */
+		bool ev_init();
+		void ev_close();
 		/*!
-		 * \brief read len bytes from client
+		 * \brief register/update/remove fd
 		 * \param fd: socket descriptor
-		 * \param target: buffer
-		 * \param len: number of bytes to read
-		 * \return 3 when failure, 2 when connection closed, 1 otherwise
+		 * \param events: XVC_EV_* mask, 0 to remove fd
+		 */
+		void ev_set(int fd, uint32_t events);
+		/*!
+		 * \brief wait for events (1s max)
+		 * \param ready: filled with fd and XVC_EV_* mask
+		 * \return false on error
+		 */
+		bool ev_wait(std::vector<std::pair<int, uint32_t>> &ready);
+
+		/*!
+		 * \brief accept a new client, configure socket
+		 */
+		void accept_client();
+		/*!
+		 * \brief close client and drop its pending replies. When this
+		 *        client owns the TAP, TAP is moved back to Run-Test/Idle
+		 */
+		void drop_client(int fd);
+		/*!
+		 * \brief handle commands queued by clients waiting for the TAP
+		 */
+		void serve_waiting();
+		/*!
+		 * \brief read everything available from client, handle
+		 *        complete commands and send replies
+		 * \return 2 when connection is closed or broken, 1 when
+		 *         transactions fails, 0 otherwise
+		 */
+		int handle_data(int fd, xvc_conn_t &conn);
+		/*!
+		 * \brief parser and dispatcher for XVC transactions present in
+		 *        conn.rx. Consecutive shifts are merged in one cable
+		 *        transaction. A client owns the TAP from its first shift
+		 *        leaving a stable state (Run-Test/Idle, Test-Logic-Reset)
+		 *        until TAP is back in a stable state: meanwhile shift
+		 *        and settck from other clients stay queued in their rx
+		 * \param fd: client socket descriptor
+		 * \return 1 when transactions fails, 0 otherwise
+		 */
+		int handle_commands(int fd, xvc_conn_t &conn);
+		/*!
+		 * \brief send batch of shifts as one TMS/TDI sequence and
+		 *        dispatch TDO to each reply
+		 * \return false when cable access fails
+		 */
+		bool run_batch(xvc_conn_t &conn, std::vector<xvc_shift_t> &batch);
+		/*!
+		 * \brief send as much as possible of conn.tx
+		 * \return false when connection is broken
+		 */
+		bool flush_tx(int fd, xvc_conn_t &conn);
+		/*!
+		 * \brief update registered events according to conn state
 		 */
-		int sread(int fd, void *target, int len);
+		void update_events(int fd, xvc_conn_t &conn);
 
 	    int _verbose;          /*!< verbose level */
 		JtagInterface *_jtag;  /*!< jtag interface */
@@ -86,6 +153,9 @@ class XVC_server {
 		uint8_t *_tmstdi;      /*!< TDI/TMS from client */
 		uint8_t *_result;      /*!< buffer for server -> client */
 		Jtag::tapState_t _state; /*!< actual jtag state */
+		int _ev_fd;            /*!< epoll descriptor (Linux) */
+		std::map<int, xvc_conn_t> _conns;  /*!< connected clients */
+		int _owner;            /*!< client owning the TAP, -1 when free */
 };
 
 #endif  // SRC_XVC_SERVER_HPP_